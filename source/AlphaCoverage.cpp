@@ -0,0 +1,123 @@
+#include "pch.h"
+#include "AlphaCoverage.h"
+#include "Vector2.h"
+
+namespace dae
+{
+	AlphaCoverage* AlphaCoverage::Create(int width, int height, const std::vector<uint8_t>& alphas)
+	{
+		if (width <= 0 || height <= 0 || alphas.size() < static_cast<size_t>(width) * height) return nullptr;
+
+		AlphaCoverage* pCoverage{ new AlphaCoverage{} };
+		pCoverage->m_Width = width;
+		pCoverage->m_Height = height;
+
+		// Level 0, the alpha range of every block of texels
+		Level firstLevel{};
+		firstLevel.width = (width + m_BlockSize - 1) / m_BlockSize;
+		firstLevel.height = (height + m_BlockSize - 1) / m_BlockSize;
+		firstLevel.minAlphas.assign(static_cast<size_t>(firstLevel.width) * firstLevel.height, UINT8_MAX);
+		firstLevel.maxAlphas.assign(firstLevel.minAlphas.size(), 0);
+
+		for (int y{}; y < height; ++y)
+		{
+			for (int x{}; x < width; ++x)
+			{
+				const uint8_t alpha{ alphas[x + y * width] };
+				const size_t blockIdx{ static_cast<size_t>(x / m_BlockSize + (y / m_BlockSize) * firstLevel.width) };
+				firstLevel.minAlphas[blockIdx] = std::min(firstLevel.minAlphas[blockIdx], alpha);
+				firstLevel.maxAlphas[blockIdx] = std::max(firstLevel.maxAlphas[blockIdx], alpha);
+			}
+		}
+		pCoverage->m_Levels.push_back(std::move(firstLevel));
+
+		// Merge 2x2 blocks until one block covers the whole texture
+		while (pCoverage->m_Levels.back().width > 1 || pCoverage->m_Levels.back().height > 1)
+		{
+			const Level& previousLevel{ pCoverage->m_Levels.back() };
+
+			Level level{};
+			level.width = (previousLevel.width + 1) / 2;
+			level.height = (previousLevel.height + 1) / 2;
+			level.minAlphas.assign(static_cast<size_t>(level.width) * level.height, UINT8_MAX);
+			level.maxAlphas.assign(level.minAlphas.size(), 0);
+
+			for (int y{}; y < previousLevel.height; ++y)
+			{
+				for (int x{}; x < previousLevel.width; ++x)
+				{
+					const size_t previousIdx{ static_cast<size_t>(x + y * previousLevel.width) };
+					const size_t blockIdx{ static_cast<size_t>(x / 2 + (y / 2) * level.width) };
+					level.minAlphas[blockIdx] = std::min(level.minAlphas[blockIdx], previousLevel.minAlphas[previousIdx]);
+					level.maxAlphas[blockIdx] = std::max(level.maxAlphas[blockIdx], previousLevel.maxAlphas[previousIdx]);
+				}
+			}
+
+			pCoverage->m_Levels.push_back(std::move(level));
+		}
+
+		return pCoverage;
+	}
+
+	AlphaCoverage::Coverage AlphaCoverage::GetCoverage(const Vector2& minUV, const Vector2& maxUV, int maxMip) const
+	{
+		const Vector2 clampedMinUV{ std::clamp(minUV.x, 0.0f, 1.0f), std::clamp(minUV.y, 0.0f, 1.0f) };
+		const Vector2 clampedMaxUV{ std::clamp(maxUV.x, 0.0f, 1.0f), std::clamp(maxUV.y, 0.0f, 1.0f) };
+
+		// The texels of the first level that are averaged into the sampled texels of every mip level
+		int startX{ m_Width - 1 };
+		int startY{ m_Height - 1 };
+		int endX{};
+		int endY{};
+		for (int mip{}; mip <= maxMip; ++mip)
+		{
+			const int mipWidth{ std::max(m_Width >> mip, 1) };
+			const int mipHeight{ std::max(m_Height >> mip, 1) };
+
+			// Calculate the texels of the corners in this mip level using clamp adressing mode
+			const int mipStartX{ std::min(static_cast<int>(clampedMinUV.x * mipWidth), mipWidth - 1) };
+			const int mipStartY{ std::min(static_cast<int>(clampedMinUV.y * mipHeight), mipHeight - 1) };
+			const int mipEndX{ std::min(static_cast<int>(clampedMaxUV.x * mipWidth), mipWidth - 1) };
+			const int mipEndY{ std::min(static_cast<int>(clampedMaxUV.y * mipHeight), mipHeight - 1) };
+
+			// Every texel of a mip level is the average of a block of 2^mip x 2^mip texels of the first level
+			startX = std::min(startX, mipStartX << mip);
+			startY = std::min(startY, mipStartY << mip);
+			endX = std::max(endX, std::min(((mipEndX + 1) << mip) - 1, m_Width - 1));
+			endY = std::max(endY, std::min(((mipEndY + 1) << mip) - 1, m_Height - 1));
+		}
+
+		int startBlockX{ startX / m_BlockSize };
+		int startBlockY{ startY / m_BlockSize };
+		int endBlockX{ endX / m_BlockSize };
+		int endBlockY{ endY / m_BlockSize };
+
+		// Go up the hierarchy until the rectangle covers at most 2x2 blocks
+		size_t levelIdx{};
+		while (levelIdx + 1 < m_Levels.size() && (endBlockX - startBlockX > 1 || endBlockY - startBlockY > 1))
+		{
+			++levelIdx;
+			startBlockX /= 2;
+			startBlockY /= 2;
+			endBlockX /= 2;
+			endBlockY /= 2;
+		}
+
+		const Level& level{ m_Levels[levelIdx] };
+		uint8_t minAlpha{ UINT8_MAX };
+		uint8_t maxAlpha{};
+		for (int y{ startBlockY }; y <= endBlockY; ++y)
+		{
+			for (int x{ startBlockX }; x <= endBlockX; ++x)
+			{
+				const size_t blockIdx{ static_cast<size_t>(x + y * level.width) };
+				minAlpha = std::min(minAlpha, level.minAlphas[blockIdx]);
+				maxAlpha = std::max(maxAlpha, level.maxAlphas[blockIdx]);
+			}
+		}
+
+		if (maxAlpha == 0) return Coverage::Transparent;
+		if (minAlpha == UINT8_MAX) return Coverage::Opaque;
+		return Coverage::Partial;
+	}
+}
@@ -0,0 +1,54 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+
+namespace dae
+{
+	struct Vector2;
+
+	// A hierarchy of the minimum and maximum alpha of blocks of texels, built from the first mip level of a texture
+	// Level 0 holds blocks of m_BlockSize x m_BlockSize texels, every next level merges 2x2 blocks of the previous level
+	// The software rasterizer uses it to skip the parts of a triangle that only show fully transparent texels
+	class AlphaCoverage final
+	{
+	public:
+		enum class Coverage
+		{
+			Transparent,
+			Opaque,
+			Partial
+		};
+
+		~AlphaCoverage() = default;
+
+		AlphaCoverage(const AlphaCoverage& other) = delete;
+		AlphaCoverage& operator=(const AlphaCoverage& other) = delete;
+		AlphaCoverage(AlphaCoverage&& other) = delete;
+		AlphaCoverage& operator=(AlphaCoverage&& other) = delete;
+
+		// Builds the hierarchy from the alpha of every texel (width * height values, row by row)
+		static AlphaCoverage* Create(int width, int height, const std::vector<uint8_t>& alphas);
+
+		// Returns whether all the texels in the uv rectangle are transparent (alpha 0), opaque (alpha 255) or neither
+		// The uvs are clamped the same way as Texture::SampleRGB, the result is conservative so it can be Partial for uniform texels
+		// The mip levels up to maxMip average 2x2 texels per level (TextureCache::CreateMipChain), so the rectangle is widened to every texel they average
+		Coverage GetCoverage(const Vector2& minUV, const Vector2& maxUV, int maxMip) const;
+
+	private:
+		static constexpr int m_BlockSize{ 8 };
+
+		struct Level
+		{
+			int width{};
+			int height{};
+			std::vector<uint8_t> minAlphas{};
+			std::vector<uint8_t> maxAlphas{};
+		};
+
+		AlphaCoverage() = default;
+
+		int m_Width{};
+		int m_Height{};
+		std::vector<Level> m_Levels{};
+	};
+}
@@ -40,8 +40,26 @@ namespace dae
 
 	void Camera::CalculateProjectionMatrix()
 	{
-		m_ProjectionMatrix = Matrix::CreatePerspectiveFovLH(m_Fov, m_AspectRatio, m_NearPlane, m_FarPlane);
-		//DirectX Implementation => https://learn.microsoft.com/en-us/windows/win32/direct3d9/d3dxmatrixperspectivefovlh
+		switch (m_DepthProjection)
+		{
+		case DepthProjection::Standard:
+			m_ProjectionMatrix = Matrix::CreatePerspectiveFovLH(m_Fov, m_AspectRatio, m_NearPlane, m_FarPlane);
+			//DirectX Implementation => https://learn.microsoft.com/en-us/windows/win32/direct3d9/d3dxmatrixperspectivefovlh
+			break;
+		case DepthProjection::Reversed:
+			m_ProjectionMatrix = Matrix::CreateReversedPerspectiveFovLH(m_Fov, m_AspectRatio, m_NearPlane, m_FarPlane);
+			break;
+		case DepthProjection::ReversedInfinite:
+			m_ProjectionMatrix = Matrix::CreateReversedInfinitePerspectiveFovLH(m_Fov, m_AspectRatio, m_NearPlane);
+			break;
+		}
+	}
+
+	void Camera::SetDepthProjection(DepthProjection depthProjection)
+	{
+		m_DepthProjection = depthProjection;
+
+		CalculateProjectionMatrix();
 	}
 
 	void Camera::Update(const Timer* pTimer)
@@ -1,6 +1,7 @@
 #pragma once
 #include "Math.h"
 #include "Timer.h"
+#include "DataTypes.h"
 
 namespace dae
 {
@@ -20,6 +21,12 @@ namespace dae
 		const Matrix& GetProjectionMatrix() const { return m_ProjectionMatrix; }
 
 		Vector3 GetPosition() const { return m_Origin; }
+		float GetNearPlane() const { return m_NearPlane; }
+
+		void SetDepthProjection(DepthProjection depthProjection);
+		DepthProjection GetDepthProjection() const { return m_DepthProjection; }
+		// With reversed depth closer surfaces have a larger depth and the depth buffer is cleared to 0
+		bool IsDepthReversed() const { return m_DepthProjection != DepthProjection::Standard; }
 	private:
 		Vector3 m_Origin{};
 		float m_FovAngle{90.f};
@@ -34,6 +41,7 @@ namespace dae
 
 		float m_NearPlane{ 0.1f };
 		float m_FarPlane{ 100.0f };
+		DepthProjection m_DepthProjection{ DepthProjection::Standard };
 
 		float m_AspectRatio{ 1.0f };
 
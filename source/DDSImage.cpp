@@ -0,0 +1,406 @@
+#include "pch.h"
+#include "DDSImage.h"
+#include <fstream>
+
+namespace dae
+{
+	namespace
+	{
+		constexpr uint32_t MakeFourCC(char c0, char c1, char c2, char c3)
+		{
+			return static_cast<uint32_t>(c0) | static_cast<uint32_t>(c1) << 8 | static_cast<uint32_t>(c2) << 16 | static_cast<uint32_t>(c3) << 24;
+		}
+
+		// Source: https://learn.microsoft.com/en-us/windows/win32/direct3ddds/dds-header
+		struct DDSPixelFormat
+		{
+			uint32_t size;
+			uint32_t flags;
+			uint32_t fourCC;
+			uint32_t rgbBitCount;
+			uint32_t rBitMask;
+			uint32_t gBitMask;
+			uint32_t bBitMask;
+			uint32_t aBitMask;
+		};
+
+		struct DDSHeader
+		{
+			uint32_t size;
+			uint32_t flags;
+			uint32_t height;
+			uint32_t width;
+			uint32_t pitchOrLinearSize;
+			uint32_t depth;
+			uint32_t mipMapCount;
+			uint32_t reserved1[11];
+			DDSPixelFormat pixelFormat;
+			uint32_t caps;
+			uint32_t caps2;
+			uint32_t caps3;
+			uint32_t caps4;
+			uint32_t reserved2;
+		};
+
+		struct DDSHeaderDX10
+		{
+			uint32_t dxgiFormat;
+			uint32_t resourceDimension;
+			uint32_t miscFlag;
+			uint32_t arraySize;
+			uint32_t miscFlags2;
+		};
+
+		constexpr uint32_t ddsMagic{ MakeFourCC('D', 'D', 'S', ' ') };
+		constexpr uint32_t ddsPixelFormatFourCC{ 0x4 };
+	}
+
+	DDSImage::~DDSImage()
+	{
+		if (!m_pTiles) return;
+
+		for (int tileIdx{}; tileIdx < m_NrTilesX * m_NrTilesY; ++tileIdx)
+		{
+			delete[] m_pTiles[tileIdx].load();
+		}
+	}
+
+	DDSImage* DDSImage::LoadFromFile(const std::string& path)
+	{
+		std::ifstream file{ path, std::ios::binary };
+		if (!file) return nullptr;
+
+		// Read and check the headers
+		uint32_t magic{};
+		DDSHeader header{};
+		file.read(reinterpret_cast<char*>(&magic), sizeof(magic));
+		file.read(reinterpret_cast<char*>(&header), sizeof(header));
+		if (!file || magic != ddsMagic || header.size != sizeof(DDSHeader)) return nullptr;
+		if (!(header.pixelFormat.flags & ddsPixelFormatFourCC)) return nullptr;
+
+		DDSImage* pImage{ new DDSImage{} };
+
+		// Get the block format from the FourCC code or from the DX10 header
+		switch (header.pixelFormat.fourCC)
+		{
+		case MakeFourCC('D', 'X', 'T', '1'):
+			pImage->m_Format = BlockFormat::BC1;
+			break;
+		case MakeFourCC('D', 'X', 'T', '5'):
+			pImage->m_Format = BlockFormat::BC3;
+			break;
+		case MakeFourCC('A', 'T', 'I', '2'):
+		case MakeFourCC('B', 'C', '5', 'U'):
+			pImage->m_Format = BlockFormat::BC5;
+			break;
+		case MakeFourCC('D', 'X', '1', '0'):
+		{
+			DDSHeaderDX10 headerDX10{};
+			file.read(reinterpret_cast<char*>(&headerDX10), sizeof(headerDX10));
+
+			switch (static_cast<DXGI_FORMAT>(headerDX10.dxgiFormat))
+			{
+			case DXGI_FORMAT_BC1_UNORM:
+				pImage->m_Format = BlockFormat::BC1;
+				break;
+			case DXGI_FORMAT_BC3_UNORM:
+				pImage->m_Format = BlockFormat::BC3;
+				break;
+			case DXGI_FORMAT_BC5_UNORM:
+				pImage->m_Format = BlockFormat::BC5;
+				break;
+			default:
+				delete pImage;
+				return nullptr;
+			}
+			break;
+		}
+		default:
+			delete pImage;
+			return nullptr;
+		}
+
+		pImage->m_Width = static_cast<int>(header.width);
+		pImage->m_Height = static_cast<int>(header.height);
+		pImage->m_NrMips = std::max(static_cast<int>(header.mipMapCount), 1);
+
+		// Calculate where every mip level starts in the block data
+		size_t totalSize{};
+		for (int mip{}; mip < pImage->m_NrMips; ++mip)
+		{
+			pImage->m_MipOffsets.push_back(totalSize);
+			totalSize += static_cast<size_t>(pImage->GetMipBlocksX(mip)) * pImage->GetMipBlocksY(mip) * pImage->GetBlockBytes();
+		}
+
+		// Read all the blocks
+		pImage->m_Blocks.resize(totalSize);
+		file.read(reinterpret_cast<char*>(pImage->m_Blocks.data()), static_cast<std::streamsize>(totalSize));
+		if (!file || pImage->m_Width <= 0 || pImage->m_Height <= 0)
+		{
+			delete pImage;
+			return nullptr;
+		}
+
+		// Create an empty slot for every tile, tiles are only decoded when they are sampled
+		pImage->m_NrTilesX = (pImage->m_Width + m_TileSize - 1) / m_TileSize;
+		pImage->m_NrTilesY = (pImage->m_Height + m_TileSize - 1) / m_TileSize;
+		pImage->m_pTiles = std::make_unique<std::atomic<uint32_t*>[]>(static_cast<size_t>(pImage->m_NrTilesX) * pImage->m_NrTilesY);
+
+		return pImage;
+	}
+
+	int DDSImage::GetWidth() const
+	{
+		return m_Width;
+	}
+
+	int DDSImage::GetHeight() const
+	{
+		return m_Height;
+	}
+
+	int DDSImage::GetNrMips() const
+	{
+		return m_NrMips;
+	}
+
+	DXGI_FORMAT DDSImage::GetFormat() const
+	{
+		switch (m_Format)
+		{
+		case BlockFormat::BC1:
+			return DXGI_FORMAT_BC1_UNORM;
+		case BlockFormat::BC3:
+			return DXGI_FORMAT_BC3_UNORM;
+		case BlockFormat::BC5:
+			return DXGI_FORMAT_BC5_UNORM;
+		}
+		return DXGI_FORMAT_UNKNOWN;
+	}
+
+	bool DDSImage::IsTwoChannel() const
+	{
+		return m_Format == BlockFormat::BC5;
+	}
+
+	std::vector<D3D11_SUBRESOURCE_DATA> DDSImage::GetInitData() const
+	{
+		std::vector<D3D11_SUBRESOURCE_DATA> initData(m_NrMips);
+		for (int mip{}; mip < m_NrMips; ++mip)
+		{
+			// Every row of blocks covers 4 rows of texels
+			const UINT blockRowPitch{ static_cast<UINT>(GetMipBlocksX(mip) * GetBlockBytes()) };
+
+			initData[mip].pSysMem = m_Blocks.data() + m_MipOffsets[mip];
+			initData[mip].SysMemPitch = blockRowPitch;
+			initData[mip].SysMemSlicePitch = blockRowPitch * GetMipBlocksY(mip);
+		}
+		return initData;
+	}
+
+	size_t DDSImage::GetSize() const
+	{
+		return m_Blocks.size() + m_NrDecodedTiles * m_TileSize * m_TileSize * sizeof(uint32_t);
+	}
+
+	uint32_t DDSImage::GetTexel(int x, int y) const
+	{
+		const int tileX{ x / m_TileSize };
+		const int tileY{ y / m_TileSize };
+
+		// Decode the tile if this is the first time it is sampled
+		const uint32_t* pTile{ m_pTiles[tileX + tileY * m_NrTilesX].load(std::memory_order_acquire) };
+		if (!pTile) pTile = DecodeTile(tileX, tileY);
+
+		return pTile[(x % m_TileSize) + (y % m_TileSize) * m_TileSize];
+	}
+
+	size_t DDSImage::GetBlockBytes() const
+	{
+		// BC1 uses 8 bytes per block, BC3 and BC5 use 16 bytes per block
+		return m_Format == BlockFormat::BC1 ? 8 : 16;
+	}
+
+	int DDSImage::GetMipBlocksX(int mip) const
+	{
+		return std::max((std::max(m_Width >> mip, 1) + m_BlockSize - 1) / m_BlockSize, 1);
+	}
+
+	int DDSImage::GetMipBlocksY(int mip) const
+	{
+		return std::max((std::max(m_Height >> mip, 1) + m_BlockSize - 1) / m_BlockSize, 1);
+	}
+
+	uint32_t* DDSImage::DecodeTile(int tileX, int tileY) const
+	{
+		constexpr int blocksPerTile{ m_TileSize / m_BlockSize };
+
+		uint32_t* pTile{ new uint32_t[m_TileSize * m_TileSize]{} };
+
+		const int nrBlocksX{ GetMipBlocksX(0) };
+		const int nrBlocksY{ GetMipBlocksY(0) };
+
+		// Decode every block in this tile that lies inside the image
+		for (int tileBlockY{}; tileBlockY < blocksPerTile; ++tileBlockY)
+		{
+			const int blockY{ tileY * blocksPerTile + tileBlockY };
+			if (blockY >= nrBlocksY) break;
+
+			for (int tileBlockX{}; tileBlockX < blocksPerTile; ++tileBlockX)
+			{
+				const int blockX{ tileX * blocksPerTile + tileBlockX };
+				if (blockX >= nrBlocksX) break;
+
+				uint32_t blockTexels[m_BlockSize * m_BlockSize];
+				DecodeBlock(m_Blocks.data() + (blockX + static_cast<size_t>(blockY) * nrBlocksX) * GetBlockBytes(), blockTexels);
+
+				// Copy the rows of the block into the tile
+				for (int row{}; row < m_BlockSize; ++row)
+				{
+					uint32_t* pTileRow{ pTile + (tileBlockY * m_BlockSize + row) * m_TileSize + tileBlockX * m_BlockSize };
+					std::copy_n(blockTexels + row * m_BlockSize, m_BlockSize, pTileRow);
+				}
+			}
+		}
+
+		// Publish the tile, if another thread decoded the same tile first, use that one instead
+		std::atomic<uint32_t*>& tileSlot{ m_pTiles[tileX + tileY * m_NrTilesX] };
+		uint32_t* pExpected{ nullptr };
+		if (!tileSlot.compare_exchange_strong(pExpected, pTile, std::memory_order_acq_rel))
+		{
+			delete[] pTile;
+			return pExpected;
+		}
+
+		++m_NrDecodedTiles;
+		return pTile;
+	}
+
+	void DDSImage::DecodeBlock(const uint8_t* pBlock, uint32_t* pTexels) const
+	{
+		constexpr int nrTexels{ m_BlockSize * m_BlockSize };
+
+		switch (m_Format)
+		{
+		case BlockFormat::BC1:
+		{
+			DecodeColorBlock(pBlock, pTexels, true);
+			break;
+		}
+		case BlockFormat::BC3:
+		{
+			// An alpha block followed by a color block
+			uint8_t alphas[nrTexels];
+			DecodeChannelBlock(pBlock, alphas);
+			DecodeColorBlock(pBlock + 8, pTexels, false);
+
+			for (int i{}; i < nrTexels; ++i)
+			{
+				pTexels[i] = (pTexels[i] & 0x00FFFFFF) | static_cast<uint32_t>(alphas[i]) << 24;
+			}
+			break;
+		}
+		case BlockFormat::BC5:
+		{
+			// A red block followed by a green block
+			uint8_t reds[nrTexels];
+			uint8_t greens[nrTexels];
+			DecodeChannelBlock(pBlock, reds);
+			DecodeChannelBlock(pBlock + 8, greens);
+
+			for (int i{}; i < nrTexels; ++i)
+			{
+				pTexels[i] = reds[i] | static_cast<uint32_t>(greens[i]) << 8 | 0xFF000000;
+			}
+			break;
+		}
+		}
+	}
+
+	// Source: https://learn.microsoft.com/en-us/windows/win32/direct3d10/d3d10-graphics-programming-guide-resources-block-compression
+	void DDSImage::DecodeColorBlock(const uint8_t* pBlock, uint32_t* pTexels, bool isAlphaAllowed)
+	{
+		const uint16_t color0{ static_cast<uint16_t>(pBlock[0] | pBlock[1] << 8) };
+		const uint16_t color1{ static_cast<uint16_t>(pBlock[2] | pBlock[3] << 8) };
+		const uint32_t indices{ static_cast<uint32_t>(pBlock[4] | pBlock[5] << 8 | pBlock[6] << 16 | pBlock[7] << 24) };
+
+		// Expand the 5:6:5 colors to 8 bits per channel
+		const auto expand
+		{
+			[](uint16_t color, int channels[3])
+			{
+				channels[0] = ((color >> 11) & 0x1F) * 255 / 31;
+				channels[1] = ((color >> 5) & 0x3F) * 255 / 63;
+				channels[2] = (color & 0x1F) * 255 / 31;
+			}
+		};
+
+		int palette[4][3]{};
+		expand(color0, palette[0]);
+		expand(color1, palette[1]);
+
+		// BC1 blocks with color0 <= color1 use 3 colors and transparent black
+		const bool hasTransparency{ isAlphaAllowed && color0 <= color1 };
+		for (int channel{}; channel < 3; ++channel)
+		{
+			if (hasTransparency)
+			{
+				palette[2][channel] = (palette[0][channel] + palette[1][channel]) / 2;
+				palette[3][channel] = 0;
+			}
+			else
+			{
+				palette[2][channel] = (2 * palette[0][channel] + palette[1][channel]) / 3;
+				palette[3][channel] = (palette[0][channel] + 2 * palette[1][channel]) / 3;
+			}
+		}
+
+		for (int i{}; i < m_BlockSize * m_BlockSize; ++i)
+		{
+			const uint32_t paletteIdx{ (indices >> (i * 2)) & 0x3 };
+			const uint32_t alpha{ hasTransparency && paletteIdx == 3 ? 0u : 255u };
+
+			pTexels[i] = static_cast<uint32_t>(palette[paletteIdx][0])
+				| static_cast<uint32_t>(palette[paletteIdx][1]) << 8
+				| static_cast<uint32_t>(palette[paletteIdx][2]) << 16
+				| alpha << 24;
+		}
+	}
+
+	void DDSImage::DecodeChannelBlock(const uint8_t* pBlock, uint8_t* pValues)
+	{
+		const int value0{ pBlock[0] };
+		const int value1{ pBlock[1] };
+
+		// The 16 indices of 3 bits each
+		uint64_t indices{};
+		for (int i{}; i < 6; ++i)
+		{
+			indices |= static_cast<uint64_t>(pBlock[2 + i]) << (i * 8);
+		}
+
+		// Create the 8 values that can be used in this block
+		int palette[8]{ value0, value1 };
+		if (value0 > value1)
+		{
+			for (int i{ 1 }; i < 7; ++i)
+			{
+				palette[i + 1] = ((7 - i) * value0 + i * value1) / 7;
+			}
+		}
+		else
+		{
+			for (int i{ 1 }; i < 5; ++i)
+			{
+				palette[i + 1] = ((5 - i) * value0 + i * value1) / 5;
+			}
+			palette[6] = 0;
+			palette[7] = 255;
+		}
+
+		for (int i{}; i < m_BlockSize * m_BlockSize; ++i)
+		{
+			pValues[i] = static_cast<uint8_t>(palette[(indices >> (i * 3)) & 0x7]);
+		}
+	}
+}
@@ -0,0 +1,77 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <atomic>
+#include <memory>
+#include <cstdint>
+
+namespace dae
+{
+	// A block-compressed (BC1, BC3 or BC5) image loaded from a DDS file
+	// The blocks are uploaded as they are to the hardware rasterizer,
+	// the software rasterizer decodes the first mip level per tile the first time a tile is sampled
+	class DDSImage final
+	{
+	public:
+		~DDSImage();
+
+		DDSImage(const DDSImage& other) = delete;
+		DDSImage& operator=(const DDSImage& other) = delete;
+		DDSImage(DDSImage&& other) = delete;
+		DDSImage& operator=(DDSImage&& other) = delete;
+
+		// Returns nullptr if the file is not a DDS file with BC1, BC3 or BC5 data
+		static DDSImage* LoadFromFile(const std::string& path);
+
+		int GetWidth() const;
+		int GetHeight() const;
+		int GetNrMips() const;
+		DXGI_FORMAT GetFormat() const;
+		// BC5 only stores the red and green channel
+		bool IsTwoChannel() const;
+		// The initialize data of every mip level, pointing to the blocks of the image
+		std::vector<D3D11_SUBRESOURCE_DATA> GetInitData() const;
+		// The size of the compressed blocks and the decoded tiles in bytes
+		size_t GetSize() const;
+
+		// Returns a texel of the first mip level as RGBA32 (R8G8B8A8 in byte order), this is thread safe
+		uint32_t GetTexel(int x, int y) const;
+
+	private:
+		enum class BlockFormat
+		{
+			BC1,
+			BC3,
+			BC5
+		};
+
+		// The amount of texels in one row or column of a block
+		static constexpr int m_BlockSize{ 4 };
+		// The amount of texels in one row or column of a decoded tile (8x8 blocks)
+		static constexpr int m_TileSize{ 32 };
+
+		DDSImage() = default;
+
+		BlockFormat m_Format{};
+		int m_Width{};
+		int m_Height{};
+		int m_NrMips{};
+		std::vector<uint8_t> m_Blocks{};
+		std::vector<size_t> m_MipOffsets{};
+
+		int m_NrTilesX{};
+		int m_NrTilesY{};
+		std::unique_ptr<std::atomic<uint32_t*>[]> m_pTiles{};
+		mutable std::atomic<size_t> m_NrDecodedTiles{};
+
+		size_t GetBlockBytes() const;
+		int GetMipBlocksX(int mip) const;
+		int GetMipBlocksY(int mip) const;
+
+		uint32_t* DecodeTile(int tileX, int tileY) const;
+		void DecodeBlock(const uint8_t* pBlock, uint32_t* pTexels) const;
+
+		static void DecodeColorBlock(const uint8_t* pBlock, uint32_t* pTexels, bool isAlphaAllowed);
+		static void DecodeChannelBlock(const uint8_t* pBlock, uint8_t* pValues);
+	};
+}
@@ -1,5 +1,8 @@
 #pragma once
 #include "Math.h"
+#include <atomic>
+#include <thread>
+#include <bit>
 
 namespace dae
 {
@@ -24,6 +27,123 @@ namespace dae
 		None
 	};
 
+	// The resolution that transparent meshes are rendered at, the value is how much smaller the resolution is in each direction
+	enum class TransparencyResolution
+	{
+		Full = 1,
+		Half = 2,
+		Quarter = 4
+	};
+
+	// How the camera maps view depth to the depth buffer
+	enum class DepthProjection
+	{
+		// The near plane is at depth 0 and the far plane at depth 1
+		Standard,
+		// The near plane is at depth 1 and the far plane at depth 0
+		Reversed,
+		// The near plane is at depth 1 and there is no far plane, infinitely far away is depth 0
+		ReversedInfinite
+	};
+
+	// The format of the depth buffer of the software rasterizer, all formats are compared as unsigned integers
+	enum class DepthFormat
+	{
+		// The bits of the float depth, positive floats keep their order as integers, the same format as the depth buffer of the hardware rasterizer
+		Float32,
+		// Unsigned normalized depth in the lower 24 bits of 32 bits, the precision of a D24 buffer (the hardware rasterizer uses D32_FLOAT)
+		Unorm24,
+		// Unsigned normalized depth in 16 bits, half of the memory of the other formats
+		Unorm16
+	};
+
+	// The file format that the frames of the software rasterizer are captured in
+	enum class CaptureFormat
+	{
+		Off,
+		// Numbered binary PPM (P6) images
+		PPM,
+		// Numbered lossless QOI images
+		QOI,
+		// One YUV4MPEG2 stream (4:4:4), a new stream is started when the render resolution changes
+		Y4M
+	};
+
+	// The order of the channels in a packed 32 bit pixel of the back buffer, from the highest to the lowest byte (X is unused)
+	enum class PixelSwizzle
+	{
+		XRGB,
+		XBGR
+	};
+
+	// The state of a screen tile during the frame, tiles are only cleared when something is drawn in them
+	enum class TileClearState : uint8_t
+	{
+		Uncleared,
+		Clearing,
+		Cleared
+	};
+
+	enum class LightType
+	{
+		Directional,
+		Point,
+		Spot
+	};
+
+	struct Light
+	{
+		LightType type{ LightType::Directional };
+		Vector3 position{};
+		// The direction the light shines in (directional and spot lights)
+		Vector3 direction{ Vector3::UnitZ };
+		ColorRGB color{ 1.0f, 1.0f, 1.0f };
+		float intensity{ 1.0f };
+		// Point and spot lights have no influence beyond this distance
+		float range{ 10.0f };
+		// The cosines of the angles where a spot light starts to fade and where it is completely faded
+		float innerConeCos{ 0.9f };
+		float outerConeCos{ 0.8f };
+	};
+
+	// The size in pixels of the screen tiles used for light culling and variable rate shading
+	constexpr int LIGHT_TILE_SIZE{ 16 };
+
+	// The width and height in texels of the shadow map of both rasterizers
+	constexpr int SHADOW_MAP_SIZE{ 1024 };
+
+	// The amount of samples per pixel of multisample anti-aliasing in both rasterizers, and the sample mask with every sample set
+	constexpr int MSAA_SAMPLE_COUNT{ 4 };
+	constexpr uint32_t ALL_SAMPLES_MASK{ (1u << MSAA_SAMPLE_COUNT) - 1u };
+
+	// The directional light that casts shadows (-1 when no light casts shadows) and the matrix from world space to its shadow map
+	struct ShadowInfo
+	{
+		int lightIdx{ -1 };
+		Matrix lightViewProjectionMatrix{};
+		// How far the lookup position is moved along the normal to keep surfaces from shadowing themselves
+		float normalOffset{};
+	};
+
+	// How many pixels share one shaded color, one pixel per block is shaded and its color is copied to the other covered pixels
+	enum class ShadingRate
+	{
+		Rate1x1,
+		Rate2x2,
+		Rate4x4
+	};
+
+	// How the shading rate of every screen tile is chosen
+	enum class ShadingRatePolicy
+	{
+		// Every pixel is shaded
+		Off,
+		// Tiles with little variation in the previous frame are shaded at a lower rate
+		ContentAdaptive,
+		// The shading rate drops towards the edges of the screen
+		Foveated
+	};
+
 	struct Vertex
 	{
 		Vector3 position{};
@@ -42,24 +162,267 @@ namespace dae
 		Vector2 uv{};
 		ColorRGB color{ colors::White };
 		Vector3 viewDirection{};
+		Vector3 worldPosition{};
+		// The clip space position in the previous frame, only calculated when the reprojection cache is enabled
+		Vector4 previousPosition{};
+		// The change in uv to the next pixel on the row and column of the quad, used to select the mip level of the textures
+		Vector2 uvDdx{};
+		Vector2 uvDdy{};
 	};
 
-	struct SoftwareRenderInfo
+	// A 2x2 block of pixels that is rasterized and shaded as a unit, pixel i of the quad is at (x + i % 2, y + i / 2)
+	// Pixels that are not covered only interpolate their uv (helper pixels), so the uv derivatives are valid for every covered pixel
+	struct PixelQuad
 	{
-		~SoftwareRenderInfo()
+		int x{};
+		int y{};
+		// Bit i is set when pixel i is covered by the triangle and passed the depth test
+		uint32_t coverageMask{};
+		// The samples of every pixel that are covered and passed the depth test, all samples without multisampling
+		uint32_t sampleMasks[4]{};
+		float depths[4]{};
+		Vertex_Out pixels[4]{};
+
+		bool IsCovered(int quadPixel) const
+		{
+			return coverageMask & (1u << quadPixel);
+		}
+
+		// The change of an attribute to the next pixel on the same row (ddx_coarse in HLSL)
+		template<typename T>
+		T Ddx(T Vertex_Out::* pAttribute) const
+		{
+			return pixels[1].*pAttribute - pixels[0].*pAttribute;
+		}
+
+		// The change of an attribute to the next pixel in the same column (ddy_coarse in HLSL)
+		template<typename T>
+		T Ddy(T Vertex_Out::* pAttribute) const
 		{
-			delete[] pDepthBuffer;
+			return pixels[2].*pAttribute - pixels[0].*pAttribute;
 		}
+	};
 
+	// The opaque result of the previous frame, pixels that still show the same triangle at the same depth reuse its colors
+	struct ReprojectionCache
+	{
+		// The amount of frames a color can be reused before the pixel is shaded again
+		// This keeps view dependent lighting from getting stuck when the camera moves slowly
+		static constexpr uint8_t maxReuseAge{ 8 };
+		// The maximum difference between the cached and the reprojected view depth, relative to the depth
+		static constexpr float maxDepthDifference{ 0.01f };
+		// The reuse age of checkerboard pixels that couldn't be reprojected and are filled in from their neighbours
+		static constexpr uint8_t unresolvedAge{ 0xFF };
+
+		std::vector<uint32_t> colors{};
+		// The unclamped colors, used instead of the packed colors when the HDR buffer is enabled
+		std::vector<ColorRGB> hdrColors{};
+		// The view space depth of every pixel
+		std::vector<float> depths{};
+		// The triangle that is visible at every pixel, 0 when no triangle is visible
+		std::vector<uint32_t> triangleIds{};
+		// The amount of frames the color of every pixel has been reused
+		std::vector<uint8_t> reuseAges{};
+		Matrix viewProjectionMatrix{};
+		bool isValid{};
+	};
+
+	// The buffers are owned by the software renderer
+	struct SoftwareRenderInfo
+	{
 		int width{};
 		int height{};
 		bool isShowingBoundingBoxes{};
 		bool isShowingDepthBuffer{};
 		uint32_t* pBackBufferPixels{};
-		float* pDepthBuffer{}; 
-		SDL_Surface* pFrontBuffer{};
+		// The depth of every pixel stored in the depth format, 16 bit depths are packed in the first half of the buffer
+		// Use the depth functions below instead of reading the buffer directly
+		uint32_t* pDepthBuffer{};
+		DepthFormat depthFormat{ DepthFormat::Float32 };
+		// With reversed depth the near plane is at depth 1, closer pixels have a larger depth and the depth buffer is cleared to 0
+		bool isDepthReversed{};
 		SDL_Surface* pBackBuffer{};
+		// The channel order of the back buffer, queried once when the back buffer is created
+		PixelSwizzle pixelSwizzle{ PixelSwizzle::XRGB };
+		// The linear unclamped colors that shading and blending write to, nullptr when the colors are packed in the back buffer right away
+		// The HDR buffer is tonemapped into the back buffer at the end of the frame
+		ColorRGB* pHdrBuffer{};
+		// The depth codes and colors of the MSAA_SAMPLE_COUNT samples of every pixel, nullptr when multisampling is disabled or the samples are already resolved
+		// The samples are depth tested separately but a triangle is shaded once per pixel, the color goes to the samples it covers
+		// The opaque meshes are averaged into the pixels before the transparent meshes are rendered
+		uint32_t* pSampleDepthBuffer{};
+		ColorRGB* pSampleColorBuffer{};
 		bool isNormalMapActive{ true };
 		LightingMode lightingMode{ LightingMode::Combined };
+
+		// The lights of the scene and the indices of the lights that affect each screen tile
+		// The lights of tile i are tileLightIndices[tileLightOffsets[i]] until tileLightIndices[tileLightOffsets[i + 1]]
+		const Light* pLights{};
+		int nrLightTilesX{};
+		int nrLightTilesY{};
+		std::vector<uint32_t> tileLightOffsets{};
+		std::vector<uint32_t> tileLightIndices{};
+
+		// The shading rate of every screen tile (same tiles as the light culling)
+		std::vector<ShadingRate> tileShadingRates{};
+
+		// The previous frame (nullptr when the reprojection cache is disabled) and the triangle ids and reuse ages of this frame
+		// The cache is also used by checkerboard rendering, so it only reuses colors of shaded pixels when isReprojectionCacheEnabled is set
+		const ReprojectionCache* pReprojectionCache{};
+		uint32_t* pTriangleIdBuffer{};
+		uint8_t* pReuseAgeBuffer{};
+		bool isReprojectionCacheEnabled{};
+
+		// In checkerboard mode only the pixels where (px + py + checkerboardParity) is even are shaded
+		bool isCheckerboardEnabled{};
+		int checkerboardParity{};
+
+		// The shadow map of the shadow casting light (SHADOW_MAP_SIZE x SHADOW_MAP_SIZE), nullptr when no light casts shadows
+		const float* pShadowMap{};
+		ShadowInfo shadow{};
+
+		// The buffers of weighted blended order independent transparency, nullptr when transparent meshes are blended in triangle order
+		// The accumulation holds the sum of the weighted premultiplied colors (alpha holds the sum of the weighted alphas), the revealage holds the product of (1 - alpha)
+		ColorRGB* pTransparencyAccumulation{};
+		float* pTransparencyRevealage{};
+
+		// The clear state of every screen tile (same tiles as the light culling), nullptr when the buffers don't have to be cleared
+		// A tile gets the clear values the first time a triangle touches it, the tiles that are never touched are cleared after the opaque meshes
+		std::atomic<TileClearState>* pTileClearStates{};
+		// The background in the back buffer (packed) and in the HDR buffer
+		uint32_t clearPixel{};
+		ColorRGB clearColor{};
+
+		// Converts a depth in [0, 1] (or FLT_MAX for the clear value) to the integer stored in the depth buffer, the depth formats keep their order as integers
+		uint32_t EncodeDepth(float depth) const
+		{
+			constexpr float maxUnorm24{ static_cast<float>(0xFFFFFF) };
+			constexpr float maxUnorm16{ static_cast<float>(0xFFFF) };
+
+			switch (depthFormat)
+			{
+			case DepthFormat::Unorm24:
+				return static_cast<uint32_t>(std::clamp(depth, 0.0f, 1.0f) * maxUnorm24 + 0.5f);
+			case DepthFormat::Unorm16:
+				return static_cast<uint32_t>(std::clamp(depth, 0.0f, 1.0f) * maxUnorm16 + 0.5f);
+			default:
+				return std::bit_cast<uint32_t>(depth);
+			}
+		}
+
+		float DecodeDepth(uint32_t depthCode) const
+		{
+			switch (depthFormat)
+			{
+			case DepthFormat::Unorm24:
+				return depthCode / static_cast<float>(0xFFFFFF);
+			case DepthFormat::Unorm16:
+				return depthCode / static_cast<float>(0xFFFF);
+			default:
+				return std::bit_cast<float>(depthCode);
+			}
+		}
+
+		uint32_t GetDepthCode(int pixelIdx) const
+		{
+			if (depthFormat == DepthFormat::Unorm16) return reinterpret_cast<const uint16_t*>(pDepthBuffer)[pixelIdx];
+			return pDepthBuffer[pixelIdx];
+		}
+
+		void SetDepthCode(int pixelIdx, uint32_t depthCode) const
+		{
+			if (depthFormat == DepthFormat::Unorm16) reinterpret_cast<uint16_t*>(pDepthBuffer)[pixelIdx] = static_cast<uint16_t>(depthCode);
+			else pDepthBuffer[pixelIdx] = depthCode;
+		}
+
+		float GetDepth(int pixelIdx) const
+		{
+			return DecodeDepth(GetDepthCode(pixelIdx));
+		}
+
+		// Returns if a depth is at least as close as the stored depth, a smaller integer is closer unless the depth is reversed
+		bool IsDepthVisible(uint32_t depthCode, uint32_t storedDepthCode) const
+		{
+			return isDepthReversed ? depthCode >= storedDepthCode : depthCode <= storedDepthCode;
+		}
+
+		// The depth code of the far plane
+		uint32_t GetClearDepthCode() const
+		{
+			return EncodeDepth(isDepthReversed ? 0.0f : FLT_MAX);
+		}
+
+		// Resets the depth of the pixels from start to end (exclusive) to the far plane
+		void ClearDepth(int startPixelIdx, int endPixelIdx) const
+		{
+			const uint32_t clearDepthCode{ GetClearDepthCode() };
+			if (depthFormat == DepthFormat::Unorm16)
+			{
+				uint16_t* pDepths{ reinterpret_cast<uint16_t*>(pDepthBuffer) };
+				std::fill(pDepths + startPixelIdx, pDepths + endPixelIdx, static_cast<uint16_t>(clearDepthCode));
+			}
+			else
+			{
+				std::fill(pDepthBuffer + startPixelIdx, pDepthBuffer + endPixelIdx, clearDepthCode);
+			}
+		}
+
+		int GetLightTileIdx(int px, int py) const
+		{
+			return px / LIGHT_TILE_SIZE + (py / LIGHT_TILE_SIZE) * nrLightTilesX;
+		}
+
+		// Clears all the tiles that are touched by the pixels from start to end (exclusive) if they weren't cleared yet this frame
+		void ClearTiles(int startX, int startY, int endX, int endY) const
+		{
+			if (!pTileClearStates || startX >= endX || startY >= endY) return;
+
+			for (int tileY{ startY / LIGHT_TILE_SIZE }; tileY <= (endY - 1) / LIGHT_TILE_SIZE; ++tileY)
+			{
+				for (int tileX{ startX / LIGHT_TILE_SIZE }; tileX <= (endX - 1) / LIGHT_TILE_SIZE; ++tileX)
+				{
+					ClearTile(tileX, tileY);
+				}
+			}
+		}
+
+		void ClearTile(int tileX, int tileY) const
+		{
+			std::atomic<TileClearState>& state{ pTileClearStates[tileX + tileY * nrLightTilesX] };
+			if (state.load(std::memory_order_acquire) == TileClearState::Cleared) return;
+
+			// Only one thread clears the tile, the other threads that touch it wait until it is done
+			TileClearState expectedState{ TileClearState::Uncleared };
+			if (!state.compare_exchange_strong(expectedState, TileClearState::Clearing, std::memory_order_acquire))
+			{
+				while (state.load(std::memory_order_acquire) != TileClearState::Cleared) std::this_thread::yield();
+				return;
+			}
+
+			// Reset every row of the tile
+			const int startX{ tileX * LIGHT_TILE_SIZE };
+			const int endX{ std::min(startX + LIGHT_TILE_SIZE, width) };
+			for (int py{ tileY * LIGHT_TILE_SIZE }; py < std::min((tileY + 1) * LIGHT_TILE_SIZE, height); ++py)
+			{
+				const int rowStartIdx{ startX + py * width };
+				const int rowEndIdx{ endX + py * width };
+
+				if (pSampleDepthBuffer)
+				{
+					// The pixels are overwritten when the samples are resolved
+					std::fill(pSampleDepthBuffer + rowStartIdx * MSAA_SAMPLE_COUNT, pSampleDepthBuffer + rowEndIdx * MSAA_SAMPLE_COUNT, GetClearDepthCode());
+					std::fill(pSampleColorBuffer + rowStartIdx * MSAA_SAMPLE_COUNT, pSampleColorBuffer + rowEndIdx * MSAA_SAMPLE_COUNT, clearColor);
+				}
+				else
+				{
+					ClearDepth(rowStartIdx, rowEndIdx);
+					if (pHdrBuffer) std::fill(pHdrBuffer + rowStartIdx, pHdrBuffer + rowEndIdx, clearColor);
+					else std::fill(pBackBufferPixels + rowStartIdx, pBackBufferPixels + rowEndIdx, clearPixel);
+				}
+				if (pTriangleIdBuffer) std::fill(pTriangleIdBuffer + rowStartIdx, pTriangleIdBuffer + rowEndIdx, 0u);
+			}
+
+			state.store(TileClearState::Cleared, std::memory_order_release);
+		}
 	};
 }
\ No newline at end of file
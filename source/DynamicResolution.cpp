@@ -0,0 +1,58 @@
+#include "pch.h"
+#include "DynamicResolution.h"
+
+namespace dae
+{
+	DynamicResolution::DynamicResolution(float targetFrameTime, float minScale, float maxScale)
+		: m_TargetFrameTime{ targetFrameTime }
+		, m_MinScale{ minScale }
+		, m_MaxScale{ maxScale }
+		, m_Scale{ maxScale }
+	{
+	}
+
+	bool DynamicResolution::Update(float frameTime)
+	{
+		m_FrameTimeSum += frameTime;
+		++m_NrFrames;
+
+		// Wait until enough frames are measured, a single slow frame shouldn't change the resolution
+		if (m_NrFrames < m_NrFramesPerDecision) return false;
+
+		const float averageFrameTime{ m_FrameTimeSum / m_NrFrames };
+		m_FrameTimeSum = 0.0f;
+		m_NrFrames = 0;
+
+		const float prevScale{ m_Scale };
+
+		// Lower the resolution when over budget, raise it when well within budget
+		// The gap between both thresholds keeps the resolution from switching back and forth
+		if (averageFrameTime > m_TargetFrameTime * m_DecreaseThreshold)
+		{
+			m_Scale = std::max(m_Scale - m_ScaleStep, m_MinScale);
+		}
+		else if (averageFrameTime < m_TargetFrameTime * m_IncreaseThreshold)
+		{
+			m_Scale = std::min(m_Scale + m_ScaleStep, m_MaxScale);
+		}
+
+		return m_Scale != prevScale;
+	}
+
+	void DynamicResolution::Reset()
+	{
+		m_Scale = m_MaxScale;
+		m_FrameTimeSum = 0.0f;
+		m_NrFrames = 0;
+	}
+
+	float DynamicResolution::GetScale() const
+	{
+		return m_Scale;
+	}
+
+	float DynamicResolution::GetTargetFrameTime() const
+	{
+		return m_TargetFrameTime;
+	}
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+namespace dae
+{
+	// Chooses the render resolution scale of the software rasterizer so the frame time stays within a budget
+	// The scale only changes after the frame time has been outside the budget for a while (hysteresis)
+	class DynamicResolution final
+	{
+	public:
+		DynamicResolution(float targetFrameTime, float minScale, float maxScale);
+		~DynamicResolution() = default;
+
+		DynamicResolution(const DynamicResolution&) = delete;
+		DynamicResolution(DynamicResolution&&) noexcept = delete;
+		DynamicResolution& operator=(const DynamicResolution&) = delete;
+		DynamicResolution& operator=(DynamicResolution&&) noexcept = delete;
+
+		// Adds the time of the last frame in seconds, returns true when the scale has changed
+		bool Update(float frameTime);
+		void Reset();
+
+		float GetScale() const;
+		float GetTargetFrameTime() const;
+
+	private:
+		// The fraction of the budget above which the resolution goes down and below which it goes up
+		static constexpr float m_DecreaseThreshold{ 1.05f };
+		static constexpr float m_IncreaseThreshold{ 0.8f };
+		// How much the scale changes per step
+		static constexpr float m_ScaleStep{ 0.1f };
+		// The amount of frames that are averaged before the scale can change
+		static constexpr int m_NrFramesPerDecision{ 15 };
+
+		float m_TargetFrameTime{};
+		float m_MinScale{};
+		float m_MaxScale{};
+		float m_Scale{};
+
+		float m_FrameTimeSum{};
+		int m_NrFrames{};
+	};
+}
@@ -0,0 +1,369 @@
+#include "pch.h"
+#include "FrameCapture.h"
+#include <iomanip>
+#include <ctime>
+
+namespace dae
+{
+	FrameCapture::FrameCapture(int poolSize)
+		: m_Frames(std::max(poolSize, 1))
+	{
+		// Every frame buffer can be filled at the start
+		for (int frameIdx{ static_cast<int>(m_Frames.size()) - 1 }; frameIdx >= 0; --frameIdx)
+		{
+			m_FreeFrames.push_back(frameIdx);
+		}
+
+		// The start time of the application keeps the captures apart from the ones of earlier runs
+		const std::time_t startTime{ std::time(nullptr) };
+		std::tm localStartTime{};
+		localtime_s(&localStartTime, &startTime);
+		std::stringstream startTimeStream{};
+		startTimeStream << std::put_time(&localStartTime, "%Y%m%d_%H%M%S");
+		m_StartTime = startTimeStream.str();
+
+		m_WriterThread = std::thread{ &FrameCapture::WriterLoop, this };
+	}
+
+	FrameCapture::~FrameCapture()
+	{
+		// Write the frames that are still queued and stop the writer thread
+		{
+			std::lock_guard lock{ m_Mutex };
+			m_IsStopping = true;
+		}
+		m_Condition.notify_all();
+		m_WriterThread.join();
+
+		CloseY4MStream();
+	}
+
+	void FrameCapture::SetFormat(CaptureFormat format)
+	{
+		// The writer thread is idle once every frame is written, so the stream can be closed here
+		Flush();
+		CloseY4MStream();
+
+		if (m_Format != CaptureFormat::Off && m_NrDroppedFrames > 0)
+		{
+			std::cout << "\033[35m"; // TEXT COLOR
+			std::cout << "**(SOFTWARE) Frame Capture dropped " << m_NrDroppedFrames << " of " << m_NextFrameIdx << " frames\n";
+		}
+
+		m_Format = format;
+		m_NextFrameIdx = 0;
+		m_NrDroppedFrames = 0;
+
+		// The frame indices start over, so every session writes its files with a new prefix
+		if (m_Format != CaptureFormat::Off) m_FileNamePrefix = "Capture_" + m_StartTime + "_" + std::to_string(++m_NrSessions) + "_";
+	}
+
+	CaptureFormat FrameCapture::GetFormat() const
+	{
+		return m_Format;
+	}
+
+	bool FrameCapture::Capture(const uint32_t* pPixels, int width, int height, PixelSwizzle swizzle)
+	{
+		if (m_Format == CaptureFormat::Off) return false;
+
+		const int frameIdx{ m_NextFrameIdx++ };
+		const auto time{ std::chrono::steady_clock::now() };
+
+		// Drop the frame when the writer thread is behind, rendering should never wait for the disk
+		int poolIdx{};
+		{
+			std::lock_guard lock{ m_Mutex };
+			if (m_FreeFrames.empty())
+			{
+				++m_NrDroppedFrames;
+				return false;
+			}
+
+			poolIdx = m_FreeFrames.back();
+			m_FreeFrames.pop_back();
+		}
+
+		// The buffer is only allocated again when the render resolution grows
+		Frame& frame{ m_Frames[poolIdx] };
+		frame.pixels.assign(pPixels, pPixels + static_cast<size_t>(width) * height);
+		frame.width = width;
+		frame.height = height;
+		frame.swizzle = swizzle;
+		frame.format = m_Format;
+		frame.frameIdx = frameIdx;
+		frame.time = time;
+
+		{
+			std::lock_guard lock{ m_Mutex };
+			m_Queue.push_back(poolIdx);
+		}
+		m_Condition.notify_all();
+
+		return true;
+	}
+
+	void FrameCapture::Flush()
+	{
+		std::unique_lock lock{ m_Mutex };
+		m_Condition.wait(lock, [&]() { return m_Queue.empty(); });
+	}
+
+	int FrameCapture::GetNrDroppedFrames() const
+	{
+		std::lock_guard lock{ m_Mutex };
+		return m_NrDroppedFrames;
+	}
+
+	void FrameCapture::WriterLoop()
+	{
+		while (true)
+		{
+			int poolIdx{};
+			{
+				std::unique_lock lock{ m_Mutex };
+				m_Condition.wait(lock, [&]() { return m_IsStopping || !m_Queue.empty(); });
+
+				// Only stop when every frame is written
+				if (m_Queue.empty()) return;
+
+				poolIdx = m_Queue.front();
+			}
+
+			WriteFrame(m_Frames[poolIdx]);
+
+			// The frame buffer can be filled again
+			{
+				std::lock_guard lock{ m_Mutex };
+				m_Queue.pop_front();
+				m_FreeFrames.push_back(poolIdx);
+			}
+			m_Condition.notify_all();
+		}
+	}
+
+	void FrameCapture::WriteFrame(const Frame& frame)
+	{
+		switch (frame.format)
+		{
+		case CaptureFormat::PPM:
+		{
+			EncodePPM(frame);
+
+			std::ofstream file{ GetFileName(frame.frameIdx, "ppm"), std::ios::binary | std::ios::trunc };
+			file.write(reinterpret_cast<const char*>(m_EncodedBytes.data()), static_cast<std::streamsize>(m_EncodedBytes.size()));
+			break;
+		}
+		case CaptureFormat::QOI:
+		{
+			EncodeQOI(frame);
+
+			std::ofstream file{ GetFileName(frame.frameIdx, "qoi"), std::ios::binary | std::ios::trunc };
+			file.write(reinterpret_cast<const char*>(m_EncodedBytes.data()), static_cast<std::streamsize>(m_EncodedBytes.size()));
+			break;
+		}
+		case CaptureFormat::Y4M:
+		{
+			// Every frame of a stream has the same size, so start a new stream when the render resolution changes
+			if (!m_Y4MStream.is_open() || frame.width != m_Y4MWidth || frame.height != m_Y4MHeight)
+			{
+				CloseY4MStream();
+				m_Y4MStream.open(GetFileName(frame.frameIdx, "y4m"), std::ios::binary | std::ios::trunc);
+				m_Y4MWidth = frame.width;
+				m_Y4MHeight = frame.height;
+				m_Y4MStartTime = frame.time;
+				m_NrY4MFrames = 0;
+
+				m_Y4MStream << "YUV4MPEG2 W" << frame.width << " H" << frame.height << " F" << m_Y4MFrameRate << ":1 Ip A1:1 C444\n";
+			}
+
+			else
+			{
+				// The previous frame is shown until this frame was captured, so it fills the frames of the stream before the capture time
+				// This repeats the previous frame when rendering is slower than the frame rate of the stream or frames were dropped
+				const double captureTime{ std::chrono::duration<double>(frame.time - m_Y4MStartTime).count() };
+				const int nrFramesBeforeCapture{ static_cast<int>(std::ceil(captureTime * m_Y4MFrameRate)) };
+				for (; m_NrY4MFrames < nrFramesBeforeCapture; ++m_NrY4MFrames)
+				{
+					m_Y4MStream.write(reinterpret_cast<const char*>(m_EncodedBytes.data()), static_cast<std::streamsize>(m_EncodedBytes.size()));
+				}
+			}
+
+			// The frame waits in the encoded bytes until the next frame is captured, a frame that is replaced before that is skipped
+			EncodeY4M(frame);
+			break;
+		}
+		default:
+			break;
+		}
+	}
+
+	void FrameCapture::CloseY4MStream()
+	{
+		if (!m_Y4MStream.is_open()) return;
+
+		// The last frame of the stream is still waiting in the encoded bytes
+		m_Y4MStream.write(reinterpret_cast<const char*>(m_EncodedBytes.data()), static_cast<std::streamsize>(m_EncodedBytes.size()));
+		m_Y4MStream.close();
+	}
+
+	void FrameCapture::EncodePPM(const Frame& frame)
+	{
+		const std::string header{ "P6\n" + std::to_string(frame.width) + " " + std::to_string(frame.height) + "\n255\n" };
+		m_EncodedBytes.assign(header.begin(), header.end());
+
+		// The pixels in rows from the top, 3 bytes per pixel
+		m_EncodedBytes.reserve(m_EncodedBytes.size() + frame.pixels.size() * 3);
+		for (uint32_t pixel : frame.pixels)
+		{
+			uint8_t r{}, g{}, b{};
+			GetChannels(pixel, frame.swizzle, r, g, b);
+			m_EncodedBytes.push_back(r);
+			m_EncodedBytes.push_back(g);
+			m_EncodedBytes.push_back(b);
+		}
+	}
+
+	void FrameCapture::EncodeQOI(const Frame& frame)
+	{
+		// The chunk tags of the "Quite OK Image" format
+		constexpr uint8_t opIndex{ 0x00 };
+		constexpr uint8_t opDiff{ 0x40 };
+		constexpr uint8_t opLuma{ 0x80 };
+		constexpr uint8_t opRun{ 0xC0 };
+		constexpr uint8_t opRGB{ 0xFE };
+		constexpr int maxRunLength{ 62 };
+
+		const auto writeBigEndian{ [&](uint32_t value)
+			{
+				m_EncodedBytes.push_back(static_cast<uint8_t>(value >> 24));
+				m_EncodedBytes.push_back(static_cast<uint8_t>(value >> 16));
+				m_EncodedBytes.push_back(static_cast<uint8_t>(value >> 8));
+				m_EncodedBytes.push_back(static_cast<uint8_t>(value));
+			} };
+
+		// Header: magic, size, 3 channels and sRGB with linear alpha
+		m_EncodedBytes.clear();
+		m_EncodedBytes.insert(m_EncodedBytes.end(), { 'q', 'o', 'i', 'f' });
+		writeBigEndian(static_cast<uint32_t>(frame.width));
+		writeBigEndian(static_cast<uint32_t>(frame.height));
+		m_EncodedBytes.push_back(3);
+		m_EncodedBytes.push_back(0);
+
+		// The previously seen colors by hash, the alpha is always opaque so it's left out of the stored colors
+		constexpr int nrIndexColors{ 64 };
+		constexpr int opaqueAlphaHash{ 255 * 11 };
+		uint32_t indexColors[nrIndexColors]{};
+
+		uint8_t prevR{}, prevG{}, prevB{};
+		int runLength{};
+
+		for (size_t pixelIdx{}; pixelIdx < frame.pixels.size(); ++pixelIdx)
+		{
+			uint8_t r{}, g{}, b{};
+			GetChannels(frame.pixels[pixelIdx], frame.swizzle, r, g, b);
+
+			// Repeat the previous color
+			if (r == prevR && g == prevG && b == prevB)
+			{
+				++runLength;
+				if (runLength == maxRunLength || pixelIdx == frame.pixels.size() - 1)
+				{
+					m_EncodedBytes.push_back(static_cast<uint8_t>(opRun | (runLength - 1)));
+					runLength = 0;
+				}
+				continue;
+			}
+
+			if (runLength > 0)
+			{
+				m_EncodedBytes.push_back(static_cast<uint8_t>(opRun | (runLength - 1)));
+				runLength = 0;
+			}
+
+			// The colors in the index start as transparent black, which is never a captured color
+			const uint32_t color{ 0xFF000000u | (static_cast<uint32_t>(r) << 16) | (static_cast<uint32_t>(g) << 8) | b };
+			const int hash{ (r * 3 + g * 5 + b * 7 + opaqueAlphaHash) % nrIndexColors };
+
+			if (indexColors[hash] == color)
+			{
+				m_EncodedBytes.push_back(static_cast<uint8_t>(opIndex | hash));
+			}
+			else
+			{
+				indexColors[hash] = color;
+
+				// The differences wrap around like the bytes of the channels
+				const int diffR{ static_cast<int8_t>(r - prevR) };
+				const int diffG{ static_cast<int8_t>(g - prevG) };
+				const int diffB{ static_cast<int8_t>(b - prevB) };
+				const int diffRG{ diffR - diffG };
+				const int diffBG{ diffB - diffG };
+
+				if (diffR >= -2 && diffR <= 1 && diffG >= -2 && diffG <= 1 && diffB >= -2 && diffB <= 1)
+				{
+					m_EncodedBytes.push_back(static_cast<uint8_t>(opDiff | ((diffR + 2) << 4) | ((diffG + 2) << 2) | (diffB + 2)));
+				}
+				else if (diffG >= -32 && diffG <= 31 && diffRG >= -8 && diffRG <= 7 && diffBG >= -8 && diffBG <= 7)
+				{
+					m_EncodedBytes.push_back(static_cast<uint8_t>(opLuma | (diffG + 32)));
+					m_EncodedBytes.push_back(static_cast<uint8_t>(((diffRG + 8) << 4) | (diffBG + 8)));
+				}
+				else
+				{
+					m_EncodedBytes.insert(m_EncodedBytes.end(), { opRGB, r, g, b });
+				}
+			}
+
+			prevR = r;
+			prevG = g;
+			prevB = b;
+		}
+
+		// End marker
+		m_EncodedBytes.insert(m_EncodedBytes.end(), { 0, 0, 0, 0, 0, 0, 0, 1 });
+	}
+
+	void FrameCapture::EncodeY4M(const Frame& frame)
+	{
+		const size_t nrPixels{ frame.pixels.size() };
+
+		const char frameHeader[]{ "FRAME\n" };
+		m_EncodedBytes.assign(frameHeader, frameHeader + sizeof(frameHeader) - 1);
+
+		// The Y, U and V planes after each other at full resolution
+		const size_t planesStart{ m_EncodedBytes.size() };
+		m_EncodedBytes.resize(planesStart + nrPixels * 3);
+		uint8_t* pY{ m_EncodedBytes.data() + planesStart };
+		uint8_t* pU{ pY + nrPixels };
+		uint8_t* pV{ pU + nrPixels };
+
+		for (size_t pixelIdx{}; pixelIdx < nrPixels; ++pixelIdx)
+		{
+			uint8_t r{}, g{}, b{};
+			GetChannels(frame.pixels[pixelIdx], frame.swizzle, r, g, b);
+
+			// BT.601 with the limited (16 - 235) range that players expect from Y4M
+			pY[pixelIdx] = static_cast<uint8_t>(((66 * r + 129 * g + 25 * b + 128) >> 8) + 16);
+			pU[pixelIdx] = static_cast<uint8_t>(((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128);
+			pV[pixelIdx] = static_cast<uint8_t>(((112 * r - 94 * g - 18 * b + 128) >> 8) + 128);
+		}
+	}
+
+	std::string FrameCapture::GetFileName(int frameIdx, const char* pExtension) const
+	{
+		std::stringstream fileName{};
+		fileName << m_FileNamePrefix << std::setw(6) << std::setfill('0') << frameIdx << "." << pExtension;
+		return fileName.str();
+	}
+
+	void FrameCapture::GetChannels(uint32_t pixel, PixelSwizzle swizzle, uint8_t& r, uint8_t& g, uint8_t& b)
+	{
+		const uint8_t high{ static_cast<uint8_t>(pixel >> 16) };
+		const uint8_t low{ static_cast<uint8_t>(pixel) };
+
+		r = swizzle == PixelSwizzle::XRGB ? high : low;
+		g = static_cast<uint8_t>(pixel >> 8);
+		b = swizzle == PixelSwizzle::XRGB ? low : high;
+	}
+}
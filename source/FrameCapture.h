@@ -0,0 +1,95 @@
+#pragma once
+#include <string>
+#include <fstream>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <chrono>
+#include "DataTypes.h"
+
+namespace dae
+{
+	// Writes the frames of the software rasterizer to disk on a separate thread
+	// A frame is copied into a free buffer of a fixed pool and encoded later, when every buffer is still waiting to be written the frame is dropped instead of waiting
+	// The files are numbered with the index of the captured frame, so dropped frames show up as gaps
+	// Every time capturing starts the files get a new prefix (the start time of the application and the number of the session), so earlier captures are never overwritten
+	// A Y4M stream has a fixed frame rate, the frames are repeated or skipped to match the time they were captured at
+	class FrameCapture final
+	{
+	public:
+		FrameCapture(int poolSize);
+		~FrameCapture();
+
+		FrameCapture(const FrameCapture&) = delete;
+		FrameCapture(FrameCapture&&) noexcept = delete;
+		FrameCapture& operator=(const FrameCapture&) = delete;
+		FrameCapture& operator=(FrameCapture&&) noexcept = delete;
+
+		// Waits until the frames of the previous format are written and starts capturing in the new format (Off stops capturing)
+		void SetFormat(CaptureFormat format);
+		CaptureFormat GetFormat() const;
+
+		// Copies the pixels of a frame (unpadded rows) to be written, returns false when the frame is dropped
+		bool Capture(const uint32_t* pPixels, int width, int height, PixelSwizzle swizzle);
+		// Waits until every captured frame is written
+		void Flush();
+
+		int GetNrDroppedFrames() const;
+
+	private:
+		struct Frame
+		{
+			std::vector<uint32_t> pixels{};
+			int width{};
+			int height{};
+			PixelSwizzle swizzle{ PixelSwizzle::XRGB };
+			CaptureFormat format{ CaptureFormat::Off };
+			int frameIdx{};
+			std::chrono::steady_clock::time_point time{};
+		};
+
+		static constexpr int m_Y4MFrameRate{ 60 };
+
+		CaptureFormat m_Format{ CaptureFormat::Off };
+		// The index of the next frame that is captured, also counts the dropped frames
+		int m_NextFrameIdx{};
+		int m_NrDroppedFrames{};
+
+		// The files of a session start with the same prefix
+		std::string m_StartTime{};
+		int m_NrSessions{};
+		std::string m_FileNamePrefix{};
+
+		// The frame buffers, the indices of the ones that can be filled and the ones that wait to be written in order
+		// The front of the queue stays in the queue while it is being written
+		std::vector<Frame> m_Frames{};
+		std::vector<int> m_FreeFrames{};
+		std::deque<int> m_Queue{};
+		bool m_IsStopping{};
+
+		// Only used by the writer thread
+		std::vector<uint8_t> m_EncodedBytes{};
+		std::ofstream m_Y4MStream{};
+		int m_Y4MWidth{};
+		int m_Y4MHeight{};
+		// The capture time of the first frame of the stream and the number of frames written to it, the last captured frame is written when the next one arrives
+		std::chrono::steady_clock::time_point m_Y4MStartTime{};
+		int m_NrY4MFrames{};
+
+		mutable std::mutex m_Mutex{};
+		std::condition_variable m_Condition{};
+		std::thread m_WriterThread{};
+
+		void WriterLoop();
+		void WriteFrame(const Frame& frame);
+		// Writes the frame that is waiting to be written and closes the stream
+		void CloseY4MStream();
+		void EncodePPM(const Frame& frame);
+		void EncodeQOI(const Frame& frame);
+		void EncodeY4M(const Frame& frame);
+
+		std::string GetFileName(int frameIdx, const char* pExtension) const;
+		static void GetChannels(uint32_t pixel, PixelSwizzle swizzle, uint8_t& r, uint8_t& g, uint8_t& b);
+	};
+}
@@ -1,6 +1,8 @@
 #include "pch.h"
 #include "HardwareRenderer.h"
 #include "Mesh.h"
+#include "Camera.h"
+#include "Material.h"
 
 namespace dae {
 
@@ -29,10 +31,21 @@ namespace dae {
 	HardwareRenderer::~HardwareRenderer()
 	{
 		if (m_pSampleState) m_pSampleState->Release();
+		if (m_pOpaqueDepthState) m_pOpaqueDepthState->Release();
+		if (m_pTransparentDepthState) m_pTransparentDepthState->Release();
+
+		ReleaseTransparencyBuffers();
+		ReleaseMultisampleBuffers();
+		if (m_pTransparencyEffect) m_pTransparencyEffect->Release();
+
+		if (m_pShadowMapResourceView) m_pShadowMapResourceView->Release();
+		if (m_pShadowMapView) m_pShadowMapView->Release();
+		if (m_pShadowMapBuffer) m_pShadowMapBuffer->Release();
 
 		if (m_pRenderTargetView) m_pRenderTargetView->Release();
 		if (m_pRenderTargetBuffer) m_pRenderTargetBuffer->Release();
 
+		if (m_pDepthStencilResourceView) m_pDepthStencilResourceView->Release();
 		if (m_pDepthStencilView) m_pDepthStencilView->Release();
 		if (m_pDepthStencilBuffer) m_pDepthStencilBuffer->Release();
 
@@ -57,26 +70,186 @@ namespace dae {
 		return m_pSampleState;
 	}
 
-	void HardwareRenderer::Render(const std::vector<Mesh*>& pMeshes, bool useUniformBackground) const
+	void HardwareRenderer::Render(const std::vector<Mesh*>& pMeshes, const ShadowInfo& shadow, const Camera* pCamera, bool useUniformBackground) const
 	{
 		if (!m_IsInitialized)
 			return;
 
+		// Render the depth of the scene seen from the shadow casting light
+		const bool hasShadowMap{ shadow.lightIdx >= 0 };
+		if (hasShadowMap) RenderShadowMap(pMeshes);
+
+		// Give the shadow map to the meshes
+		for (Mesh* pMesh : pMeshes)
+		{
+			pMesh->SetShadow(shadow, hasShadowMap ? m_pShadowMapResourceView : nullptr);
+		}
+
 		// Clear RTV and DSV
 		const ColorRGB clearColor{ useUniformBackground ? ColorRGB{ 0.1f, 0.1f, 0.1f } : ColorRGB{ 0.39f, 0.59f, 0.93f } };
-		m_pDeviceContext->ClearRenderTargetView(m_pRenderTargetView, &clearColor.r);
-		m_pDeviceContext->ClearDepthStencilView(m_pDepthStencilView, D3D11_CLEAR_DEPTH | D3D11_CLEAR_STENCIL, 1.0f, 0);
+		m_pDeviceContext->ClearRenderTargetView(GetSceneTargetView(), &clearColor.r);
+		m_pDeviceContext->ClearDepthStencilView(GetSceneDepthView(), D3D11_CLEAR_DEPTH, m_IsDepthReversed ? 0.0f : 1.0f, 0);
+
+		// Transparent meshes are rendered separately when they use a reduced resolution
+		const bool isTransparencyDownscaled{ m_pTransparencyBuffer != nullptr };
 
 		// Set pipeline + Invoke drawcalls (= render)
 		for (Mesh* pMesh : pMeshes)
 		{
+			if (isTransparencyDownscaled && pMesh->IsTransparent()) continue;
+
 			pMesh->HardwareRender(m_pDeviceContext);
 		}
 
+		// Render the transparent meshes at a reduced resolution and blend them over the opaque meshes
+		if (isTransparencyDownscaled) RenderReducedResolutionTransparency(pMeshes, pCamera);
+
+		// Average the samples into the back buffer
+		if (m_pMultisampleBuffer) m_pDeviceContext->ResolveSubresource(m_pRenderTargetBuffer, 0, m_pMultisampleBuffer, 0, DXGI_FORMAT_R8G8B8A8_UNORM);
+
 		// Present backbuffer (swap)
 		m_pSwapChain->Present(0, 0);
 	}
 
+	void HardwareRenderer::RenderShadowMap(const std::vector<Mesh*>& pMeshes) const
+	{
+		// The shadow map can't be bound as a shader resource while it's rendered to
+		UnbindShaderResources();
+
+		// Only render depth into the shadow map
+		m_pDeviceContext->OMSetRenderTargets(0, nullptr, m_pShadowMapView);
+		D3D11_VIEWPORT shadowViewport{};
+		shadowViewport.Width = static_cast<float>(SHADOW_MAP_SIZE);
+		shadowViewport.Height = static_cast<float>(SHADOW_MAP_SIZE);
+		shadowViewport.MaxDepth = 1.0f;
+		m_pDeviceContext->RSSetViewports(1, &shadowViewport);
+		m_pDeviceContext->ClearDepthStencilView(m_pShadowMapView, D3D11_CLEAR_DEPTH, 1.0f, 0);
+
+		for (Mesh* pMesh : pMeshes)
+		{
+			pMesh->HardwareRenderShadowMap(m_pDeviceContext);
+		}
+
+		// Bind the back buffer again
+		ID3D11RenderTargetView* const pSceneTargetView{ GetSceneTargetView() };
+		m_pDeviceContext->OMSetRenderTargets(1, &pSceneTargetView, GetSceneDepthView());
+		D3D11_VIEWPORT viewport{};
+		viewport.Width = static_cast<float>(m_Width);
+		viewport.Height = static_cast<float>(m_Height);
+		viewport.MaxDepth = 1.0f;
+		m_pDeviceContext->RSSetViewports(1, &viewport);
+	}
+
+	void HardwareRenderer::RenderReducedResolutionTransparency(const std::vector<Mesh*>& pMeshes, const Camera* pCamera) const
+	{
+		const int downscale{ static_cast<int>(m_TransparencyResolution) };
+		const Matrix& projectionMatrix{ pCamera->GetProjectionMatrix() };
+		const float depthProjection[4]{ projectionMatrix[2][2], projectionMatrix[3][2] };
+		m_pDownscaleVariable->SetInt(downscale);
+		m_pDepthProjectionVariable->SetFloatVector(depthProjection);
+		m_pIsDepthReversedVariable->SetBool(m_IsDepthReversed);
+
+		// The reduced resolution viewport
+		D3D11_TEXTURE2D_DESC transparencyDesc{};
+		m_pTransparencyBuffer->GetDesc(&transparencyDesc);
+		D3D11_VIEWPORT transparencyViewport{};
+		transparencyViewport.Width = static_cast<float>(transparencyDesc.Width);
+		transparencyViewport.Height = static_cast<float>(transparencyDesc.Height);
+		transparencyViewport.MaxDepth = 1.0f;
+		m_pDeviceContext->RSSetViewports(1, &transparencyViewport);
+
+		// Downsample the depth buffer, it can only be read while it's not bound as the depth buffer
+		// With multisampling the furthest sample of every pixel is used
+		const bool isMultisampled{ m_pMultisampleBuffer != nullptr };
+		m_pDeviceContext->OMSetRenderTargets(0, nullptr, m_pTransparencyDepthView);
+		if (isMultisampled) m_pMultisampleDepthMapVariable->SetResource(m_pMultisampleDepthResourceView);
+		else m_pDepthMapVariable->SetResource(m_pDepthStencilResourceView);
+		DrawFullScreen(isMultisampled ? m_pMultisampleDownsampleDepthTechnique : m_pDownsampleDepthTechnique);
+
+		// Render the transparent meshes, nothing covers the background yet
+		constexpr float clearColor[4]{ 0.0f, 0.0f, 0.0f, 1.0f };
+		m_pDeviceContext->ClearRenderTargetView(m_pTransparencyTargetView, clearColor);
+		m_pDeviceContext->OMSetRenderTargets(1, &m_pTransparencyTargetView, m_pTransparencyDepthView);
+		for (Mesh* pMesh : pMeshes)
+		{
+			pMesh->HardwareRenderReducedResolution(m_pDeviceContext);
+		}
+
+		// Upsample the transparent meshes over the back buffer
+		D3D11_VIEWPORT viewport{};
+		viewport.Width = static_cast<float>(m_Width);
+		viewport.Height = static_cast<float>(m_Height);
+		viewport.MaxDepth = 1.0f;
+		m_pDeviceContext->RSSetViewports(1, &viewport);
+		ID3D11RenderTargetView* const pSceneTargetView{ GetSceneTargetView() };
+		m_pDeviceContext->OMSetRenderTargets(1, &pSceneTargetView, nullptr);
+		m_pTransparencyMapVariable->SetResource(m_pTransparencyResourceView);
+		m_pTransparencyDepthMapVariable->SetResource(m_pTransparencyDepthResourceView);
+		DrawFullScreen(isMultisampled ? m_pMultisampleCompositeTechnique : m_pCompositeTechnique);
+
+		// Bind the depth buffer again
+		UnbindShaderResources();
+		m_pDeviceContext->OMSetRenderTargets(1, &pSceneTargetView, GetSceneDepthView());
+	}
+
+	void HardwareRenderer::DrawFullScreen(ID3DX11EffectTechnique* pTechnique) const
+	{
+		// The vertex shader creates one triangle that covers the screen from the vertex ids
+		m_pDeviceContext->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+		m_pDeviceContext->IASetInputLayout(nullptr);
+
+		D3DX11_TECHNIQUE_DESC techniqueDesc{};
+		pTechnique->GetDesc(&techniqueDesc);
+		for (UINT p{}; p < techniqueDesc.Passes; ++p)
+		{
+			pTechnique->GetPassByIndex(p)->Apply(0, m_pDeviceContext);
+			m_pDeviceContext->Draw(3, 0);
+		}
+	}
+
+	void HardwareRenderer::UnbindShaderResources() const
+	{
+		ID3D11ShaderResourceView* const pNullResourceViews[D3D11_COMMONSHADER_INPUT_RESOURCE_SLOT_COUNT]{};
+		m_pDeviceContext->PSSetShaderResources(0, D3D11_COMMONSHADER_INPUT_RESOURCE_SLOT_COUNT, pNullResourceViews);
+	}
+
+	void HardwareRenderer::SetTransparencyResolution(TransparencyResolution transparencyResolution)
+	{
+		m_TransparencyResolution = transparencyResolution;
+
+		// Recreate the reduced resolution buffers at the new size
+		ReleaseTransparencyBuffers();
+		if (!m_IsInitialized || m_TransparencyResolution == TransparencyResolution::Full) return;
+
+		const HRESULT result{ InitializeTransparencyBuffers() };
+		if (FAILED(result))
+		{
+			std::wcout << L"Transparency buffers failed to load\n";
+			ReleaseTransparencyBuffers();
+		}
+	}
+
+	void HardwareRenderer::SetMultisampling(bool isEnabled)
+	{
+		// Recreate the multisampled buffers
+		ReleaseMultisampleBuffers();
+		if (!m_IsInitialized) return;
+
+		if (isEnabled)
+		{
+			const HRESULT result{ InitializeMultisampleBuffers() };
+			if (FAILED(result))
+			{
+				std::wcout << L"Multisample buffers failed to load\n";
+				ReleaseMultisampleBuffers();
+			}
+		}
+
+		// Render to the multisampled buffers when they exist, otherwise to the back buffer
+		ID3D11RenderTargetView* const pSceneTargetView{ GetSceneTargetView() };
+		m_pDeviceContext->OMSetRenderTargets(1, &pSceneTargetView, GetSceneDepthView());
+	}
+
 	void HardwareRenderer::ToggleRenderSampleState(const std::vector<Mesh*>& pMeshes)
 	{
 		// Go to the next sample state
@@ -151,6 +324,40 @@ namespace dae {
 		pMeshes[0]->SetRasterizerState(m_pRasterizerState);
 	}
 
+	void HardwareRenderer::SetDepthProjection(DepthProjection depthProjection, const std::vector<Mesh*>& pMeshes)
+	{
+		m_IsDepthReversed = depthProjection != DepthProjection::Standard;
+
+		// Release the current depth stencil states if they exist
+		if (m_pOpaqueDepthState) m_pOpaqueDepthState->Release();
+		if (m_pTransparentDepthState) m_pTransparentDepthState->Release();
+		m_pOpaqueDepthState = nullptr;
+		m_pTransparentDepthState = nullptr;
+
+		if (m_IsDepthReversed)
+		{
+			// Closer pixels have a larger depth, transparent meshes are tested against the opaque meshes but don't write depth
+			D3D11_DEPTH_STENCIL_DESC depthStencilDesc{};
+			depthStencilDesc.DepthEnable = true;
+			depthStencilDesc.DepthWriteMask = D3D11_DEPTH_WRITE_MASK_ALL;
+			depthStencilDesc.DepthFunc = D3D11_COMPARISON_GREATER;
+			depthStencilDesc.StencilEnable = false;
+
+			HRESULT hr{ m_pDevice->CreateDepthStencilState(&depthStencilDesc, &m_pOpaqueDepthState) };
+			if (FAILED(hr)) std::wcout << L"m_pOpaqueDepthState failed to load\n";
+
+			depthStencilDesc.DepthWriteMask = D3D11_DEPTH_WRITE_MASK_ZERO;
+			hr = m_pDevice->CreateDepthStencilState(&depthStencilDesc, &m_pTransparentDepthState);
+			if (FAILED(hr)) std::wcout << L"m_pTransparentDepthState failed to load\n";
+		}
+
+		// Apply the depth stencil states, without a state the effects go back to the one they declare
+		for (const Mesh* pMesh : pMeshes)
+		{
+			pMesh->SetDepthStencilState(pMesh->IsTransparent() ? m_pTransparentDepthState : m_pOpaqueDepthState);
+		}
+	}
+
 	HRESULT HardwareRenderer::InitializeDirectX()
 	{
 		// Create Device and DeviceContext
@@ -202,23 +409,24 @@ namespace dae {
 		if (FAILED(result)) return result;
 
 		// Create DepthStencil (DS) and DepthStencilView (DSV)
+		// The depth is stored as a float, so the reversed depth projection keeps its precision up to the far plane (no stencil is used)
 		// Resource
 		D3D11_TEXTURE2D_DESC depthStencilDesc{};
 		depthStencilDesc.Width = m_Width;
 		depthStencilDesc.Height = m_Height;
 		depthStencilDesc.MipLevels = 1;
 		depthStencilDesc.ArraySize = 1;
-		depthStencilDesc.Format = DXGI_FORMAT_D24_UNORM_S8_UINT;
+		depthStencilDesc.Format = DXGI_FORMAT_R32_TYPELESS;
 		depthStencilDesc.SampleDesc.Count = 1;
 		depthStencilDesc.SampleDesc.Quality = 0;
 		depthStencilDesc.Usage = D3D11_USAGE_DEFAULT;
-		depthStencilDesc.BindFlags = D3D11_BIND_DEPTH_STENCIL;
+		depthStencilDesc.BindFlags = D3D11_BIND_DEPTH_STENCIL | D3D11_BIND_SHADER_RESOURCE;
 		depthStencilDesc.CPUAccessFlags = 0;
 		depthStencilDesc.MiscFlags = 0;
 
 		// View
 		D3D11_DEPTH_STENCIL_VIEW_DESC depthStencilViewDesc{};
-		depthStencilViewDesc.Format = depthStencilDesc.Format;
+		depthStencilViewDesc.Format = DXGI_FORMAT_D32_FLOAT;
 		depthStencilViewDesc.ViewDimension = D3D11_DSV_DIMENSION_TEXTURE2D;
 		depthStencilViewDesc.Texture2D.MipSlice = 0;
 
@@ -230,6 +438,15 @@ namespace dae {
 		result = m_pDevice->CreateDepthStencilView(m_pDepthStencilBuffer, &depthStencilViewDesc, &m_pDepthStencilView);
 		if (FAILED(result)) return result;
 
+		// Create the view that reads the depth
+		D3D11_SHADER_RESOURCE_VIEW_DESC depthResourceViewDesc{};
+		depthResourceViewDesc.Format = DXGI_FORMAT_R32_FLOAT;
+		depthResourceViewDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
+		depthResourceViewDesc.Texture2D.MipLevels = 1;
+
+		result = m_pDevice->CreateShaderResourceView(m_pDepthStencilBuffer, &depthResourceViewDesc, &m_pDepthStencilResourceView);
+		if (FAILED(result)) return result;
+
 		// Create RenderTarget (RT) and RenderTargetView (RTV)
 		// 
 		// Resource
@@ -253,9 +470,226 @@ namespace dae {
 		viewport.MaxDepth = 1.f;
 		m_pDeviceContext->RSSetViewports(1, &viewport);
 
+		result = InitializeShadowMap();
+		if (FAILED(result)) return result;
+
+		return InitializeTransparencyEffect();
+	}
+
+	HRESULT HardwareRenderer::InitializeShadowMap()
+	{
+		// The shadow map is written as a depth buffer and read as a float texture
+		D3D11_TEXTURE2D_DESC shadowMapDesc{};
+		shadowMapDesc.Width = SHADOW_MAP_SIZE;
+		shadowMapDesc.Height = SHADOW_MAP_SIZE;
+		shadowMapDesc.MipLevels = 1;
+		shadowMapDesc.ArraySize = 1;
+		shadowMapDesc.Format = DXGI_FORMAT_R32_TYPELESS;
+		shadowMapDesc.SampleDesc.Count = 1;
+		shadowMapDesc.SampleDesc.Quality = 0;
+		shadowMapDesc.Usage = D3D11_USAGE_DEFAULT;
+		shadowMapDesc.BindFlags = D3D11_BIND_DEPTH_STENCIL | D3D11_BIND_SHADER_RESOURCE;
+		shadowMapDesc.CPUAccessFlags = 0;
+		shadowMapDesc.MiscFlags = 0;
+
+		HRESULT result{ m_pDevice->CreateTexture2D(&shadowMapDesc, nullptr, &m_pShadowMapBuffer) };
+		if (FAILED(result)) return result;
+
+		// Depth view
+		D3D11_DEPTH_STENCIL_VIEW_DESC shadowMapViewDesc{};
+		shadowMapViewDesc.Format = DXGI_FORMAT_D32_FLOAT;
+		shadowMapViewDesc.ViewDimension = D3D11_DSV_DIMENSION_TEXTURE2D;
+		shadowMapViewDesc.Texture2D.MipSlice = 0;
+
+		result = m_pDevice->CreateDepthStencilView(m_pShadowMapBuffer, &shadowMapViewDesc, &m_pShadowMapView);
+		if (FAILED(result)) return result;
+
+		// Shader resource view
+		D3D11_SHADER_RESOURCE_VIEW_DESC shadowMapResourceViewDesc{};
+		shadowMapResourceViewDesc.Format = DXGI_FORMAT_R32_FLOAT;
+		shadowMapResourceViewDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
+		shadowMapResourceViewDesc.Texture2D.MipLevels = 1;
+
+		return m_pDevice->CreateShaderResourceView(m_pShadowMapBuffer, &shadowMapResourceViewDesc, &m_pShadowMapResourceView);
+	}
+
+	HRESULT HardwareRenderer::InitializeTransparencyEffect()
+	{
+		m_pTransparencyEffect = Material::LoadEffect(m_pDevice, L"Resources/TransparencyUpsample.fx");
+		if (!m_pTransparencyEffect) return E_FAIL;
+
+		// Save the techniques and variables of the effect as member variables
+		m_pDownsampleDepthTechnique = m_pTransparencyEffect->GetTechniqueByName("DownsampleDepthTechnique");
+		if (!m_pDownsampleDepthTechnique->IsValid()) std::wcout << L"m_pDownsampleDepthTechnique not valid\n";
+		m_pCompositeTechnique = m_pTransparencyEffect->GetTechniqueByName("CompositeTechnique");
+		if (!m_pCompositeTechnique->IsValid()) std::wcout << L"m_pCompositeTechnique not valid\n";
+		m_pMultisampleDownsampleDepthTechnique = m_pTransparencyEffect->GetTechniqueByName("MultisampleDownsampleDepthTechnique");
+		if (!m_pMultisampleDownsampleDepthTechnique->IsValid()) std::wcout << L"m_pMultisampleDownsampleDepthTechnique not valid\n";
+		m_pMultisampleCompositeTechnique = m_pTransparencyEffect->GetTechniqueByName("MultisampleCompositeTechnique");
+		if (!m_pMultisampleCompositeTechnique->IsValid()) std::wcout << L"m_pMultisampleCompositeTechnique not valid\n";
+		m_pDepthMapVariable = m_pTransparencyEffect->GetVariableByName("gDepthMap")->AsShaderResource();
+		if (!m_pDepthMapVariable->IsValid()) std::wcout << L"m_pDepthMapVariable not valid\n";
+		m_pMultisampleDepthMapVariable = m_pTransparencyEffect->GetVariableByName("gMultisampleDepthMap")->AsShaderResource();
+		if (!m_pMultisampleDepthMapVariable->IsValid()) std::wcout << L"m_pMultisampleDepthMapVariable not valid\n";
+		m_pTransparencyMapVariable = m_pTransparencyEffect->GetVariableByName("gTransparencyMap")->AsShaderResource();
+		if (!m_pTransparencyMapVariable->IsValid()) std::wcout << L"m_pTransparencyMapVariable not valid\n";
+		m_pTransparencyDepthMapVariable = m_pTransparencyEffect->GetVariableByName("gTransparencyDepthMap")->AsShaderResource();
+		if (!m_pTransparencyDepthMapVariable->IsValid()) std::wcout << L"m_pTransparencyDepthMapVariable not valid\n";
+		m_pDownscaleVariable = m_pTransparencyEffect->GetVariableByName("gDownscale")->AsScalar();
+		if (!m_pDownscaleVariable->IsValid()) std::wcout << L"m_pDownscaleVariable not valid\n";
+		m_pDepthProjectionVariable = m_pTransparencyEffect->GetVariableByName("gDepthProjection")->AsVector();
+		if (!m_pDepthProjectionVariable->IsValid()) std::wcout << L"m_pDepthProjectionVariable not valid\n";
+		m_pIsDepthReversedVariable = m_pTransparencyEffect->GetVariableByName("gIsDepthReversed")->AsScalar();
+		if (!m_pIsDepthReversedVariable->IsValid()) std::wcout << L"m_pIsDepthReversedVariable not valid\n";
+
 		return S_OK;
 	}
 
+	HRESULT HardwareRenderer::InitializeTransparencyBuffers()
+	{
+		// Round up so the reduced resolution covers every pixel
+		const int downscale{ static_cast<int>(m_TransparencyResolution) };
+
+		// The premultiplied color and the part of the background that is still visible, in floats so thin layers don't lose precision
+		D3D11_TEXTURE2D_DESC transparencyDesc{};
+		transparencyDesc.Width = (m_Width + downscale - 1) / downscale;
+		transparencyDesc.Height = (m_Height + downscale - 1) / downscale;
+		transparencyDesc.MipLevels = 1;
+		transparencyDesc.ArraySize = 1;
+		transparencyDesc.Format = DXGI_FORMAT_R16G16B16A16_FLOAT;
+		transparencyDesc.SampleDesc.Count = 1;
+		transparencyDesc.SampleDesc.Quality = 0;
+		transparencyDesc.Usage = D3D11_USAGE_DEFAULT;
+		transparencyDesc.BindFlags = D3D11_BIND_RENDER_TARGET | D3D11_BIND_SHADER_RESOURCE;
+		transparencyDesc.CPUAccessFlags = 0;
+		transparencyDesc.MiscFlags = 0;
+
+		HRESULT result{ m_pDevice->CreateTexture2D(&transparencyDesc, nullptr, &m_pTransparencyBuffer) };
+		if (FAILED(result)) return result;
+
+		result = m_pDevice->CreateRenderTargetView(m_pTransparencyBuffer, nullptr, &m_pTransparencyTargetView);
+		if (FAILED(result)) return result;
+
+		result = m_pDevice->CreateShaderResourceView(m_pTransparencyBuffer, nullptr, &m_pTransparencyResourceView);
+		if (FAILED(result)) return result;
+
+		// The downsampled depth is written as a depth buffer and read as a float texture
+		D3D11_TEXTURE2D_DESC transparencyDepthDesc{ transparencyDesc };
+		transparencyDepthDesc.Format = DXGI_FORMAT_R32_TYPELESS;
+		transparencyDepthDesc.BindFlags = D3D11_BIND_DEPTH_STENCIL | D3D11_BIND_SHADER_RESOURCE;
+
+		result = m_pDevice->CreateTexture2D(&transparencyDepthDesc, nullptr, &m_pTransparencyDepthBuffer);
+		if (FAILED(result)) return result;
+
+		D3D11_DEPTH_STENCIL_VIEW_DESC transparencyDepthViewDesc{};
+		transparencyDepthViewDesc.Format = DXGI_FORMAT_D32_FLOAT;
+		transparencyDepthViewDesc.ViewDimension = D3D11_DSV_DIMENSION_TEXTURE2D;
+		transparencyDepthViewDesc.Texture2D.MipSlice = 0;
+
+		result = m_pDevice->CreateDepthStencilView(m_pTransparencyDepthBuffer, &transparencyDepthViewDesc, &m_pTransparencyDepthView);
+		if (FAILED(result)) return result;
+
+		D3D11_SHADER_RESOURCE_VIEW_DESC transparencyDepthResourceViewDesc{};
+		transparencyDepthResourceViewDesc.Format = DXGI_FORMAT_R32_FLOAT;
+		transparencyDepthResourceViewDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
+		transparencyDepthResourceViewDesc.Texture2D.MipLevels = 1;
+
+		return m_pDevice->CreateShaderResourceView(m_pTransparencyDepthBuffer, &transparencyDepthResourceViewDesc, &m_pTransparencyDepthResourceView);
+	}
+
+	void HardwareRenderer::ReleaseTransparencyBuffers()
+	{
+		if (m_pTransparencyDepthResourceView) m_pTransparencyDepthResourceView->Release();
+		if (m_pTransparencyDepthView) m_pTransparencyDepthView->Release();
+		if (m_pTransparencyDepthBuffer) m_pTransparencyDepthBuffer->Release();
+		if (m_pTransparencyResourceView) m_pTransparencyResourceView->Release();
+		if (m_pTransparencyTargetView) m_pTransparencyTargetView->Release();
+		if (m_pTransparencyBuffer) m_pTransparencyBuffer->Release();
+
+		m_pTransparencyDepthResourceView = nullptr;
+		m_pTransparencyDepthView = nullptr;
+		m_pTransparencyDepthBuffer = nullptr;
+		m_pTransparencyResourceView = nullptr;
+		m_pTransparencyTargetView = nullptr;
+		m_pTransparencyBuffer = nullptr;
+	}
+
+	HRESULT HardwareRenderer::InitializeMultisampleBuffers()
+	{
+		// Every feature level 10.1 device supports 4 samples, but check it in case the sample count changes
+		UINT nrQualityLevels{};
+		HRESULT result{ m_pDevice->CheckMultisampleQualityLevels(DXGI_FORMAT_R8G8B8A8_UNORM, MSAA_SAMPLE_COUNT, &nrQualityLevels) };
+		if (FAILED(result)) return result;
+		if (nrQualityLevels == 0) return E_FAIL;
+
+		// The color has the format of the back buffer so it can be resolved into it
+		D3D11_TEXTURE2D_DESC multisampleDesc{};
+		multisampleDesc.Width = m_Width;
+		multisampleDesc.Height = m_Height;
+		multisampleDesc.MipLevels = 1;
+		multisampleDesc.ArraySize = 1;
+		multisampleDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+		multisampleDesc.SampleDesc.Count = MSAA_SAMPLE_COUNT;
+		multisampleDesc.SampleDesc.Quality = 0;
+		multisampleDesc.Usage = D3D11_USAGE_DEFAULT;
+		multisampleDesc.BindFlags = D3D11_BIND_RENDER_TARGET;
+		multisampleDesc.CPUAccessFlags = 0;
+		multisampleDesc.MiscFlags = 0;
+
+		result = m_pDevice->CreateTexture2D(&multisampleDesc, nullptr, &m_pMultisampleBuffer);
+		if (FAILED(result)) return result;
+
+		result = m_pDevice->CreateRenderTargetView(m_pMultisampleBuffer, nullptr, &m_pMultisampleTargetView);
+		if (FAILED(result)) return result;
+
+		// The depth has the format of the depth buffer and is also read when the transparent meshes are upsampled
+		D3D11_TEXTURE2D_DESC multisampleDepthDesc{ multisampleDesc };
+		multisampleDepthDesc.Format = DXGI_FORMAT_R32_TYPELESS;
+		multisampleDepthDesc.BindFlags = D3D11_BIND_DEPTH_STENCIL | D3D11_BIND_SHADER_RESOURCE;
+
+		result = m_pDevice->CreateTexture2D(&multisampleDepthDesc, nullptr, &m_pMultisampleDepthBuffer);
+		if (FAILED(result)) return result;
+
+		D3D11_DEPTH_STENCIL_VIEW_DESC multisampleDepthViewDesc{};
+		multisampleDepthViewDesc.Format = DXGI_FORMAT_D32_FLOAT;
+		multisampleDepthViewDesc.ViewDimension = D3D11_DSV_DIMENSION_TEXTURE2DMS;
+
+		result = m_pDevice->CreateDepthStencilView(m_pMultisampleDepthBuffer, &multisampleDepthViewDesc, &m_pMultisampleDepthView);
+		if (FAILED(result)) return result;
+
+		D3D11_SHADER_RESOURCE_VIEW_DESC multisampleDepthResourceViewDesc{};
+		multisampleDepthResourceViewDesc.Format = DXGI_FORMAT_R32_FLOAT;
+		multisampleDepthResourceViewDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2DMS;
+
+		return m_pDevice->CreateShaderResourceView(m_pMultisampleDepthBuffer, &multisampleDepthResourceViewDesc, &m_pMultisampleDepthResourceView);
+	}
+
+	void HardwareRenderer::ReleaseMultisampleBuffers()
+	{
+		if (m_pMultisampleDepthResourceView) m_pMultisampleDepthResourceView->Release();
+		if (m_pMultisampleDepthView) m_pMultisampleDepthView->Release();
+		if (m_pMultisampleDepthBuffer) m_pMultisampleDepthBuffer->Release();
+		if (m_pMultisampleTargetView) m_pMultisampleTargetView->Release();
+		if (m_pMultisampleBuffer) m_pMultisampleBuffer->Release();
+
+		m_pMultisampleDepthResourceView = nullptr;
+		m_pMultisampleDepthView = nullptr;
+		m_pMultisampleDepthBuffer = nullptr;
+		m_pMultisampleTargetView = nullptr;
+		m_pMultisampleBuffer = nullptr;
+	}
+
+	ID3D11RenderTargetView* HardwareRenderer::GetSceneTargetView() const
+	{
+		// With multisampling the scene is rendered in the multisampled buffers
+		return m_pMultisampleTargetView ? m_pMultisampleTargetView : m_pRenderTargetView;
+	}
+
+	ID3D11DepthStencilView* HardwareRenderer::GetSceneDepthView() const
+	{
+		return m_pMultisampleDepthView ? m_pMultisampleDepthView : m_pDepthStencilView;
+	}
+
 	void HardwareRenderer::LoadSampleState(D3D11_FILTER filter, const std::vector<Mesh*>& pMeshes)
 	{
 		// Create the SampleState description
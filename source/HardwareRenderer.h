@@ -7,6 +7,7 @@ struct SDL_Window;
 namespace dae
 {
 	class Mesh;
+	class Camera;
 
 	class HardwareRenderer final
 	{
@@ -21,11 +22,14 @@ namespace dae
 
 		void ToggleRenderSampleState(const std::vector<Mesh*>& pMeshes);
 		void SetRasterizerState(CullMode cullMode, const std::vector<Mesh*>& pMeshes);
+		void SetDepthProjection(DepthProjection depthProjection, const std::vector<Mesh*>& pMeshes);
+		void SetTransparencyResolution(TransparencyResolution transparencyResolution);
+		void SetMultisampling(bool isEnabled);
 
 		ID3D11Device* GetDevice() const;
 		ID3D11SamplerState* GetSampleState() const;
 
-		void Render(const std::vector<Mesh*>& pMeshes, bool useUniformBackground) const;
+		void Render(const std::vector<Mesh*>& pMeshes, const ShadowInfo& shadow, const Camera* pCamera, bool useUniformBackground) const;
 
 	private:
 		enum class SampleState
@@ -45,6 +49,10 @@ namespace dae
 		SampleState m_SampleState{ SampleState::Point };
 
 		ID3D11RasterizerState* m_pRasterizerState{};
+		// The depth tests of the opaque and transparent meshes, only created when the depth is reversed, otherwise the states of the effects are used
+		bool m_IsDepthReversed{};
+		ID3D11DepthStencilState* m_pOpaqueDepthState{};
+		ID3D11DepthStencilState* m_pTransparentDepthState{};
 		ID3D11SamplerState* m_pSampleState{};
 		ID3D11Device* m_pDevice{};
 		ID3D11DeviceContext* m_pDeviceContext{};
@@ -53,8 +61,55 @@ namespace dae
 		ID3D11DepthStencilView* m_pDepthStencilView{};
 		ID3D11Resource* m_pRenderTargetBuffer{};
 		ID3D11RenderTargetView* m_pRenderTargetView{};
+		ID3D11Texture2D* m_pShadowMapBuffer{};
+		ID3D11DepthStencilView* m_pShadowMapView{};
+		ID3D11ShaderResourceView* m_pShadowMapResourceView{};
+		// The depth buffer is also read when the transparent meshes are upsampled
+		ID3D11ShaderResourceView* m_pDepthStencilResourceView{};
+
+		// The scene is rendered in multisampled buffers that are resolved into the back buffer before it is shown, the buffers only exist when multisampling is enabled
+		ID3D11Texture2D* m_pMultisampleBuffer{};
+		ID3D11RenderTargetView* m_pMultisampleTargetView{};
+		ID3D11Texture2D* m_pMultisampleDepthBuffer{};
+		ID3D11DepthStencilView* m_pMultisampleDepthView{};
+		ID3D11ShaderResourceView* m_pMultisampleDepthResourceView{};
+
+		// Transparent meshes rendered at a reduced resolution, the buffers only exist when the resolution is not full
+		TransparencyResolution m_TransparencyResolution{ TransparencyResolution::Full };
+		ID3D11Texture2D* m_pTransparencyBuffer{};
+		ID3D11RenderTargetView* m_pTransparencyTargetView{};
+		ID3D11ShaderResourceView* m_pTransparencyResourceView{};
+		ID3D11Texture2D* m_pTransparencyDepthBuffer{};
+		ID3D11DepthStencilView* m_pTransparencyDepthView{};
+		ID3D11ShaderResourceView* m_pTransparencyDepthResourceView{};
+
+		// The full screen passes that downsample the depth buffer and upsample the transparent meshes
+		ID3DX11Effect* m_pTransparencyEffect{};
+		ID3DX11EffectTechnique* m_pDownsampleDepthTechnique{};
+		ID3DX11EffectTechnique* m_pCompositeTechnique{};
+		ID3DX11EffectTechnique* m_pMultisampleDownsampleDepthTechnique{};
+		ID3DX11EffectTechnique* m_pMultisampleCompositeTechnique{};
+		ID3DX11EffectShaderResourceVariable* m_pDepthMapVariable{};
+		ID3DX11EffectShaderResourceVariable* m_pMultisampleDepthMapVariable{};
+		ID3DX11EffectShaderResourceVariable* m_pTransparencyMapVariable{};
+		ID3DX11EffectShaderResourceVariable* m_pTransparencyDepthMapVariable{};
+		ID3DX11EffectScalarVariable* m_pDownscaleVariable{};
+		ID3DX11EffectVectorVariable* m_pDepthProjectionVariable{};
+		ID3DX11EffectScalarVariable* m_pIsDepthReversedVariable{};
 
 		HRESULT InitializeDirectX();
+		HRESULT InitializeShadowMap();
+		HRESULT InitializeTransparencyEffect();
+		HRESULT InitializeTransparencyBuffers();
+		void ReleaseTransparencyBuffers();
+		HRESULT InitializeMultisampleBuffers();
+		void ReleaseMultisampleBuffers();
+		ID3D11RenderTargetView* GetSceneTargetView() const;
+		ID3D11DepthStencilView* GetSceneDepthView() const;
+		void RenderShadowMap(const std::vector<Mesh*>& pMeshes) const;
+		void RenderReducedResolutionTransparency(const std::vector<Mesh*>& pMeshes, const Camera* pCamera) const;
+		void DrawFullScreen(ID3DX11EffectTechnique* pTechnique) const;
+		void UnbindShaderResources() const;
 		void LoadSampleState(D3D11_FILTER filter, const std::vector<Mesh*>& pMeshes);
 	};
 }
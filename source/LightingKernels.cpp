@@ -0,0 +1,203 @@
+#include "pch.h"
+#include "LightingKernels.h"
+#include <immintrin.h>
+
+namespace dae
+{
+	namespace LightingKernels
+	{
+		// The SSE registers hold 4 lanes, so a batch is shaded in groups of 4
+		constexpr int laneWidth{ 4 };
+
+		// Calculates log2(x) for positive, normalized x
+		// Source: minimax polynomials from "Fast SSE2 pow: tables or polynomials?" (J. Fonseca)
+		static __m128 Log2(__m128 x)
+		{
+			const __m128i exponentMask{ _mm_set1_epi32(0x7F800000) };
+			const __m128i mantissaMask{ _mm_set1_epi32(0x007FFFFF) };
+			const __m128 one{ _mm_set1_ps(1.0f) };
+
+			// Split x in its exponent and its mantissa in [1, 2)
+			const __m128i bits{ _mm_castps_si128(x) };
+			const __m128 exponent{ _mm_cvtepi32_ps(_mm_sub_epi32(_mm_srli_epi32(_mm_and_si128(bits, exponentMask), 23), _mm_set1_epi32(127))) };
+			const __m128 mantissa{ _mm_or_ps(_mm_castsi128_ps(_mm_and_si128(bits, mantissaMask)), one) };
+
+			// Approximate log2 of the mantissa, the polynomial is multiplied by (m - 1) so log2(1) is exactly 0
+			__m128 polynomial{ _mm_set1_ps(-3.4436006e-2f) };
+			polynomial = _mm_add_ps(_mm_mul_ps(polynomial, mantissa), _mm_set1_ps(3.1821337e-1f));
+			polynomial = _mm_add_ps(_mm_mul_ps(polynomial, mantissa), _mm_set1_ps(-1.2315303f));
+			polynomial = _mm_add_ps(_mm_mul_ps(polynomial, mantissa), _mm_set1_ps(2.5988452f));
+			polynomial = _mm_add_ps(_mm_mul_ps(polynomial, mantissa), _mm_set1_ps(-3.3241990f));
+			polynomial = _mm_add_ps(_mm_mul_ps(polynomial, mantissa), _mm_set1_ps(3.1157899f));
+
+			return _mm_add_ps(_mm_mul_ps(polynomial, _mm_sub_ps(mantissa, one)), exponent);
+		}
+
+		// Calculates 2^x, x is clamped to the range of normalized floats
+		static __m128 Exp2(__m128 x)
+		{
+			x = _mm_min_ps(_mm_max_ps(x, _mm_set1_ps(-126.99999f)), _mm_set1_ps(129.00000f));
+
+			// Split x in an integer part (rounded down) and a fraction in [0, 1)
+			const __m128i integerPart{ _mm_cvtps_epi32(_mm_sub_ps(x, _mm_set1_ps(0.5f))) };
+			const __m128 fraction{ _mm_sub_ps(x, _mm_cvtepi32_ps(integerPart)) };
+
+			// 2^integerPart is built directly in the exponent bits
+			const __m128 integerPower{ _mm_castsi128_ps(_mm_slli_epi32(_mm_add_epi32(integerPart, _mm_set1_epi32(127)), 23)) };
+
+			// Approximate 2^fraction
+			__m128 polynomial{ _mm_set1_ps(1.8775767e-3f) };
+			polynomial = _mm_add_ps(_mm_mul_ps(polynomial, fraction), _mm_set1_ps(8.9893397e-3f));
+			polynomial = _mm_add_ps(_mm_mul_ps(polynomial, fraction), _mm_set1_ps(5.5826318e-2f));
+			polynomial = _mm_add_ps(_mm_mul_ps(polynomial, fraction), _mm_set1_ps(2.4015361e-1f));
+			polynomial = _mm_add_ps(_mm_mul_ps(polynomial, fraction), _mm_set1_ps(6.9315308e-1f));
+			polynomial = _mm_add_ps(_mm_mul_ps(polynomial, fraction), _mm_set1_ps(9.9999994e-1f));
+
+			return _mm_mul_ps(integerPower, polynomial);
+		}
+
+		static __m128 FastPow(__m128 base, __m128 exponent)
+		{
+			// A base of 0 (or a denormal) can't go through log2, the result of these lanes is 0 (or 1 for an exponent of 0, like powf)
+			const __m128 isBaseValid{ _mm_cmpge_ps(base, _mm_set1_ps(FLT_MIN)) };
+			const __m128 invalidBaseResult{ _mm_and_ps(_mm_cmpeq_ps(exponent, _mm_setzero_ps()), _mm_set1_ps(1.0f)) };
+
+			const __m128 result{ Exp2(_mm_mul_ps(exponent, Log2(_mm_max_ps(base, _mm_set1_ps(FLT_MIN))))) };
+			return _mm_or_ps(_mm_and_ps(isBaseValid, result), _mm_andnot_ps(isBaseValid, invalidBaseResult));
+		}
+
+		void FastPow(const float* pBase, const float* pExponent, float* pResult)
+		{
+			_mm_storeu_ps(pResult, FastPow(_mm_loadu_ps(pBase), _mm_loadu_ps(pExponent)));
+		}
+
+		void Shade(const ShadingBatch& batch, const ColorBatch& diffuse, const ColorBatch& specular, const ColorBatch& glossiness,
+			LightingMode lightingMode, const LightingParameters& lighting, ColorBatch& colors)
+		{
+			const __m128 zero{ _mm_setzero_ps() };
+			const __m128 one{ _mm_set1_ps(1.0f) };
+			const __m128 shininess{ _mm_set1_ps(lighting.specularShininess) };
+
+			const bool isDiffuseNeeded{ lightingMode == LightingMode::Combined || lightingMode == LightingMode::Diffuse };
+			const bool isSpecularNeeded{ lightingMode == LightingMode::Combined || lightingMode == LightingMode::Specular };
+
+			for (int laneStart{}; laneStart < SHADING_BATCH_WIDTH; laneStart += laneWidth)
+			{
+				const __m128 normalX{ _mm_load_ps(batch.normalX + laneStart) };
+				const __m128 normalY{ _mm_load_ps(batch.normalY + laneStart) };
+				const __m128 normalZ{ _mm_load_ps(batch.normalZ + laneStart) };
+				const __m128 positionX{ _mm_load_ps(batch.worldPositionX + laneStart) };
+				const __m128 positionY{ _mm_load_ps(batch.worldPositionY + laneStart) };
+				const __m128 positionZ{ _mm_load_ps(batch.worldPositionZ + laneStart) };
+
+				// The phong exponent doesn't depend on the light
+				const __m128 specularExp{ _mm_mul_ps(shininess, _mm_load_ps(glossiness.r + laneStart)) };
+
+				__m128 r{ zero };
+				__m128 g{ zero };
+				__m128 b{ zero };
+
+				for (int lightIdx{}; lightIdx < lighting.nrLights; ++lightIdx)
+				{
+					const Light& light{ lighting.pLights[lighting.pLightIndices[lightIdx]] };
+					const bool isShadowed{ lighting.pShadowVisibility && static_cast<int>(lighting.pLightIndices[lightIdx]) == lighting.shadowLightIdx };
+
+					__m128 toLightX{ _mm_set1_ps(-light.direction.x) };
+					__m128 toLightY{ _mm_set1_ps(-light.direction.y) };
+					__m128 toLightZ{ _mm_set1_ps(-light.direction.z) };
+					__m128 falloff{ one };
+
+					if (light.type != LightType::Directional)
+					{
+						// Calculate the direction and distance towards the light
+						toLightX = _mm_sub_ps(_mm_set1_ps(light.position.x), positionX);
+						toLightY = _mm_sub_ps(_mm_set1_ps(light.position.y), positionY);
+						toLightZ = _mm_sub_ps(_mm_set1_ps(light.position.z), positionZ);
+						const __m128 distance{ _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(toLightX, toLightX), _mm_mul_ps(toLightY, toLightY)), _mm_mul_ps(toLightZ, toLightZ))) };
+						const __m128 inverseDistance{ _mm_div_ps(one, distance) };
+						toLightX = _mm_mul_ps(toLightX, inverseDistance);
+						toLightY = _mm_mul_ps(toLightY, inverseDistance);
+						toLightZ = _mm_mul_ps(toLightZ, inverseDistance);
+
+						// Fade the light out towards its range
+						const __m128 distanceFalloff{ _mm_max_ps(_mm_sub_ps(one, _mm_mul_ps(distance, _mm_set1_ps(1.0f / light.range))), zero) };
+						falloff = _mm_mul_ps(distanceFalloff, distanceFalloff);
+
+						if (light.type == LightType::Spot)
+						{
+							// Fade the spot light out between the inner and outer cone
+							const __m128 coneCos{ _mm_sub_ps(zero, _mm_add_ps(_mm_add_ps(
+								_mm_mul_ps(toLightX, _mm_set1_ps(light.direction.x)),
+								_mm_mul_ps(toLightY, _mm_set1_ps(light.direction.y))),
+								_mm_mul_ps(toLightZ, _mm_set1_ps(light.direction.z)))) };
+							const __m128 coneFalloff{ _mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_sub_ps(coneCos, _mm_set1_ps(light.outerConeCos)),
+								_mm_set1_ps(1.0f / (light.innerConeCos - light.outerConeCos))), zero), one) };
+							falloff = _mm_mul_ps(falloff, coneFalloff);
+						}
+					}
+
+					// Scale the light by the shadow visibility
+					if (isShadowed) falloff = _mm_mul_ps(falloff, _mm_load_ps(lighting.pShadowVisibility + laneStart));
+
+					// Calculate the observed area
+					const __m128 normalDotLight{ _mm_add_ps(_mm_add_ps(_mm_mul_ps(normalX, toLightX), _mm_mul_ps(normalY, toLightY)), _mm_mul_ps(normalZ, toLightZ)) };
+					const __m128 observedArea{ _mm_mul_ps(_mm_max_ps(normalDotLight, zero), falloff) };
+
+					if (lightingMode == LightingMode::ObservedArea)
+					{
+						r = _mm_add_ps(r, observedArea);
+						g = _mm_add_ps(g, observedArea);
+						b = _mm_add_ps(b, observedArea);
+					}
+
+					if (isDiffuseNeeded)
+					{
+						// Lambert * light color * intensity * observed area, Lambert divides by PI so this is premultiplied into the intensity
+						const __m128 diffuseFactor{ _mm_mul_ps(_mm_set1_ps(light.intensity / PI), observedArea) };
+						r = _mm_add_ps(r, _mm_mul_ps(_mm_load_ps(diffuse.r + laneStart), _mm_mul_ps(diffuseFactor, _mm_set1_ps(light.color.r))));
+						g = _mm_add_ps(g, _mm_mul_ps(_mm_load_ps(diffuse.g + laneStart), _mm_mul_ps(diffuseFactor, _mm_set1_ps(light.color.g))));
+						b = _mm_add_ps(b, _mm_mul_ps(_mm_load_ps(diffuse.b + laneStart), _mm_mul_ps(diffuseFactor, _mm_set1_ps(light.color.b))));
+					}
+
+					if (isSpecularNeeded)
+					{
+						// Reflect the light direction around the normal
+						const __m128 twoNormalDotLight{ _mm_add_ps(normalDotLight, normalDotLight) };
+						const __m128 reflectedX{ _mm_sub_ps(toLightX, _mm_mul_ps(twoNormalDotLight, normalX)) };
+						const __m128 reflectedY{ _mm_sub_ps(toLightY, _mm_mul_ps(twoNormalDotLight, normalY)) };
+						const __m128 reflectedZ{ _mm_sub_ps(toLightZ, _mm_mul_ps(twoNormalDotLight, normalZ)) };
+
+						// Calculate the clamped dot product between the reflected light and the view direction
+						const __m128 reflectedViewDot{ _mm_max_ps(_mm_add_ps(_mm_add_ps(
+							_mm_mul_ps(reflectedX, _mm_load_ps(batch.viewDirectionX + laneStart)),
+							_mm_mul_ps(reflectedY, _mm_load_ps(batch.viewDirectionY + laneStart))),
+							_mm_mul_ps(reflectedZ, _mm_load_ps(batch.viewDirectionZ + laneStart))), zero) };
+
+						// Calculate the phong term, it is faded out with the light but not scaled by its intensity
+						const __m128 phong{ _mm_mul_ps(FastPow(reflectedViewDot, specularExp), falloff) };
+
+						r = _mm_add_ps(r, _mm_mul_ps(_mm_load_ps(specular.r + laneStart), _mm_mul_ps(phong, _mm_set1_ps(light.color.r))));
+						g = _mm_add_ps(g, _mm_mul_ps(_mm_load_ps(specular.g + laneStart), _mm_mul_ps(phong, _mm_set1_ps(light.color.g))));
+						b = _mm_add_ps(b, _mm_mul_ps(_mm_load_ps(specular.b + laneStart), _mm_mul_ps(phong, _mm_set1_ps(light.color.b))));
+					}
+				}
+
+				if (lightingMode == LightingMode::Combined)
+				{
+					r = _mm_add_ps(r, _mm_set1_ps(lighting.ambientColor.r));
+					g = _mm_add_ps(g, _mm_set1_ps(lighting.ambientColor.g));
+					b = _mm_add_ps(b, _mm_set1_ps(lighting.ambientColor.b));
+				}
+
+				// Scale the colors back to [0, 1] if a channel is too bright (MaxToOne)
+				const __m128 maxValue{ _mm_max_ps(_mm_max_ps(r, g), _mm_max_ps(b, one)) };
+				const __m128 scale{ lighting.isScaledToOne ? _mm_div_ps(one, maxValue) : one };
+
+				_mm_store_ps(colors.r + laneStart, _mm_mul_ps(r, scale));
+				_mm_store_ps(colors.g + laneStart, _mm_mul_ps(g, scale));
+				_mm_store_ps(colors.b + laneStart, _mm_mul_ps(b, scale));
+				_mm_store_ps(colors.a + laneStart, one);
+			}
+		}
+	}
+}
@@ -0,0 +1,68 @@
+#pragma once
+#include "DataTypes.h"
+#include "Texture.h"
+
+namespace dae
+{
+	// The amount of pixels that are shaded in one batch
+	constexpr int SHADING_BATCH_WIDTH{ TEXTURE_BATCH_WIDTH };
+
+	// The shading inputs of a batch of pixels stored per attribute (SoA)
+	struct ShadingBatch
+	{
+		int pixelIndices[SHADING_BATCH_WIDTH]{};
+		// The samples that every pixel covers, only used with multisampling
+		uint32_t sampleMasks[SHADING_BATCH_WIDTH]{};
+		alignas(16) float u[SHADING_BATCH_WIDTH]{};
+		alignas(16) float v[SHADING_BATCH_WIDTH]{};
+		// The uv derivatives of the quad of every pixel, used to select the mip level of the textures
+		float ddxU[SHADING_BATCH_WIDTH]{};
+		float ddxV[SHADING_BATCH_WIDTH]{};
+		float ddyU[SHADING_BATCH_WIDTH]{};
+		float ddyV[SHADING_BATCH_WIDTH]{};
+		alignas(16) float normalX[SHADING_BATCH_WIDTH]{};
+		alignas(16) float normalY[SHADING_BATCH_WIDTH]{};
+		alignas(16) float normalZ[SHADING_BATCH_WIDTH]{};
+		alignas(16) float tangentX[SHADING_BATCH_WIDTH]{};
+		alignas(16) float tangentY[SHADING_BATCH_WIDTH]{};
+		alignas(16) float tangentZ[SHADING_BATCH_WIDTH]{};
+		alignas(16) float viewDirectionX[SHADING_BATCH_WIDTH]{};
+		alignas(16) float viewDirectionY[SHADING_BATCH_WIDTH]{};
+		alignas(16) float viewDirectionZ[SHADING_BATCH_WIDTH]{};
+		alignas(16) float worldPositionX[SHADING_BATCH_WIDTH]{};
+		alignas(16) float worldPositionY[SHADING_BATCH_WIDTH]{};
+		alignas(16) float worldPositionZ[SHADING_BATCH_WIDTH]{};
+		// All the pixels in a batch are in the same light tile
+		int lightTileIdx{};
+		int count{};
+	};
+
+	// The lights that are used by the batched lighting kernels
+	struct LightingParameters
+	{
+		const Light* pLights{};
+		const uint32_t* pLightIndices{};
+		int nrLights{};
+		float specularShininess{};
+		ColorRGB ambientColor{};
+		// The light that is blocked by the shadow map (index in pLights) and how much of it reaches every pixel of the batch
+		int shadowLightIdx{ -1 };
+		const float* pShadowVisibility{};
+		// The colors are written to the HDR buffer unclamped, otherwise they are scaled back to [0, 1]
+		bool isScaledToOne{ true };
+	};
+
+	// SSE versions of the functions in LightingUtils, every lane gives the same result as the scalar functions within the error of FastPow
+	namespace LightingKernels
+	{
+		// Calculates base^exponent for 4 lanes using exp2(exponent * log2(base)), base should be in [0, 1] and exponent positive
+		// The relative error is below 2e-4 for the exponents used by Phong (up to the shininess of 25), far below one step of an 8 bit color
+		void FastPow(const float* pBase, const float* pExponent, float* pResult);
+
+		// Shades a batch of pixels with every light in the light indices using the lighting mode, the normals in the batch should already be normalized
+		// The textures that are not needed by the lighting mode are not read
+		// The resulting colors are scaled back to [0, 1] the same way as ColorRGB::MaxToOne, unless isScaledToOne is false
+		void Shade(const ShadingBatch& batch, const ColorBatch& diffuse, const ColorBatch& specular, const ColorBatch& glossiness,
+			LightingMode lightingMode, const LightingParameters& lighting, ColorBatch& colors);
+	}
+}
@@ -21,6 +21,10 @@ namespace dae
 		// Save the rasterizerstate variable of the effect as a member variable
 		m_pRasterizerStateVariable = m_pEffect->GetVariableByName("gRasterizerState")->AsRasterizer();
 		if (!m_pRasterizerStateVariable->IsValid()) std::wcout << L"m_pRasterizerStateVariable not valid\n";
+
+		// Save the depthstencilstate variable of the effect as a member variable
+		m_pDepthStencilStateVariable = m_pEffect->GetVariableByName("gDepthStencilState")->AsDepthStencil();
+		if (!m_pDepthStencilStateVariable->IsValid()) std::wcout << L"m_pDepthStencilStateVariable not valid\n";
 	}
 
 	Material::~Material()
@@ -51,6 +55,16 @@ namespace dae
 		return m_pTechnique;
 	}
 
+	ID3DX11EffectTechnique* Material::GetShadowTechnique() const
+	{
+		return m_pShadowTechnique;
+	}
+
+	ID3DX11EffectTechnique* Material::GetReducedResolutionTechnique() const
+	{
+		return m_pReducedResolutionTechnique;
+	}
+
 	ID3D11InputLayout* Material::LoadInputLayout(ID3D11Device* pDevice) const
 	{
 		// Create vertex layout
@@ -108,6 +122,13 @@ namespace dae
 		if (FAILED(hr)) std::wcout << L"Failed to change rasterizer state";
 	}
 
+	void Material::SetDepthStencilState(ID3D11DepthStencilState* pDepthStencilState) const
+	{
+		// Without a state the effect goes back to the state it declares
+		const HRESULT hr{ pDepthStencilState ? m_pDepthStencilStateVariable->SetDepthStencilState(0, pDepthStencilState) : m_pDepthStencilStateVariable->UndoSetDepthStencilState(0) };
+		if (FAILED(hr)) std::wcout << L"Failed to change depth stencil state";
+	}
+
 	ID3DX11Effect* Material::LoadEffect(ID3D11Device* pDevice, const std::wstring& assetFile)
 	{
 		HRESULT result;
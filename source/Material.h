@@ -18,20 +18,32 @@ namespace dae
 		         
 		virtual void SetMatrix(MatrixType type, const Matrix& matrix);
 		virtual void SetTexture(Texture* pTexture) = 0;
+		// Materials that are lit override this to upload the lights to their effect
+		virtual void SetLights(const std::vector<Light>& /*lights*/) {}
+		// Materials that receive shadows override this to upload the shadow map to their effect
+		virtual void SetShadow(const ShadowInfo& /*shadow*/, ID3D11ShaderResourceView* /*pShadowMap*/) {}
 		ID3DX11Effect* GetEffect() const;
 		ID3DX11EffectTechnique* GetTechnique() const;
+		// The depth only technique that renders the shadow map, nullptr when the material doesn't cast shadows
+		ID3DX11EffectTechnique* GetShadowTechnique() const;
+		// The technique that renders into the reduced resolution transparency buffer, nullptr when the material isn't transparent
+		ID3DX11EffectTechnique* GetReducedResolutionTechnique() const;
 
 		ID3D11InputLayout* LoadInputLayout(ID3D11Device* pDevice) const;
 		void SetSampleState(ID3D11SamplerState* pSampleState) const;
 		void SetRasterizerState(ID3D11RasterizerState* pRasterizerState) const;
+		void SetDepthStencilState(ID3D11DepthStencilState* pDepthStencilState) const;
+
+		static ID3DX11Effect* LoadEffect(ID3D11Device* pDevice, const std::wstring& assetFile);
 	protected:
 		CullMode m_CullMode{};
 		ID3DX11Effect* m_pEffect{};
 		ID3DX11EffectTechnique* m_pTechnique{};
+		ID3DX11EffectTechnique* m_pShadowTechnique{};
+		ID3DX11EffectTechnique* m_pReducedResolutionTechnique{};
 		ID3DX11EffectMatrixVariable* m_pMatWorldViewProjVariable{};
 		ID3DX11EffectSamplerVariable* m_pSamplerStateVariable{};
 		ID3DX11EffectRasterizerVariable* m_pRasterizerStateVariable{};
-		
-		static ID3DX11Effect* LoadEffect(ID3D11Device* pDevice, const std::wstring& assetFile);
+		ID3DX11EffectDepthStencilVariable* m_pDepthStencilStateVariable{};
 	};
 }
@@ -23,6 +23,38 @@ namespace dae
 		m_pGlossinessMapVariable = m_pEffect->GetVariableByName("gGlossinessMap")->AsShaderResource();
 		if (!m_pGlossinessMapVariable->IsValid()) std::wcout << L"m_pGlossinessMapVariable not valid\n";
 
+		// Save the two channel normal map variable of the effect as a member variable
+		m_pIsNormalMapTwoChannelVariable = m_pEffect->GetVariableByName("gIsNormalMapTwoChannel")->AsScalar();
+		if (!m_pIsNormalMapTwoChannelVariable->IsValid()) std::wcout << L"m_pIsNormalMapTwoChannelVariable not valid\n";
+
+		// Save the object space normal map variable of the effect as a member variable
+		m_pIsNormalMapObjectSpaceVariable = m_pEffect->GetVariableByName("gIsNormalMapObjectSpace")->AsScalar();
+		if (!m_pIsNormalMapObjectSpaceVariable->IsValid()) std::wcout << L"m_pIsNormalMapObjectSpaceVariable not valid\n";
+
+		// Save the light variables of the effect as member variables
+		m_pNrLightsVariable = m_pEffect->GetVariableByName("gNrLights")->AsScalar();
+		if (!m_pNrLightsVariable->IsValid()) std::wcout << L"m_pNrLightsVariable not valid\n";
+		m_pLightPositionsVariable = m_pEffect->GetVariableByName("gLightPositions")->AsVector();
+		if (!m_pLightPositionsVariable->IsValid()) std::wcout << L"m_pLightPositionsVariable not valid\n";
+		m_pLightDirectionsVariable = m_pEffect->GetVariableByName("gLightDirections")->AsVector();
+		if (!m_pLightDirectionsVariable->IsValid()) std::wcout << L"m_pLightDirectionsVariable not valid\n";
+		m_pLightColorsVariable = m_pEffect->GetVariableByName("gLightColors")->AsVector();
+		if (!m_pLightColorsVariable->IsValid()) std::wcout << L"m_pLightColorsVariable not valid\n";
+		m_pLightConesVariable = m_pEffect->GetVariableByName("gLightCones")->AsVector();
+		if (!m_pLightConesVariable->IsValid()) std::wcout << L"m_pLightConesVariable not valid\n";
+
+		// Save the shadow technique and variables of the effect as member variables
+		m_pShadowTechnique = m_pEffect->GetTechniqueByName("ShadowTechnique");
+		if (!m_pShadowTechnique->IsValid()) std::wcout << L"m_pShadowTechnique not valid\n";
+		m_pShadowLightIdxVariable = m_pEffect->GetVariableByName("gShadowLightIdx")->AsScalar();
+		if (!m_pShadowLightIdxVariable->IsValid()) std::wcout << L"m_pShadowLightIdxVariable not valid\n";
+		m_pShadowNormalOffsetVariable = m_pEffect->GetVariableByName("gShadowNormalOffset")->AsScalar();
+		if (!m_pShadowNormalOffsetVariable->IsValid()) std::wcout << L"m_pShadowNormalOffsetVariable not valid\n";
+		m_pMatLightViewProjVariable = m_pEffect->GetVariableByName("gLightViewProj")->AsMatrix();
+		if (!m_pMatLightViewProjVariable->IsValid()) std::wcout << L"m_pMatLightViewProjVariable not valid\n";
+		m_pShadowMapVariable = m_pEffect->GetVariableByName("gShadowMap")->AsShaderResource();
+		if (!m_pShadowMapVariable->IsValid()) std::wcout << L"m_pShadowMapVariable not valid\n";
+
 		// Save the worldmatrix variable of the effect as a member variable
 		m_pMatWorldVariable = m_pEffect->GetVariableByName("gWorld")->AsMatrix();
 		if (!m_pMatWorldVariable->IsValid()) std::wcout << L"m_pMatWorldVariable not valid\n";
@@ -70,6 +102,12 @@ namespace dae
 			break;
 		case dae::Texture::TextureType::Normal:
 			pCurMapVariable = m_pNormalMapVariable;
+			m_pIsNormalMapTwoChannelVariable->SetBool(pTexture->IsTwoChannel());
+			m_pIsNormalMapObjectSpaceVariable->SetBool(false);
+			break;
+		case dae::Texture::TextureType::ObjectSpaceNormal:
+			pCurMapVariable = m_pNormalMapVariable;
+			m_pIsNormalMapObjectSpaceVariable->SetBool(true);
 			break;
 		case dae::Texture::TextureType::Specular:
 			pCurMapVariable = m_pSpecularMapVariable;
@@ -83,4 +121,46 @@ namespace dae
 		if (pCurMapVariable)
 			pCurMapVariable->SetResource(pTexture->GetSRV());
 	}
+
+	void MaterialShaded::SetLights(const std::vector<Light>& lights)
+	{
+		const int nrLights{ std::min(static_cast<int>(lights.size()), m_MaxLights) };
+		if (nrLights < static_cast<int>(lights.size())) std::cout << "Only the first " << m_MaxLights << " lights are used by the hardware rasterizer\n";
+
+		// Pack the lights in float4 arrays
+		std::vector<Vector4> positions(nrLights);
+		std::vector<Vector4> directions(nrLights);
+		std::vector<Vector4> colors(nrLights);
+		std::vector<Vector4> cones(nrLights);
+		for (int i{}; i < nrLights; ++i)
+		{
+			const Light& light{ lights[i] };
+
+			// xyz: position, w: type
+			positions[i] = { light.position, static_cast<float>(light.type) };
+			// xyz: direction, w: range
+			directions[i] = { light.direction, light.range };
+			// rgb: color, a: intensity
+			colors[i] = { light.color.r, light.color.g, light.color.b, light.intensity };
+			// x: inner cone cosine, y: outer cone cosine
+			cones[i] = { light.innerConeCos, light.outerConeCos, 0.0f, 0.0f };
+		}
+
+		// Upload the lights to the effect
+		m_pNrLightsVariable->SetInt(nrLights);
+		if (nrLights == 0) return;
+		m_pLightPositionsVariable->SetFloatVectorArray(reinterpret_cast<const float*>(positions.data()), 0, nrLights);
+		m_pLightDirectionsVariable->SetFloatVectorArray(reinterpret_cast<const float*>(directions.data()), 0, nrLights);
+		m_pLightColorsVariable->SetFloatVectorArray(reinterpret_cast<const float*>(colors.data()), 0, nrLights);
+		m_pLightConesVariable->SetFloatVectorArray(reinterpret_cast<const float*>(cones.data()), 0, nrLights);
+	}
+
+	void MaterialShaded::SetShadow(const ShadowInfo& shadow, ID3D11ShaderResourceView* pShadowMap)
+	{
+		// Without a shadow map no light is shadowed
+		m_pShadowLightIdxVariable->SetInt(pShadowMap ? shadow.lightIdx : -1);
+		m_pShadowNormalOffsetVariable->SetFloat(shadow.normalOffset);
+		m_pMatLightViewProjVariable->SetMatrix(reinterpret_cast<const float*>(&shadow.lightViewProjectionMatrix));
+		m_pShadowMapVariable->SetResource(pShadowMap);
+	}
 }
\ No newline at end of file
@@ -18,11 +18,29 @@ namespace dae
 
 		virtual void SetMatrix(MatrixType type, const Matrix& matrix) override;
 		virtual void SetTexture(Texture* pTexture) override;
+		virtual void SetLights(const std::vector<Light>& lights) override;
+		virtual void SetShadow(const ShadowInfo& shadow, ID3D11ShaderResourceView* pShadowMap) override;
 	private:
+		// The maximum amount of lights in the effect (MAX_LIGHTS), the effect loops over all the lights without culling
+		static constexpr int m_MaxLights{ 32 };
+
 		ID3DX11EffectShaderResourceVariable* m_pDiffuseMapVariable{};
 		ID3DX11EffectShaderResourceVariable* m_pNormalMapVariable{};
 		ID3DX11EffectShaderResourceVariable* m_pSpecularMapVariable{};
 		ID3DX11EffectShaderResourceVariable* m_pGlossinessMapVariable{};
+		ID3DX11EffectScalarVariable* m_pIsNormalMapTwoChannelVariable{};
+		ID3DX11EffectScalarVariable* m_pIsNormalMapObjectSpaceVariable{};
+
+		ID3DX11EffectScalarVariable* m_pNrLightsVariable{};
+		ID3DX11EffectVectorVariable* m_pLightPositionsVariable{};
+		ID3DX11EffectVectorVariable* m_pLightDirectionsVariable{};
+		ID3DX11EffectVectorVariable* m_pLightColorsVariable{};
+		ID3DX11EffectVectorVariable* m_pLightConesVariable{};
+
+		ID3DX11EffectScalarVariable* m_pShadowLightIdxVariable{};
+		ID3DX11EffectScalarVariable* m_pShadowNormalOffsetVariable{};
+		ID3DX11EffectMatrixVariable* m_pMatLightViewProjVariable{};
+		ID3DX11EffectShaderResourceVariable* m_pShadowMapVariable{};
 
 		ID3DX11EffectMatrixVariable* m_pMatWorldVariable{};
 		ID3DX11EffectMatrixVariable* m_pMatInverseViewVariable{};
@@ -11,6 +11,10 @@ namespace dae
 		m_pDiffuseMapVariable = m_pEffect->GetVariableByName("gDiffuseMap")->AsShaderResource();
 		if (!m_pDiffuseMapVariable->IsValid()) std::wcout << L"m_pDiffuseMapVariable not valid\n";
 
+		// Save the technique that renders into the reduced resolution transparency buffer
+		m_pReducedResolutionTechnique = m_pEffect->GetTechniqueByName("ReducedResolutionTechnique");
+		if (!m_pReducedResolutionTechnique->IsValid()) std::wcout << L"m_pReducedResolutionTechnique not valid\n";
+
 		// Set the cullmode on front face culling
 		m_CullMode = CullMode::Front;
 	}
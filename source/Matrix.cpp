@@ -146,8 +146,11 @@ namespace dae {
 
 	Matrix Matrix::CreateLookAtLH(const Vector3& origin, const Vector3& forward, const Vector3& up)
 	{
-		assert(false && "Not Implemented");
-		return {};
+		const Vector3 zAxis{ forward.Normalized() };
+		const Vector3 xAxis{ Vector3::Cross(up, zAxis).Normalized() };
+		const Vector3 yAxis{ Vector3::Cross(zAxis, xAxis) };
+
+		return Inverse({ xAxis, yAxis, zAxis, origin });
 	}
 
 	Matrix Matrix::CreatePerspectiveFovLH(float fov, float aspect, float zn, float zf)
@@ -163,6 +166,43 @@ namespace dae {
 		};
 	}
 
+	Matrix Matrix::CreateReversedPerspectiveFovLH(float fov, float aspect, float zn, float zf)
+	{
+		const float frustumSize{ zf - zn };
+
+		return
+		{
+			{ 1.0f / (aspect * fov), 0.0f, 0.0f, 0.0f },
+			{ 0.0f, 1.0f / fov, 0.0f, 0.0f },
+			{ 0.0f, 0.0f, -zn / frustumSize, 1.0f },
+			{ 0.0f, 0.0f, (zf * zn) / frustumSize, 0.0f }
+		};
+	}
+
+	Matrix Matrix::CreateReversedInfinitePerspectiveFovLH(float fov, float aspect, float zn)
+	{
+		return
+		{
+			{ 1.0f / (aspect * fov), 0.0f, 0.0f, 0.0f },
+			{ 0.0f, 1.0f / fov, 0.0f, 0.0f },
+			{ 0.0f, 0.0f, 0.0f, 1.0f },
+			{ 0.0f, 0.0f, zn, 0.0f }
+		};
+	}
+
+	Matrix Matrix::CreateOrthographicLH(float width, float height, float zn, float zf)
+	{
+		const float frustumSize{ zf - zn };
+
+		return
+		{
+			{ 2.0f / width, 0.0f, 0.0f, 0.0f },
+			{ 0.0f, 2.0f / height, 0.0f, 0.0f },
+			{ 0.0f, 0.0f, 1.0f / frustumSize, 0.0f },
+			{ 0.0f, 0.0f, -zn / frustumSize, 1.0f }
+		};
+	}
+
 	Vector3 Matrix::GetAxisX() const
 	{
 		return data[0];
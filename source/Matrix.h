@@ -57,6 +57,11 @@ namespace dae {
 
 		static Matrix CreateLookAtLH(const Vector3& origin, const Vector3& forward, const Vector3& up);
 		static Matrix CreatePerspectiveFovLH(float fovy, float aspect, float zn, float zf);
+		// Maps the near plane to depth 1 and the far plane to depth 0, the float precision near 0 then spreads evenly over the distance
+		static Matrix CreateReversedPerspectiveFovLH(float fovy, float aspect, float zn, float zf);
+		// Reversed depth without a far plane, depth = zn / z goes to 0 at infinity
+		static Matrix CreateReversedInfinitePerspectiveFovLH(float fovy, float aspect, float zn);
+		static Matrix CreateOrthographicLH(float width, float height, float zn, float zf);
 
 		Vector4& operator[](int index);
 		Vector4 operator[](int index) const;
@@ -3,12 +3,18 @@
 #include "Utils.h"
 #include "Material.h"
 #include "Texture.h"
+#include "TextureRegistry.h"
 #include "MaterialTransparent.h"
+#include "LightingKernels.h"
+#include "AlphaCoverage.h"
 #include <ppl.h> // Parallel Stuff
 #include <future>
+#include <atomic>
+#include <tuple>
 
 #define IS_CLIPPING_ENABLED
 #define PARALLEL
+#define BATCHED_SHADING
 
 namespace dae
 {
@@ -16,6 +22,10 @@ namespace dae
 		: m_IsTransparent{ typeid(*pMaterial) == typeid(MaterialTransparent) }
 		, m_pMaterial{ pMaterial }
 	{
+		// Give every mesh a unique id, 0 is used for pixels without a triangle
+		static uint32_t nrMeshes{};
+		m_Id = ++nrMeshes;
+
 		const bool parseResult{ Utils::ParseOBJ(filePath, m_Vertices, m_Indices) };
 		if (!parseResult)
 		{
@@ -26,6 +36,20 @@ namespace dae
 		// Set the cullmode to none when using a transparent material
 		if (m_IsTransparent) m_CullMode = CullMode::None;
 
+		// Calculate the bounding sphere around the box that contains all the vertices
+		Vector3 minPosition{ FLT_MAX, FLT_MAX, FLT_MAX };
+		Vector3 maxPosition{ -FLT_MAX, -FLT_MAX, -FLT_MAX };
+		for (const Vertex& vertex : m_Vertices)
+		{
+			minPosition = { std::min(minPosition.x, vertex.position.x), std::min(minPosition.y, vertex.position.y), std::min(minPosition.z, vertex.position.z) };
+			maxPosition = { std::max(maxPosition.x, vertex.position.x), std::max(maxPosition.y, vertex.position.y), std::max(maxPosition.z, vertex.position.z) };
+		}
+		m_BoundingCenter = (minPosition + maxPosition) / 2.0f;
+		for (const Vertex& vertex : m_Vertices)
+		{
+			m_BoundingRadius = std::max(m_BoundingRadius, (vertex.position - m_BoundingCenter).Magnitude());
+		}
+
 		// Create Input Layout
 		m_pInputLayout = pMaterial->LoadInputLayout(pDevice);
 
@@ -64,6 +88,7 @@ namespace dae
 
 		if (m_pInputLayout) m_pInputLayout->Release();
 
+		delete m_pObjectSpaceNormalMap;
 		delete m_pMaterial;
 	}
 
@@ -84,6 +109,32 @@ namespace dae
 	{
 		if (!m_IsVisible) return;
 
+		DrawIndexed(pDeviceContext, m_pMaterial->GetTechnique());
+	}
+
+	void Mesh::HardwareRenderShadowMap(ID3D11DeviceContext* pDeviceContext) const
+	{
+		// Only visible meshes with a material that supports shadows cast shadows
+		if (!m_IsVisible || !m_pMaterial->GetShadowTechnique()) return;
+
+		DrawIndexed(pDeviceContext, m_pMaterial->GetShadowTechnique());
+	}
+
+	void Mesh::HardwareRenderReducedResolution(ID3D11DeviceContext* pDeviceContext) const
+	{
+		// Only transparent meshes are rendered at a reduced resolution
+		if (!m_IsVisible || !m_pMaterial->GetReducedResolutionTechnique()) return;
+
+		DrawIndexed(pDeviceContext, m_pMaterial->GetReducedResolutionTechnique());
+	}
+
+	void Mesh::SetShadow(const ShadowInfo& shadow, ID3D11ShaderResourceView* pShadowMap) const
+	{
+		m_pMaterial->SetShadow(shadow, pShadowMap);
+	}
+
+	void Mesh::DrawIndexed(ID3D11DeviceContext* pDeviceContext, ID3DX11EffectTechnique* pTechnique) const
+	{
 		// Set primitive topology
 		pDeviceContext->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
 
@@ -100,10 +151,10 @@ namespace dae
 
 		// Draw
 		D3DX11_TECHNIQUE_DESC techniqueDesc{};
-		m_pMaterial->GetTechnique()->GetDesc(&techniqueDesc);
+		pTechnique->GetDesc(&techniqueDesc);
 		for (UINT p{}; p < techniqueDesc.Passes; ++p)
 		{
-			m_pMaterial->GetTechnique()->GetPassByIndex(p)->Apply(0, pDeviceContext);
+			pTechnique->GetPassByIndex(p)->Apply(0, pDeviceContext);
 			pDeviceContext->DrawIndexed(static_cast<uint32_t>(m_Indices.size()), 0, 0);
 		}
 	}
@@ -118,7 +169,17 @@ namespace dae
 		std::vector<Vertex_Out> verticesOut{};
 
 		// Convert all the vertices in the mesh from world space to NDC space
-		GeometryUtils::VertexTransformationFunction(m_WorldMatrix, m_Vertices, verticesOut, pCamera);
+		// With a valid reprojection cache, also calculate where the vertices were in the previous frame
+		if (renderInfo.pReprojectionCache && renderInfo.pReprojectionCache->isValid)
+		{
+			const Matrix previousWorldViewProjectionMatrix{ m_PreviousWorldMatrix * renderInfo.pReprojectionCache->viewProjectionMatrix };
+			GeometryUtils::VertexTransformationFunction(m_WorldMatrix, m_Vertices, verticesOut, pCamera, &previousWorldViewProjectionMatrix);
+		}
+		else
+		{
+			GeometryUtils::VertexTransformationFunction(m_WorldMatrix, m_Vertices, verticesOut, pCamera);
+		}
+		m_PreviousWorldMatrix = m_WorldMatrix;
 
 		// Create a vector for all the vertices in raster space
 		std::vector<Vector2> verticesRasterSpace{};
@@ -137,6 +198,8 @@ namespace dae
 #ifdef IS_CLIPPING_ENABLED
 		m_UseIndices.clear();
 		m_UseIndices.reserve(m_Indices.size());
+		m_UseTriangleIds.clear();
+		m_UseTriangleIds.reserve(m_Indices.size() / 3);
 
 		// Calculate the points of the screen
 		const std::vector<Vector2> rasterVertices
@@ -172,8 +235,8 @@ namespace dae
 				RenderTriangle(verticesRasterSpace, verticesOut, curStartVertexIdx, false, renderInfo);
 			}
 #else
-			// For each triangle (multithreaded, except for transparent meshes)
-			if (m_IsTransparent)
+			// For each triangle (multithreaded, except for transparent meshes that are blended in triangle order)
+			if (m_IsTransparent && !renderInfo.pTransparencyAccumulation)
 			{
 				for (uint32_t curStartVertexIdx{}; curStartVertexIdx < nrIndices; curStartVertexIdx += 3)
 				{
@@ -204,6 +267,97 @@ namespace dae
 		}
 	}
 
+	bool Mesh::IsTransparent() const
+	{
+		return m_IsTransparent;
+	}
+
+	void Mesh::RenderShadowMap(const Matrix& lightViewProjectionMatrix, float* pShadowMap) const
+	{
+		// Transparent meshes don't cast shadows
+		if (!m_IsVisible || m_IsTransparent) return;
+
+		const Matrix worldLightViewProjectionMatrix{ m_WorldMatrix * lightViewProjectionMatrix };
+		constexpr float shadowMapSize{ static_cast<float>(SHADOW_MAP_SIZE) };
+
+		// Only the positions are transformed to shadow map space (x and y in texels, z is the depth)
+		std::vector<Vector3> shadowMapVertices{};
+		shadowMapVertices.reserve(m_Vertices.size());
+		for (const Vertex& vertex : m_Vertices)
+		{
+			const Vector3 lightPosition{ worldLightViewProjectionMatrix.TransformPoint(vertex.position) };
+			shadowMapVertices.emplace_back((lightPosition.x + 1.0f) / 2.0f * shadowMapSize, (1.0f - lightPosition.y) / 2.0f * shadowMapSize, lightPosition.z);
+		}
+
+		// Every thread rasterizes all the triangles into its own band of rows, so no two threads write the same texel
+		constexpr int nrRowsPerBand{ 32 };
+		constexpr int nrBands{ (SHADOW_MAP_SIZE + nrRowsPerBand - 1) / nrRowsPerBand };
+
+		concurrency::parallel_for(0, nrBands, [&](int bandIdx)
+			{
+				const int bandStartY{ bandIdx * nrRowsPerBand };
+				const int bandEndY{ std::min(bandStartY + nrRowsPerBand, SHADOW_MAP_SIZE) };
+
+				for (size_t indexIdx{}; indexIdx + 2 < m_Indices.size(); indexIdx += 3)
+				{
+					const Vector3& v0{ shadowMapVertices[m_Indices[indexIdx]] };
+					const Vector3& v1{ shadowMapVertices[m_Indices[indexIdx + 1]] };
+					const Vector3& v2{ shadowMapVertices[m_Indices[indexIdx + 2]] };
+
+					// Calculate the texels of this band that have their center inside the bounding box of the triangle
+					const int startY{ std::max(static_cast<int>(std::ceil(std::min({ v0.y, v1.y, v2.y }) - 0.5f)), bandStartY) };
+					const int endY{ std::min(static_cast<int>(std::ceil(std::max({ v0.y, v1.y, v2.y }) - 0.5f)), bandEndY) };
+					if (startY >= endY) continue;
+					const int startX{ std::max(static_cast<int>(std::ceil(std::min({ v0.x, v1.x, v2.x }) - 0.5f)), 0) };
+					const int endX{ std::min(static_cast<int>(std::ceil(std::max({ v0.x, v1.x, v2.x }) - 0.5f)), SHADOW_MAP_SIZE) };
+					if (startX >= endX) continue;
+
+					// Both sides of the triangles cast shadows, dividing by the signed area makes the weights positive inside the triangle for both windings
+					const float area{ (v1.x - v0.x) * (v2.y - v0.y) - (v1.y - v0.y) * (v2.x - v0.x) };
+					if (abs(area) < FLT_EPSILON) continue;
+					const float inverseArea{ 1.0f / area };
+
+					// The barycentric weights and the depth change linearly, so they are only calculated at the start of each row and then stepped
+					const float weight0StepX{ (v1.y - v2.y) * inverseArea };
+					const float weight1StepX{ (v2.y - v0.y) * inverseArea };
+					const float weight2StepX{ (v0.y - v1.y) * inverseArea };
+					const float depthStepX{ weight0StepX * v0.z + weight1StepX * v1.z + weight2StepX * v2.z };
+
+					for (int y{ startY }; y < endY; ++y)
+					{
+						// Calculate the weights at the center of the first texel of the row
+						const float px{ startX + 0.5f };
+						const float py{ y + 0.5f };
+						float weight0{ ((v2.x - v1.x) * (py - v1.y) - (v2.y - v1.y) * (px - v1.x)) * inverseArea };
+						float weight1{ ((v0.x - v2.x) * (py - v2.y) - (v0.y - v2.y) * (px - v2.x)) * inverseArea };
+						float weight2{ 1.0f - weight0 - weight1 };
+						float depth{ weight0 * v0.z + weight1 * v1.z + weight2 * v2.z };
+
+						float* pRow{ pShadowMap + y * SHADOW_MAP_SIZE };
+						for (int x{ startX }; x < endX; ++x)
+						{
+							// Keep the closest depth of the texels inside the triangle
+							if (weight0 >= 0.0f && weight1 >= 0.0f && weight2 >= 0.0f && depth < pRow[x]) pRow[x] = depth;
+
+							weight0 += weight0StepX;
+							weight1 += weight1StepX;
+							weight2 += weight2StepX;
+							depth += depthStepX;
+						}
+					}
+				}
+			});
+	}
+
+	void Mesh::MakeTexturesResident(TextureRegistry* pTextureRegistry) const
+	{
+		pTextureRegistry->MakeResident(m_pDiffuseMap);
+		// The tangent space normal map is only sampled when it isn't baked to object space
+		if (!m_pObjectSpaceNormalMap) pTextureRegistry->MakeResident(m_pNormalMap);
+		pTextureRegistry->MakeResident(m_pSpecularMap);
+		pTextureRegistry->MakeResident(m_pGlossinessMap);
+	}
+
 	// Source: https://en.wikipedia.org/wiki/Sutherland%E2%80%93Hodgman_algorithm
 	void Mesh::ClipTriangle(std::vector<Vertex_Out>& verticesOut, std::vector<Vector2>& verticesRasterSpace, const std::vector<Vector2>& rasterVertices, const SoftwareRenderInfo& renderInfo, size_t i)
 	{
@@ -233,6 +387,7 @@ namespace dae
 				m_UseIndices.push_back(vertexIdx0);
 				m_UseIndices.push_back(vertexIdx1);
 				m_UseIndices.push_back(vertexIdx2);
+				m_UseTriangleIds.push_back(static_cast<uint32_t>(i / 3));
 			}
 			return;
 		}
@@ -307,10 +462,14 @@ namespace dae
 							+ inputVertexList[prevIndex].tangent * prevDistance / totalDistance).Normalized();
 						newVertex.viewDirection = (inputVertexList[curIndex].viewDirection * curDistance / totalDistance
 							+ inputVertexList[prevIndex].viewDirection * prevDistance / totalDistance).Normalized();
+						newVertex.worldPosition = inputVertexList[curIndex].worldPosition * curDistance / totalDistance
+							+ inputVertexList[prevIndex].worldPosition * prevDistance / totalDistance;
 						newVertex.position.z = inputVertexList[curIndex].position.z * curDistance / totalDistance
 							+ inputVertexList[prevIndex].position.z * prevDistance / totalDistance;
 						newVertex.position.w = inputVertexList[curIndex].position.w * curDistance / totalDistance
 							+ inputVertexList[prevIndex].position.w * prevDistance / totalDistance;
+						newVertex.previousPosition = inputVertexList[curIndex].previousPosition * (curDistance / totalDistance)
+							+ inputVertexList[prevIndex].previousPosition * (prevDistance / totalDistance);
 						outputVertexList.push_back(newVertex);
 					}
 
@@ -338,10 +497,14 @@ namespace dae
 						+ inputVertexList[prevIndex].tangent * prevDistance / totalDistance).Normalized();
 					newVertex.viewDirection = (inputVertexList[curIndex].viewDirection * curDistance / totalDistance
 						+ inputVertexList[prevIndex].viewDirection * prevDistance / totalDistance).Normalized();
+					newVertex.worldPosition = inputVertexList[curIndex].worldPosition * curDistance / totalDistance
+						+ inputVertexList[prevIndex].worldPosition * prevDistance / totalDistance;
 					newVertex.position.z = inputVertexList[curIndex].position.z * curDistance / totalDistance
 						+ inputVertexList[prevIndex].position.z * prevDistance / totalDistance;
 					newVertex.position.w = inputVertexList[curIndex].position.w * curDistance / totalDistance
 						+ inputVertexList[prevIndex].position.w * prevDistance / totalDistance;
+					newVertex.previousPosition = inputVertexList[curIndex].previousPosition * (curDistance / totalDistance)
+						+ inputVertexList[prevIndex].previousPosition * (prevDistance / totalDistance);
 					outputVertexList.push_back(newVertex);
 				}
 			}
@@ -398,6 +561,7 @@ namespace dae
 			m_UseIndices.push_back(static_cast<uint32_t>(indices[0]));
 			m_UseIndices.push_back(static_cast<uint32_t>(indices[1]));
 			m_UseIndices.push_back(static_cast<uint32_t>(indices[2]));
+			m_UseTriangleIds.push_back(static_cast<uint32_t>(i / 3));
 
 			// Make sure the wind order of the indices is correct
 			int indicesSizeInt{ static_cast<int>(m_UseIndices.size()) };
@@ -456,6 +620,7 @@ namespace dae
 				m_UseIndices.push_back(static_cast<uint32_t>(indices[currentV0Idx]));
 				m_UseIndices.push_back(static_cast<uint32_t>(indices[currentV1Idx]));
 				m_UseIndices.push_back(static_cast<uint32_t>(indices[currentCheckIdx]));
+				m_UseTriangleIds.push_back(static_cast<uint32_t>(i / 3));
 
 				// Make sure the wind order of the indices is correct
 				int indicesSizeInt{ static_cast<int>(m_UseIndices.size()) };
@@ -479,13 +644,22 @@ namespace dae
 		const size_t vertexIdx0{ m_UseIndices[curVertexIdx] };
 		const size_t vertexIdx1{ m_UseIndices[curVertexIdx + 1 * !swapVertices + 2 * swapVertices] };
 		const size_t vertexIdx2{ m_UseIndices[curVertexIdx + 2 * !swapVertices + 1 * swapVertices] };
+
+		// Calculate the index of the original triangle
+		const uint32_t triangleIdx{ m_PrimitiveTopology == PrimitiveTopology::TriangleList ? m_UseTriangleIds[curVertexIdx / 3] : static_cast<uint32_t>(curVertexIdx) };
 #else
 		// Calcalate the indexes of the vertices on this triangle
 		const size_t vertexIdx0{ m_Indices[curVertexIdx] };
 		const size_t vertexIdx1{ m_Indices[curVertexIdx + 1 * !swapVertices + 2 * swapVertices] };
 		const size_t vertexIdx2{ m_Indices[curVertexIdx + 2 * !swapVertices + 1 * swapVertices] };
+
+		// Calculate the index of the triangle
+		const uint32_t triangleIdx{ static_cast<uint32_t>(m_PrimitiveTopology == PrimitiveTopology::TriangleList ? curVertexIdx / 3 : curVertexIdx) };
 #endif
 
+		// The id of this triangle in the reprojection cache, the upper 8 bits hold the mesh
+		const uint32_t triangleId{ (m_Id << 24) | (triangleIdx + 1) };
+
 		// If a triangle has the same vertex twice
 		// Or if a one of the vertices is outside the frustum
 		// Continue
@@ -524,143 +698,752 @@ namespace dae
 		const int endX{ std::clamp(static_cast<int>(maxBoundingBox.x + margin), 0, renderInfo.width) };
 		const int endY{ std::clamp(static_cast<int>(maxBoundingBox.y + margin), 0, renderInfo.height) };
 
-		// For each pixel
-		for (int py{ startY }; py < endY; ++py)
+		// The first triangle that touches a tile clears it
+		renderInfo.ClearTiles(startX, startY, endX, endY);
+
+		// If only the bounding box should be rendered, do no triangle checks, just display a white color
+		if (renderInfo.isShowingBoundingBoxes)
 		{
-			for (int px{ startX }; px < endX; ++px)
+			for (int py{ startY }; py < endY; ++py)
 			{
-				// Calculate the pixel index and create a Vector2 of the current pixel
-				const int pixelIdx{ px + py * renderInfo.width };
+				for (int px{ startX }; px < endX; ++px)
+				{
+					ColorUtils::WriteColor(renderInfo, px + py * renderInfo.width, colors::White);
+				}
+			}
+			return;
+		}
+
+		// Transparent meshes are not part of the depth buffer visualization
+		if (renderInfo.isShowingDepthBuffer && m_IsTransparent) return;
+
+		const Vertex_Out& v0Out{ verticesOut[vertexIdx0] };
+		const Vertex_Out& v1Out{ verticesOut[vertexIdx1] };
+		const Vertex_Out& v2Out{ verticesOut[vertexIdx2] };
 
-				// If only the bounding box should be rendered, do no triangle checks, just display a white color
-				if (renderInfo.isShowingBoundingBoxes)
+#ifdef BATCHED_SHADING
+		// The opaque pixels of this triangle are shaded in batches
+		ShadingBatch shadingBatch{};
+#endif
+
+		// The pixel that is shaded for every 2x2 block of the bounding box (-1 if none yet), blocks with a shading rate of 4x4 use their top-left 2x2 block
+		// With multisampling the first covered sample of the shaded pixel is stored instead (pixel * MSAA_SAMPLE_COUNT + sample)
+		// Only created when the triangle touches a tile with a coarse shading rate
+		const int shadingBlocksStartX{ startX & ~3 };
+		const int shadingBlocksStartY{ startY & ~3 };
+		const int nrShadingBlocksX{ (endX - shadingBlocksStartX) / 2 + 1 };
+		const int nrShadingBlocksY{ (endY - shadingBlocksStartY) / 2 + 1 };
+		std::vector<int> shadingBlockPixels{};
+		// The pixels that copy the color of a shaded pixel in their block (pixel, covered samples, shaded pixel or sample)
+		std::vector<std::tuple<int, uint32_t, int>> copiedPixels{};
+
+		// With multisampling the edge functions and the depth are evaluated at the samples of a pixel at once, one sample per lane
+		// Both are linear in screen space (the depth as 1 / z), so every sample is the value at the pixel plus a constant offset per sample
+		static_assert(MSAA_SAMPLE_COUNT == 4, "The samples of a pixel are evaluated in the 4 lanes of an SSE register");
+		__m128 edge01SampleOffsets{};
+		__m128 edge12SampleOffsets{};
+		__m128 edge20SampleOffsets{};
+		__m128 inverseDepthSampleOffsets{};
+		if (renderInfo.pSampleDepthBuffer)
+		{
+			// The rotated grid pattern of D3D for 4 samples in 1/16 of a pixel from the pixel position, no two samples share a row or a column
+			const __m128 sampleOffsetsX{ _mm_setr_ps(-2.0f / 16.0f, 6.0f / 16.0f, -6.0f / 16.0f, 2.0f / 16.0f) };
+			const __m128 sampleOffsetsY{ _mm_setr_ps(-6.0f / 16.0f, -2.0f / 16.0f, 2.0f / 16.0f, 6.0f / 16.0f) };
+
+			// Cross(edge, point + offset - v) = Cross(edge, point - v) + edge.x * offset.y - edge.y * offset.x
+			const auto calculateEdgeOffsets{ [&](const Vector2& edge)
 				{
-					renderInfo.pBackBufferPixels[pixelIdx] = SDL_MapRGB(renderInfo.pBackBuffer->format,
-						static_cast<uint8_t>(255),
-						static_cast<uint8_t>(255),
-						static_cast<uint8_t>(255));
+					return _mm_sub_ps(_mm_mul_ps(_mm_set1_ps(edge.x), sampleOffsetsY), _mm_mul_ps(_mm_set1_ps(edge.y), sampleOffsetsX));
+				} };
+			edge01SampleOffsets = calculateEdgeOffsets(edge01);
+			edge12SampleOffsets = calculateEdgeOffsets(edge12);
+			edge20SampleOffsets = calculateEdgeOffsets(edge20);
+
+			// The inverse depth is the sum of the barycentric weights divided by the depths of the vertices
+			inverseDepthSampleOffsets = _mm_div_ps(
+				_mm_add_ps(_mm_add_ps(
+					_mm_div_ps(edge12SampleOffsets, _mm_set1_ps(v0Out.position.z)),
+					_mm_div_ps(edge20SampleOffsets, _mm_set1_ps(v1Out.position.z))),
+					_mm_div_ps(edge01SampleOffsets, _mm_set1_ps(v2Out.position.z))),
+				_mm_set1_ps(fullTriangleArea));
+		}
 
-					continue;
-				}
+		// The coverage of every 8x8 tile of the bounding box, tiles that only show fully transparent texels are skipped
+		// Only created for transparent triangles that show both transparent and visible texels
+		constexpr int coverageTileSize{ 8 };
+		const int coverageTilesStartX{ startX & ~(coverageTileSize - 1) };
+		const int coverageTilesStartY{ startY & ~(coverageTileSize - 1) };
+		const int nrCoverageTilesX{ (endX - coverageTilesStartX + coverageTileSize - 1) / coverageTileSize };
+		const int nrCoverageTilesY{ (endY - coverageTilesStartY + coverageTileSize - 1) / coverageTileSize };
+		std::vector<AlphaCoverage::Coverage> tileCoverages{};
+
+		const AlphaCoverage* pAlphaCoverage{ m_IsTransparent && m_pDiffuseMap ? m_pDiffuseMap->GetAlphaCoverage() : nullptr };
+		if (pAlphaCoverage)
+		{
+			// The interpolated uvs are always inside the range of the uvs of the vertices
+			const Vector2 triangleMinUV{ Vector2::Min(v0Out.uv, Vector2::Min(v1Out.uv, v2Out.uv)) };
+			const Vector2 triangleMaxUV{ Vector2::Max(v0Out.uv, Vector2::Max(v1Out.uv, v2Out.uv)) };
 
-				// Calculate the current pixel position
-				const Vector2 curPixel{ static_cast<float>(px), static_cast<float>(py) };
+			// Calculates the uv divided by the depth and the inverse depth at a point on the plane of the triangle, both change linearly over the screen
+			const auto calculatePlane{ [&](float x, float y, Vector2& uvOverDepth)
+				{
+					const Vector2 point{ x, y };
+					const float weightV0{ Vector2::Cross(edge12, point - v1) / fullTriangleArea / v0Out.position.w };
+					const float weightV1{ Vector2::Cross(edge20, point - v2) / fullTriangleArea / v1Out.position.w };
+					const float weightV2{ Vector2::Cross(edge01, point - v0) / fullTriangleArea / v2Out.position.w };
+
+					uvOverDepth = v0Out.uv * weightV0 + v1Out.uv * weightV1 + v2Out.uv * weightV2;
+					return weightV0 + weightV1 + weightV2;
+				} };
 
-				// Calculate the vector between the first vertex and the point
-				const Vector2 v0ToPoint{ curPixel - v0 };
-				const Vector2 v1ToPoint{ curPixel - v1 };
-				const Vector2 v2ToPoint{ curPixel - v2 };
+			// Calculates the perspective correct uv at a point on the plane of the triangle, false if the point is behind the camera
+			const auto calculateUV{ [&](float x, float y, Vector2& uv)
+				{
+					Vector2 uvOverDepth{};
+					const float inverseWDepth{ calculatePlane(x, y, uvOverDepth) };
+					if (inverseWDepth <= 0.0f) return false;
+
+					uv = uvOverDepth / inverseWDepth;
+					return true;
+				} };
+
+			// Calculates the highest mip level of the diffuse map that the quads in a rectangle of pixels can sample
+			// The derivative of the uv is (uvOverDepth' * inverseDepth - uvOverDepth * inverseDepth') / inverseDepth^2, the numerator changes linearly
+			// So the largest numerator and the smallest inverse depth are both found in the corners of the rectangle
+			const int highestMip{ m_pDiffuseMap->GetNrCPUMips() - 1 };
+			const auto calculateMaxMip{ [&](float left, float top, float right, float bottom)
+				{
+					if (highestMip == 0) return 0;
+
+					// The change of the plane to the next pixel on the row and column
+					Vector2 uvOverDepth{}, rightUVOverDepth{}, downUVOverDepth{};
+					const float inverseDepth{ calculatePlane(left, top, uvOverDepth) };
+					const float rightInverseDepth{ calculatePlane(left + 1.0f, top, rightUVOverDepth) };
+					const float downInverseDepth{ calculatePlane(left, top + 1.0f, downUVOverDepth) };
+					const Vector2 uvOverDepthDdx{ rightUVOverDepth - uvOverDepth };
+					const Vector2 uvOverDepthDdy{ downUVOverDepth - uvOverDepth };
+					const float inverseDepthDdx{ rightInverseDepth - inverseDepth };
+					const float inverseDepthDdy{ downInverseDepth - inverseDepth };
+
+					Vector2 maxNumeratorDdx{};
+					Vector2 maxNumeratorDdy{};
+					float minInverseDepth{ FLT_MAX };
+					for (const Vector2& corner : { Vector2{ left, top }, Vector2{ right, top }, Vector2{ left, bottom }, Vector2{ right, bottom } })
+					{
+						Vector2 cornerUVOverDepth{};
+						const float cornerInverseDepth{ calculatePlane(corner.x, corner.y, cornerUVOverDepth) };
 
-				// Calculate cross product from edge to start to point
-				const float edge01PointCross{ Vector2::Cross(edge01, v0ToPoint) };
-				const float edge12PointCross{ Vector2::Cross(edge12, v1ToPoint) };
-				const float edge20PointCross{ Vector2::Cross(edge20, v2ToPoint) };
+						// Part of the rectangle is behind the camera, any level can be sampled
+						if (cornerInverseDepth <= 0.0f) return highestMip;
 
-				// Calculate which side of the triangle has been hit
-				const bool isFrontFaceHit{ edge01PointCross > 0 && edge12PointCross > 0 && edge20PointCross > 0 };
-				const bool isBackFaceHit{ edge01PointCross < 0 && edge12PointCross < 0 && edge20PointCross < 0 };
+						const Vector2 numeratorDdx{ uvOverDepthDdx * cornerInverseDepth - cornerUVOverDepth * inverseDepthDdx };
+						const Vector2 numeratorDdy{ uvOverDepthDdy * cornerInverseDepth - cornerUVOverDepth * inverseDepthDdy };
+						maxNumeratorDdx = Vector2::Max(maxNumeratorDdx, Vector2{ abs(numeratorDdx.x), abs(numeratorDdx.y) });
+						maxNumeratorDdy = Vector2::Max(maxNumeratorDdy, Vector2{ abs(numeratorDdy.x), abs(numeratorDdy.y) });
+						minInverseDepth = std::min(minInverseDepth, cornerInverseDepth);
+					}
 
-				// Continue to the next pixel if this pixel does not meet the criteria of the cullmode
-				if ((m_CullMode == CullMode::Back && !isFrontFaceHit) ||
-					(m_CullMode == CullMode::Front && !isBackFaceHit) ||
-					(m_CullMode == CullMode::None && !isBackFaceHit && !isFrontFaceHit)) continue;
+					const float inverseSqrDepth{ 1.0f / (minInverseDepth * minInverseDepth) };
+					return m_pDiffuseMap->CalculateMip(maxNumeratorDdx * inverseSqrDepth, maxNumeratorDdy * inverseSqrDepth);
+				} };
 
-				// Calculate the barycentric weights
-				const float weightV0{ edge12PointCross / fullTriangleArea };
-				const float weightV1{ edge20PointCross / fullTriangleArea };
-				const float weightV2{ edge01PointCross / fullTriangleArea };
+			// Skip the whole triangle when none of its texels are visible, the quads can reach one pixel outside of the bounding box
+			const int triangleMaxMip{ calculateMaxMip(static_cast<float>(startX & ~1), static_cast<float>(startY & ~1), static_cast<float>(endX), static_cast<float>(endY)) };
+			const AlphaCoverage::Coverage triangleCoverage{ pAlphaCoverage->GetCoverage(triangleMinUV, triangleMaxUV, triangleMaxMip) };
+			if (triangleCoverage == AlphaCoverage::Coverage::Transparent) return;
 
-				// Calculate the Z depth at this pixel
-				const float interpolatedZDepth
+			if (triangleCoverage == AlphaCoverage::Coverage::Partial)
+			{
+				tileCoverages.resize(static_cast<size_t>(nrCoverageTilesX) * nrCoverageTilesY);
+				for (int tileY{}; tileY < nrCoverageTilesY; ++tileY)
 				{
-					1.0f /
-						(weightV0 / verticesOut[vertexIdx0].position.z +
-						weightV1 / verticesOut[vertexIdx1].position.z +
-						weightV2 / verticesOut[vertexIdx2].position.z)
-				};
+					for (int tileX{}; tileX < nrCoverageTilesX; ++tileX)
+					{
+						// The uvs inside a tile are inside the range of the uvs at its corners, the plane of the triangle maps rectangles to convex shapes
+						const float left{ static_cast<float>(coverageTilesStartX + tileX * coverageTileSize) };
+						const float top{ static_cast<float>(coverageTilesStartY + tileY * coverageTileSize) };
+						const float right{ left + coverageTileSize - 1 };
+						const float bottom{ top + coverageTileSize - 1 };
+
+						Vector2 cornerUVs[4]{};
+						const bool areCornersValid
+						{
+							calculateUV(left, top, cornerUVs[0]) && calculateUV(right, top, cornerUVs[1]) &&
+							calculateUV(left, bottom, cornerUVs[2]) && calculateUV(right, bottom, cornerUVs[3])
+						};
+
+						// Only the part of the tile inside the triangle is visible, so limit the range to the uvs of the triangle
+						Vector2 tileMinUV{ triangleMinUV };
+						Vector2 tileMaxUV{ triangleMaxUV };
+						int tileMaxMip{ triangleMaxMip };
+						if (areCornersValid)
+						{
+							tileMinUV = Vector2::Max(tileMinUV, Vector2::Min(Vector2::Min(cornerUVs[0], cornerUVs[1]), Vector2::Min(cornerUVs[2], cornerUVs[3])));
+							tileMaxUV = Vector2::Min(tileMaxUV, Vector2::Max(Vector2::Max(cornerUVs[0], cornerUVs[1]), Vector2::Max(cornerUVs[2], cornerUVs[3])));
+							tileMaxMip = calculateMaxMip(left, top, right, bottom);
+
+							// Tiles that only touch the triangle can end up with an empty range because of rounding errors
+							if (tileMinUV.x > tileMaxUV.x || tileMinUV.y > tileMaxUV.y)
+							{
+								tileMinUV = triangleMinUV;
+								tileMaxUV = triangleMaxUV;
+							}
+						}
+
+						// The samples of a higher mip level average the texels around the uv range, so the range is widened for the mip levels of the tile
+						tileCoverages[tileX + tileY * nrCoverageTilesX] = pAlphaCoverage->GetCoverage(tileMinUV, tileMaxUV, tileMaxMip);
+					}
+				}
+			}
+		}
 
-				// If the depth is outside the frustum,
-				// Or if the current depth buffer is less then the current depth,
-				// continue to the next pixel
-				if (renderInfo.pDepthBuffer[pixelIdx] < interpolatedZDepth)
+		// For each 2x2 quad, quads start on even pixels so they never cross a light tile
+		for (int quadY{ startY & ~1 }; quadY < endY; quadY += 2)
+		{
+			for (int quadX{ startX & ~1 }; quadX < endX; quadX += 2)
+			{
+				// Skip the quads in tiles without visible texels before anything is interpolated or sampled
+				if (!tileCoverages.empty() &&
+					tileCoverages[(quadX - coverageTilesStartX) / coverageTileSize + ((quadY - coverageTilesStartY) / coverageTileSize) * nrCoverageTilesX] == AlphaCoverage::Coverage::Transparent)
 					continue;
 
-				// Save the new depth
-				if (!m_IsTransparent) renderInfo.pDepthBuffer[pixelIdx] = interpolatedZDepth;
+				PixelQuad quad{};
+				quad.x = quadX;
+				quad.y = quadY;
 
-				// The pixel info
-				Vertex_Out pixelInfo{};
+				// The barycentric weights of every pixel in the quad, these are also needed for the pixels outside the triangle
+				float weights[4][3]{};
 
-				// Switch between all the render states
-				if (renderInfo.isShowingDepthBuffer)
+				for (int quadPixel{}; quadPixel < 4; ++quadPixel)
 				{
-					if (m_IsTransparent) return;
+					const int px{ quadX + quadPixel % 2 };
+					const int py{ quadY + quadPixel / 2 };
 
-					// Remap the Z depth
-					const float depthColor{ Remap(interpolatedZDepth, 0.997f, 1.0f) };
+					// Calculate the current pixel position
+					const Vector2 curPixel{ static_cast<float>(px), static_cast<float>(py) };
 
-					// Set the color of the current pixel to showcase the depth
-					pixelInfo.color = { depthColor, depthColor, depthColor };
-				}
-				else
-				{
-					const Vertex_Out& v0Out{ verticesOut[vertexIdx0] };
-					const Vertex_Out& v1Out{ verticesOut[vertexIdx1] };
-					const Vertex_Out& v2Out{ verticesOut[vertexIdx2] };
+					// Calculate the vector between the first vertex and the point
+					const Vector2 v0ToPoint{ curPixel - v0 };
+					const Vector2 v1ToPoint{ curPixel - v1 };
+					const Vector2 v2ToPoint{ curPixel - v2 };
+
+					// Calculate cross product from edge to start to point
+					const float edge01PointCross{ Vector2::Cross(edge01, v0ToPoint) };
+					const float edge12PointCross{ Vector2::Cross(edge12, v1ToPoint) };
+					const float edge20PointCross{ Vector2::Cross(edge20, v2ToPoint) };
+
+					// Calculate the barycentric weights
+					weights[quadPixel][0] = edge12PointCross / fullTriangleArea;
+					weights[quadPixel][1] = edge20PointCross / fullTriangleArea;
+					weights[quadPixel][2] = edge01PointCross / fullTriangleArea;
+
+					// Pixels outside the screen or the bounding box are never covered
+					if (px >= endX || py >= endY || px < startX || py < startY) continue;
 
-					// Calculate the W depth at this pixel
-					const float interpolatedWDepth
+					if (renderInfo.pSampleDepthBuffer)
+					{
+						// Evaluate the edges at every sample of the pixel, a sample is covered when it is on the inside of all three edges
+						const __m128 edge01SampleCrosses{ _mm_add_ps(_mm_set1_ps(edge01PointCross), edge01SampleOffsets) };
+						const __m128 edge12SampleCrosses{ _mm_add_ps(_mm_set1_ps(edge12PointCross), edge12SampleOffsets) };
+						const __m128 edge20SampleCrosses{ _mm_add_ps(_mm_set1_ps(edge20PointCross), edge20SampleOffsets) };
+						const __m128 zero{ _mm_setzero_ps() };
+						const uint32_t frontFaceSamples{ static_cast<uint32_t>(_mm_movemask_ps(_mm_and_ps(_mm_and_ps(
+							_mm_cmpgt_ps(edge01SampleCrosses, zero), _mm_cmpgt_ps(edge12SampleCrosses, zero)), _mm_cmpgt_ps(edge20SampleCrosses, zero)))) };
+						const uint32_t backFaceSamples{ static_cast<uint32_t>(_mm_movemask_ps(_mm_and_ps(_mm_and_ps(
+							_mm_cmplt_ps(edge01SampleCrosses, zero), _mm_cmplt_ps(edge12SampleCrosses, zero)), _mm_cmplt_ps(edge20SampleCrosses, zero)))) };
+
+						// Only keep the samples of the side that is not culled
+						const uint32_t coveredSamples
+						{
+							m_CullMode == CullMode::Back ? frontFaceSamples :
+							m_CullMode == CullMode::Front ? backFaceSamples :
+							frontFaceSamples | backFaceSamples
+						};
+						if (coveredSamples == 0) continue;
+
+						// Calculate the Z depth at the pixel and at every sample
+						const float inverseDepth
+						{
+							weights[quadPixel][0] / v0Out.position.z +
+							weights[quadPixel][1] / v1Out.position.z +
+							weights[quadPixel][2] / v2Out.position.z
+						};
+						alignas(16) float sampleDepths[MSAA_SAMPLE_COUNT]{};
+						_mm_store_ps(sampleDepths, _mm_div_ps(_mm_set1_ps(1.0f), _mm_add_ps(_mm_set1_ps(inverseDepth), inverseDepthSampleOffsets)));
+
+						// Depth test every covered sample and save the depth of the visible samples
+						const int pixelIdx{ px + py * renderInfo.width };
+						uint32_t* pSampleDepthCodes{ renderInfo.pSampleDepthBuffer + pixelIdx * MSAA_SAMPLE_COUNT };
+						uint32_t visibleSamples{};
+						for (int sampleIdx{}; sampleIdx < MSAA_SAMPLE_COUNT; ++sampleIdx)
+						{
+							if (!(coveredSamples & (1u << sampleIdx))) continue;
+
+							const uint32_t depthCode{ renderInfo.EncodeDepth(sampleDepths[sampleIdx]) };
+							if (!renderInfo.IsDepthVisible(depthCode, pSampleDepthCodes[sampleIdx])) continue;
+
+							if (!m_IsTransparent) pSampleDepthCodes[sampleIdx] = depthCode;
+							visibleSamples |= 1u << sampleIdx;
+						}
+						if (visibleSamples == 0) continue;
+
+						// The triangle that is visible in the most recently covered sample
+						if (!m_IsTransparent && renderInfo.pTriangleIdBuffer) renderInfo.pTriangleIdBuffer[pixelIdx] = triangleId;
+
+						// The pixel is shaded once with the attributes at the pixel position, even when only some of its samples are covered
+						quad.coverageMask |= 1u << quadPixel;
+						quad.sampleMasks[quadPixel] = visibleSamples;
+						quad.depths[quadPixel] = 1.0f / inverseDepth;
+						continue;
+					}
+
+					// Calculate which side of the triangle has been hit
+					const bool isFrontFaceHit{ edge01PointCross > 0 && edge12PointCross > 0 && edge20PointCross > 0 };
+					const bool isBackFaceHit{ edge01PointCross < 0 && edge12PointCross < 0 && edge20PointCross < 0 };
+
+					// Continue to the next pixel if this pixel does not meet the criteria of the cullmode
+					if ((m_CullMode == CullMode::Back && !isFrontFaceHit) ||
+						(m_CullMode == CullMode::Front && !isBackFaceHit) ||
+						(m_CullMode == CullMode::None && !isBackFaceHit && !isFrontFaceHit)) continue;
+
+					// Calculate the Z depth at this pixel
+					const float interpolatedZDepth
 					{
 						1.0f /
-							(weightV0 / v0Out.position.w +
-							weightV1 / v1Out.position.w +
-							weightV2 / v2Out.position.w)
+							(weights[quadPixel][0] / v0Out.position.z +
+							weights[quadPixel][1] / v1Out.position.z +
+							weights[quadPixel][2] / v2Out.position.z)
 					};
 
-					// Calculate the UV coordinate at this pixel
-					pixelInfo.uv =
+					// If the current depth buffer is closer than the current depth, continue to the next pixel
+					// The depths are compared as integers in the format of the depth buffer
+					const int pixelIdx{ px + py * renderInfo.width };
+					const uint32_t depthCode{ renderInfo.EncodeDepth(interpolatedZDepth) };
+					if (!renderInfo.IsDepthVisible(depthCode, renderInfo.GetDepthCode(pixelIdx)))
+						continue;
+
+					// Save the new depth and the triangle that is visible
+					if (!m_IsTransparent)
 					{
-						(weightV0 * v0Out.uv / v0Out.position.w +
-						weightV1 * v1Out.uv / v1Out.position.w +
-						weightV2 * v2Out.uv / v2Out.position.w)
-							* interpolatedWDepth
-					};
+						renderInfo.SetDepthCode(pixelIdx, depthCode);
+						if (renderInfo.pTriangleIdBuffer) renderInfo.pTriangleIdBuffer[pixelIdx] = triangleId;
+					}
+
+					quad.coverageMask |= 1u << quadPixel;
+					quad.sampleMasks[quadPixel] = ALL_SAMPLES_MASK;
+					quad.depths[quadPixel] = interpolatedZDepth;
+				}
+
+				// Skip quads without any visible pixels
+				if (quad.coverageMask == 0) continue;
 
-					// Calculate the normal at this pixel
-					pixelInfo.normal =
-						Vector3{
-							(weightV0 * v0Out.normal / v0Out.position.w +
-							weightV1 * v1Out.normal / v1Out.position.w +
-							weightV2 * v2Out.normal / v2Out.position.w)
-								* interpolatedWDepth
-					}.Normalized();
-
-					// Calculate the tangent at this pixel
-					pixelInfo.tangent =
-						Vector3{
-							(weightV0 * v0Out.tangent / v0Out.position.w +
-							weightV1 * v1Out.tangent / v1Out.position.w +
-							weightV2 * v2Out.tangent / v2Out.position.w)
-								* interpolatedWDepth
-					}.Normalized();
-
-					// Calculate the view direction at this pixel
-					pixelInfo.viewDirection =
-						Vector3{
-							(weightV0 * v0Out.viewDirection / v0Out.position.w +
-							weightV1 * v1Out.viewDirection / v1Out.position.w +
-							weightV2 * v2Out.viewDirection / v2Out.position.w)
-								* interpolatedWDepth
-					}.Normalized();
+				// Interpolate the attributes of the covered pixels, the uncovered pixels only need their uv for the derivatives
+				if (!renderInfo.isShowingDepthBuffer)
+				{
+					for (int quadPixel{}; quadPixel < 4; ++quadPixel)
+					{
+						InterpolatePixel(v0Out, v1Out, v2Out, weights[quadPixel], renderInfo, quad.pixels[quadPixel], !quad.IsCovered(quadPixel));
+					}
+
+					// Every pixel of the quad uses the same uv derivatives to select the mip level of the textures
+					const Vector2 uvDdx{ quad.Ddx(&Vertex_Out::uv) };
+					const Vector2 uvDdy{ quad.Ddy(&Vertex_Out::uv) };
+					for (Vertex_Out& pixelInfo : quad.pixels)
+					{
+						pixelInfo.uvDdx = uvDdx;
+						pixelInfo.uvDdy = uvDdy;
+					}
 				}
 
-				// Calculate the shading at this pixel and display it on screen
-				PixelShading(px + (py * renderInfo.width), pixelInfo, renderInfo);
+				// Shade the covered pixels of the quad
+				for (int quadPixel{}; quadPixel < 4; ++quadPixel)
+				{
+					if (!quad.IsCovered(quadPixel)) continue;
+
+					const int px{ quadX + quadPixel % 2 };
+					const int py{ quadY + quadPixel / 2 };
+					const int pixelIdx{ px + py * renderInfo.width };
+					const uint32_t sampleMask{ quad.sampleMasks[quadPixel] };
+
+					Vertex_Out& pixelInfo{ quad.pixels[quadPixel] };
+
+					if (renderInfo.pReprojectionCache && !renderInfo.isShowingDepthBuffer && !m_IsTransparent)
+					{
+						// Pixels are shaded again after a number of frames, the start age is spread over the screen so not all pixels expire in the same frame
+						renderInfo.pReuseAgeBuffer[pixelIdx] = static_cast<uint8_t>((px * 3 + py * 5) % ReprojectionCache::maxReuseAge);
+
+						// In checkerboard mode half of the pixels are not shaded this frame
+						const bool isCheckerboardSkipped{ renderInfo.isCheckerboardEnabled && ((px + py + renderInfo.checkerboardParity) & 1) };
+
+						// Reuse the color of the previous frame if this pixel still shows the same surface
+						if ((isCheckerboardSkipped || renderInfo.isReprojectionCacheEnabled) && ReuseCachedColor(px, py, triangleId, sampleMask, pixelInfo, renderInfo)) continue;
+
+						// Skipped pixels that can't be reprojected are filled in from their neighbours after all opaque meshes are rendered
+						if (isCheckerboardSkipped)
+						{
+							renderInfo.pReuseAgeBuffer[pixelIdx] = ReprojectionCache::unresolvedAge;
+							continue;
+						}
+					}
+
+					// With a coarse shading rate only the first covered pixel of each block is shaded, the other pixels copy its color
+					if (!renderInfo.isShowingDepthBuffer && !m_IsTransparent)
+					{
+						const ShadingRate shadingRate{ renderInfo.tileShadingRates[renderInfo.GetLightTileIdx(px, py)] };
+						if (shadingRate != ShadingRate::Rate1x1)
+						{
+							const int blockSize{ shadingRate == ShadingRate::Rate2x2 ? 2 : 4 };
+							const int blockX{ ((px & ~(blockSize - 1)) - shadingBlocksStartX) / 2 };
+							const int blockY{ ((py & ~(blockSize - 1)) - shadingBlocksStartY) / 2 };
+
+							if (shadingBlockPixels.empty()) shadingBlockPixels.resize(static_cast<size_t>(nrShadingBlocksX) * nrShadingBlocksY, -1);
+
+							int& shadedPixelIdx{ shadingBlockPixels[blockX + blockY * nrShadingBlocksX] };
+							if (shadedPixelIdx >= 0)
+							{
+								copiedPixels.emplace_back(pixelIdx, sampleMask, shadedPixelIdx);
+								continue;
+							}
+							shadedPixelIdx = renderInfo.pSampleColorBuffer ? pixelIdx * MSAA_SAMPLE_COUNT + std::countr_zero(sampleMask) : pixelIdx;
+						}
+					}
+
+					if (renderInfo.isShowingDepthBuffer)
+					{
+						// Remap the Z depth, reversed depth is flipped so the far plane stays white
+						const float depth{ renderInfo.isDepthReversed ? 1.0f - quad.depths[quadPixel] : quad.depths[quadPixel] };
+						const float depthColor{ Remap(depth, 0.997f, 1.0f) };
+
+						// Set the color of the current pixel to showcase the depth
+						pixelInfo.color = { depthColor, depthColor, depthColor };
+					}
+#ifdef BATCHED_SHADING
+					else if (!m_IsTransparent)
+					{
+						// All the pixels of a batch use the lights of the same tile, so shade the batch when the tile changes
+						const int lightTileIdx{ renderInfo.GetLightTileIdx(px, py) };
+						if (shadingBatch.count > 0 && shadingBatch.lightTileIdx != lightTileIdx) ShadeBatch(shadingBatch, renderInfo);
+						shadingBatch.lightTileIdx = lightTileIdx;
+
+						// Add the pixel to the batch and shade the batch once it is full
+						const int lane{ shadingBatch.count++ };
+						shadingBatch.pixelIndices[lane] = pixelIdx;
+						shadingBatch.sampleMasks[lane] = sampleMask;
+						shadingBatch.u[lane] = pixelInfo.uv.x;
+						shadingBatch.v[lane] = pixelInfo.uv.y;
+						shadingBatch.ddxU[lane] = pixelInfo.uvDdx.x;
+						shadingBatch.ddxV[lane] = pixelInfo.uvDdx.y;
+						shadingBatch.ddyU[lane] = pixelInfo.uvDdy.x;
+						shadingBatch.ddyV[lane] = pixelInfo.uvDdy.y;
+						shadingBatch.normalX[lane] = pixelInfo.normal.x;
+						shadingBatch.normalY[lane] = pixelInfo.normal.y;
+						shadingBatch.normalZ[lane] = pixelInfo.normal.z;
+						shadingBatch.tangentX[lane] = pixelInfo.tangent.x;
+						shadingBatch.tangentY[lane] = pixelInfo.tangent.y;
+						shadingBatch.tangentZ[lane] = pixelInfo.tangent.z;
+						shadingBatch.viewDirectionX[lane] = pixelInfo.viewDirection.x;
+						shadingBatch.viewDirectionY[lane] = pixelInfo.viewDirection.y;
+						shadingBatch.viewDirectionZ[lane] = pixelInfo.viewDirection.z;
+						shadingBatch.worldPositionX[lane] = pixelInfo.worldPosition.x;
+						shadingBatch.worldPositionY[lane] = pixelInfo.worldPosition.y;
+						shadingBatch.worldPositionZ[lane] = pixelInfo.worldPosition.z;
+
+						if (shadingBatch.count == SHADING_BATCH_WIDTH) ShadeBatch(shadingBatch, renderInfo);
+						continue;
+					}
+#endif
+
+					// Calculate the shading at this pixel and display it on screen
+					PixelShading(pixelIdx, sampleMask, pixelInfo, renderInfo);
+				}
+			}
+		}
+
+#ifdef BATCHED_SHADING
+		// Shade the pixels that are left
+		if (shadingBatch.count > 0) ShadeBatch(shadingBatch, renderInfo);
+#endif
+
+		// Copy the shaded colors to the other pixels of their block
+		for (const auto& [pixelIdx, sampleMask, shadedPixelIdx] : copiedPixels)
+		{
+			ColorUtils::CopyColor(renderInfo, pixelIdx, shadedPixelIdx, sampleMask);
+		}
+	}
+
+	void Mesh::InterpolatePixel(const Vertex_Out& v0Out, const Vertex_Out& v1Out, const Vertex_Out& v2Out, const float* pWeights, const SoftwareRenderInfo& renderInfo, Vertex_Out& pixelInfo, bool isHelperPixel) const
+	{
+		const float weightV0{ pWeights[0] };
+		const float weightV1{ pWeights[1] };
+		const float weightV2{ pWeights[2] };
+
+		// Calculate the W depth at this pixel
+		const float interpolatedWDepth
+		{
+			1.0f /
+				(weightV0 / v0Out.position.w +
+				weightV1 / v1Out.position.w +
+				weightV2 / v2Out.position.w)
+		};
+		pixelInfo.position.w = interpolatedWDepth;
+
+		// Calculate the UV coordinate at this pixel
+		pixelInfo.uv =
+		{
+			(weightV0 * v0Out.uv / v0Out.position.w +
+			weightV1 * v1Out.uv / v1Out.position.w +
+			weightV2 * v2Out.uv / v2Out.position.w)
+				* interpolatedWDepth
+		};
+
+		// Helper pixels are never shaded, their uv is only used for the derivatives of the quad
+		if (isHelperPixel) return;
+
+		// Calculate the normal at this pixel
+		pixelInfo.normal =
+			Vector3{
+				(weightV0 * v0Out.normal / v0Out.position.w +
+				weightV1 * v1Out.normal / v1Out.position.w +
+				weightV2 * v2Out.normal / v2Out.position.w)
+					* interpolatedWDepth
+		}.Normalized();
+
+		// Calculate the tangent at this pixel, this is only needed for tangent space normal mapping
+		if (renderInfo.isNormalMapActive && !m_pObjectSpaceNormalMap)
+		{
+			pixelInfo.tangent =
+				Vector3{
+					(weightV0 * v0Out.tangent / v0Out.position.w +
+					weightV1 * v1Out.tangent / v1Out.position.w +
+					weightV2 * v2Out.tangent / v2Out.position.w)
+						* interpolatedWDepth
+			}.Normalized();
+		}
+
+		// Calculate the view direction at this pixel
+		pixelInfo.viewDirection =
+			Vector3{
+				(weightV0 * v0Out.viewDirection / v0Out.position.w +
+				weightV1 * v1Out.viewDirection / v1Out.position.w +
+				weightV2 * v2Out.viewDirection / v2Out.position.w)
+					* interpolatedWDepth
+		}.Normalized();
+
+		// Calculate the world position at this pixel
+		pixelInfo.worldPosition =
+			(weightV0 * v0Out.worldPosition / v0Out.position.w +
+			weightV1 * v1Out.worldPosition / v1Out.position.w +
+			weightV2 * v2Out.worldPosition / v2Out.position.w)
+				* interpolatedWDepth;
+
+		// Calculate the position in the previous frame at this pixel, this is only needed for the reprojection cache
+		if (renderInfo.pReprojectionCache && renderInfo.pReprojectionCache->isValid)
+		{
+			pixelInfo.previousPosition =
+				(v0Out.previousPosition * (weightV0 / v0Out.position.w) +
+				v1Out.previousPosition * (weightV1 / v1Out.position.w) +
+				v2Out.previousPosition * (weightV2 / v2Out.position.w))
+					* interpolatedWDepth;
+		}
+	}
+
+	bool Mesh::ReuseCachedColor(int px, int py, uint32_t triangleId, uint32_t sampleMask, const Vertex_Out& pixelInfo, const SoftwareRenderInfo& renderInfo) const
+	{
+		const ReprojectionCache& cache{ *renderInfo.pReprojectionCache };
+		if (!cache.isValid) return false;
+
+		// Points behind the camera in the previous frame were not visible
+		const Vector4& previousPosition{ pixelInfo.previousPosition };
+		if (previousPosition.w <= 0.0f) return false;
+
+		// Calculate the pixel that showed this point in the previous frame
+		const float previousX{ (previousPosition.x / previousPosition.w + 1) / 2.0f * renderInfo.width };
+		const float previousY{ (1.0f - previousPosition.y / previousPosition.w) / 2.0f * renderInfo.height };
+		const int previousPx{ static_cast<int>(std::floor(previousX + 0.5f)) };
+		const int previousPy{ static_cast<int>(std::floor(previousY + 0.5f)) };
+		if (previousPx < 0 || previousPy < 0 || previousPx >= renderInfo.width || previousPy >= renderInfo.height) return false;
+		const int previousPixelIdx{ previousPx + previousPy * renderInfo.width };
+
+		// The point has to be on the same triangle and not hidden behind another surface in the previous frame
+		if (cache.triangleIds[previousPixelIdx] != triangleId) return false;
+		if (abs(cache.depths[previousPixelIdx] - previousPosition.w) > ReprojectionCache::maxDepthDifference * previousPosition.w) return false;
+
+		// Shade the pixel again when its color has been reused for too long
+		const uint8_t reuseAge{ cache.reuseAges[previousPixelIdx] };
+		if (reuseAge >= ReprojectionCache::maxReuseAge) return false;
+
+		const int pixelIdx{ px + py * renderInfo.width };
+		if (renderInfo.pSampleColorBuffer)
+		{
+			// The cached color is the resolved color of the previous pixel
+			const ColorRGB cachedColor{ renderInfo.pHdrBuffer ? cache.hdrColors[previousPixelIdx] : ColorUtils::UnpackColor(cache.colors[previousPixelIdx], renderInfo.pixelSwizzle) };
+			ColorUtils::WriteColor(renderInfo, pixelIdx, cachedColor, sampleMask);
+		}
+		else if (renderInfo.pHdrBuffer) renderInfo.pHdrBuffer[pixelIdx] = cache.hdrColors[previousPixelIdx];
+		else renderInfo.pBackBufferPixels[pixelIdx] = cache.colors[previousPixelIdx];
+		renderInfo.pReuseAgeBuffer[pixelIdx] = reuseAge + 1;
+		return true;
+	}
+
+	void Mesh::ShadeBatch(ShadingBatch& batch, const SoftwareRenderInfo& renderInfo) const
+	{
+		// Only the lanes that hold a pixel are shaded
+		const uint32_t activeMask{ (1u << batch.count) - 1u };
+
+		// Look up how much of the shadow casting light reaches every pixel, using the interpolated normals like PixelShading
+		alignas(16) float shadowVisibility[SHADING_BATCH_WIDTH]{};
+		if (renderInfo.pShadowMap)
+		{
+			for (int lane{}; lane < batch.count; ++lane)
+			{
+				const Vector3 position{ batch.worldPositionX[lane], batch.worldPositionY[lane], batch.worldPositionZ[lane] };
+				const Vector3 normal{ batch.normalX[lane], batch.normalY[lane], batch.normalZ[lane] };
+				shadowVisibility[lane] = LightingUtils::SampleShadowMap(renderInfo.pShadowMap, renderInfo.shadow.lightViewProjectionMatrix,
+					position + normal * renderInfo.shadow.normalOffset);
+			}
+		}
+
+		// Selects the mip level of every lane from the uv derivatives
+		const auto calculateMips{ [&](const Texture* pTexture, int* pMips)
+			{
+				for (int lane{}; lane < batch.count; ++lane)
+				{
+					pMips[lane] = pTexture->CalculateMip({ batch.ddxU[lane], batch.ddxV[lane] }, { batch.ddyU[lane], batch.ddyV[lane] });
+				}
+			} };
+		int mips[SHADING_BATCH_WIDTH]{};
+
+		// Calculate the normals that should be used in calculations
+		if (renderInfo.isNormalMapActive && m_pObjectSpaceNormalMap)
+		{
+			// Sample the baked normals and rotate them to world space
+			ColorBatch objectSpaceNormals{};
+			calculateMips(m_pObjectSpaceNormalMap, mips);
+			m_pObjectSpaceNormalMap->SampleRGBBatch(batch.u, batch.v, activeMask, objectSpaceNormals, mips);
+
+			for (int lane{}; lane < batch.count; ++lane)
+			{
+				const Vector3 normal{ m_WorldMatrix.TransformVector(
+					2.0f * objectSpaceNormals.r[lane] - 1.0f,
+					2.0f * objectSpaceNormals.g[lane] - 1.0f,
+					2.0f * objectSpaceNormals.b[lane] - 1.0f).Normalized() };
+
+				batch.normalX[lane] = normal.x;
+				batch.normalY[lane] = normal.y;
+				batch.normalZ[lane] = normal.z;
+			}
+		}
+		else if (renderInfo.isNormalMapActive)
+		{
+			// Tangent space normal mapping needs the full tangent frame per pixel
+			for (int lane{}; lane < batch.count; ++lane)
+			{
+				Vertex_Out pixelInfo{};
+				pixelInfo.uv = { batch.u[lane], batch.v[lane] };
+				pixelInfo.uvDdx = { batch.ddxU[lane], batch.ddxV[lane] };
+				pixelInfo.uvDdy = { batch.ddyU[lane], batch.ddyV[lane] };
+				pixelInfo.normal = { batch.normalX[lane], batch.normalY[lane], batch.normalZ[lane] };
+				pixelInfo.tangent = { batch.tangentX[lane], batch.tangentY[lane], batch.tangentZ[lane] };
+
+				const Vector3 normal{ CalculateNormalFromMap(pixelInfo).Normalized() };
+				batch.normalX[lane] = normal.x;
+				batch.normalY[lane] = normal.y;
+				batch.normalZ[lane] = normal.z;
+			}
+		}
+
+		// Sample the textures that are needed by the current lighting mode
+		ColorBatch diffuseColors{};
+		ColorBatch specularColors{};
+		ColorBatch glossinessColors{};
+		if (renderInfo.lightingMode == LightingMode::Combined || renderInfo.lightingMode == LightingMode::Diffuse)
+		{
+			calculateMips(m_pDiffuseMap, mips);
+			m_pDiffuseMap->SampleRGBBatch(batch.u, batch.v, activeMask, diffuseColors, mips);
+		}
+		if (renderInfo.lightingMode == LightingMode::Combined || renderInfo.lightingMode == LightingMode::Specular)
+		{
+			calculateMips(m_pSpecularMap, mips);
+			m_pSpecularMap->SampleRGBBatch(batch.u, batch.v, activeMask, specularColors, mips);
+			calculateMips(m_pGlossinessMap, mips);
+			m_pGlossinessMap->SampleRGBBatch(batch.u, batch.v, activeMask, glossinessColors, mips);
+		}
+
+		// The lights that affect the tile of this batch and the same material properties as in PixelShading
+		const uint32_t firstLightIdx{ renderInfo.tileLightOffsets[batch.lightTileIdx] };
+		LightingParameters lighting{};
+		lighting.pLights = renderInfo.pLights;
+		lighting.pLightIndices = renderInfo.tileLightIndices.data() + firstLightIdx;
+		lighting.nrLights = static_cast<int>(renderInfo.tileLightOffsets[batch.lightTileIdx + 1] - firstLightIdx);
+		lighting.specularShininess = 25.0f;
+		lighting.ambientColor = { 0.025f, 0.025f, 0.025f };
+		if (renderInfo.pShadowMap)
+		{
+			lighting.shadowLightIdx = renderInfo.shadow.lightIdx;
+			lighting.pShadowVisibility = shadowVisibility;
+		}
+		lighting.isScaledToOne = renderInfo.pHdrBuffer == nullptr;
+
+		// Shade all the pixels in the batch
+		ColorBatch finalColors{};
+		LightingKernels::Shade(batch, diffuseColors, specularColors, glossinessColors, renderInfo.lightingMode, lighting, finalColors);
+
+		//Update Color in Buffer
+		if (renderInfo.pSampleColorBuffer)
+		{
+			for (int lane{}; lane < batch.count; ++lane)
+			{
+				ColorUtils::WriteColor(renderInfo, batch.pixelIndices[lane], ColorRGB{ finalColors.r[lane], finalColors.g[lane], finalColors.b[lane] }, batch.sampleMasks[lane]);
 			}
+
+			batch.count = 0;
+			return;
 		}
+
+		if (renderInfo.pHdrBuffer)
+		{
+			for (int lane{}; lane < batch.count; ++lane)
+			{
+				renderInfo.pHdrBuffer[batch.pixelIndices[lane]] = ColorRGB{ finalColors.r[lane], finalColors.g[lane], finalColors.b[lane] };
+			}
+
+			batch.count = 0;
+			return;
+		}
+
+		uint32_t pixels[SHADING_BATCH_WIDTH]{};
+		for (int lane{}; lane < batch.count; lane += 4)
+		{
+			ColorUtils::PackColors(finalColors.r + lane, finalColors.g + lane, finalColors.b + lane, renderInfo.pixelSwizzle, pixels + lane);
+		}
+		for (int lane{}; lane < batch.count; ++lane)
+		{
+			renderInfo.pBackBufferPixels[batch.pixelIndices[lane]] = pixels[lane];
+		}
+
+		batch.count = 0;
 	}
 
-	void Mesh::PixelShading(int pixelIdx, const Vertex_Out& pixelInfo, const SoftwareRenderInfo& renderInfo) const
+	void Mesh::AccumulateTransparency(int pixelIdx, const ColorRGB& color, float viewDepth, const SoftwareRenderInfo& renderInfo) const
+	{
+		// Closer surfaces get a higher weight so they stay in front when the colors are averaged (McGuire and Bavoil, equation 9)
+		const float depthWeight{ std::clamp(0.03f / (1e-5f + powf(viewDepth / 200.0f, 4.0f)), 1e-2f, 3e3f) };
+		const float weight{ color.a * depthWeight };
+
+		// Triangles of the same mesh are rendered in parallel, so the buffers are updated atomically
+		ColorRGB& accumulation{ renderInfo.pTransparencyAccumulation[pixelIdx] };
+		std::atomic_ref<float>{ accumulation.r }.fetch_add(color.r * weight, std::memory_order_relaxed);
+		std::atomic_ref<float>{ accumulation.g }.fetch_add(color.g * weight, std::memory_order_relaxed);
+		std::atomic_ref<float>{ accumulation.b }.fetch_add(color.b * weight, std::memory_order_relaxed);
+		std::atomic_ref<float>{ accumulation.a }.fetch_add(weight, std::memory_order_relaxed);
+
+		// Multiplication is not an atomic operation, so retry until no other thread changed the revealage in between
+		std::atomic_ref<float> revealage{ renderInfo.pTransparencyRevealage[pixelIdx] };
+		float previousRevealage{ revealage.load(std::memory_order_relaxed) };
+		while (!revealage.compare_exchange_weak(previousRevealage, previousRevealage * (1.0f - color.a), std::memory_order_relaxed));
+	}
+
+	void Mesh::PixelShading(int pixelIdx, uint32_t sampleMask, const Vertex_Out& pixelInfo, const SoftwareRenderInfo& renderInfo) const
 	{
 		// The final color that will be rendered
 		ColorRGB finalColor{};
@@ -674,102 +1457,385 @@ namespace dae
 		else if (m_IsTransparent)
 		{
 			// Get the color of the texture
-			const ColorRGB diffuseColor{ m_pDiffuseMap->SampleRGB(pixelInfo.uv) };
+			const ColorRGB diffuseColor{ m_pDiffuseMap->SampleRGB(pixelInfo.uv, m_pDiffuseMap->CalculateMip(pixelInfo.uvDdx, pixelInfo.uvDdy)) };
 
 			// If the alpha is 0, continue to the next pixel 
 			if (diffuseColor.a < FLT_EPSILON) return;
-			
-			// Get the background color
-			Uint8 r{}, g{}, b{};
-			SDL_GetRGB(renderInfo.pBackBufferPixels[pixelIdx], renderInfo.pBackBuffer->format, &r, &g, &b);
-			constexpr float maxColorValue{ 255.0f };
-			const ColorRGB prevColor{ r / maxColorValue, g / maxColorValue, b / maxColorValue };
 
-			// Blend the background color with the new color
-			finalColor += prevColor * (1.0f - diffuseColor.a) + diffuseColor * diffuseColor.a;
+			// Add the color to the order independent transparency buffers, the buffers are composited over the back buffer after all transparent meshes are rendered
+			if (renderInfo.pTransparencyAccumulation)
+			{
+				AccumulateTransparency(pixelIdx, diffuseColor, pixelInfo.position.w, renderInfo);
+				return;
+			}
+
+			// Opaque texels cover the background, so it doesn't have to be read
+			if (diffuseColor.a >= 1.0f)
+			{
+				finalColor += diffuseColor;
+			}
+			else
+			{
+				// Get the background color
+				const ColorRGB prevColor{ ColorUtils::ReadColor(renderInfo, pixelIdx) };
+
+				// Blend the background color with the new color
+				finalColor += prevColor * (1.0f - diffuseColor.a) + diffuseColor * diffuseColor.a;
+			}
 		}
 		else
 		{
-			// Create the ambient color	and add it to the final color
-			const Vector3 lightDirection{ 0.577f, -0.577f, 0.577f };
-			constexpr float lightIntensity{ 7.0f };
+			// The lighting properties of the material
 			constexpr float specularShininess{ 25.0f };
+			constexpr ColorRGB ambientColor{ 0.025f, 0.025f, 0.025f };
 
 			// The normal that should be used in calculations
 			const Vector3 useNormal{ renderInfo.isNormalMapActive ? CalculateNormalFromMap(pixelInfo).Normalized() : pixelInfo.normal };
 
-			// Calculate the observed area in this pixel
-			const float observedArea{ Vector3::DotClamped(useNormal, -lightDirection) };
+			// The mip levels of the textures at this pixel
+			const int diffuseMip{ m_pDiffuseMap->CalculateMip(pixelInfo.uvDdx, pixelInfo.uvDdy) };
+			const int specularMip{ m_pSpecularMap->CalculateMip(pixelInfo.uvDdx, pixelInfo.uvDdy) };
+			const int glossinessMip{ m_pGlossinessMap->CalculateMip(pixelInfo.uvDdx, pixelInfo.uvDdy) };
 
-			// Depending on the lighting mode, different shading should be applied
-			switch (renderInfo.lightingMode)
-			{
-			case LightingMode::Combined:
-			{
-				// The ambient color
-				constexpr ColorRGB ambientColor{ 0.025f, 0.025f, 0.025f };
-				// Calculate the lambert shader
-				const ColorRGB lambert{ LightingUtils::Lambert(m_pDiffuseMap->SampleRGB(pixelInfo.uv)) };
-				// Calculate the phong exponent
-				const float specularExp{ specularShininess * m_pGlossinessMap->SampleRGB(pixelInfo.uv).r };
-				// Calculate the phong shader
-				const ColorRGB specular{ m_pSpecularMap->SampleRGB(pixelInfo.uv) * LightingUtils::Phong(specularExp, -lightDirection, pixelInfo.viewDirection, useNormal) };
-
-				// Lambert + Phong + ObservedArea
-				finalColor += (lightIntensity * lambert) * observedArea + specular + ambientColor;
-				break;
-			}
-			case LightingMode::ObservedArea:
-			{
-				// Only show the calculated observed area
-				finalColor += ColorRGB{ observedArea, observedArea, observedArea };
-				break;
-			}
-			case LightingMode::Diffuse:
-			{
-				// Calculate the lambert shader and display it on screen together with the observed area
-				finalColor += lightIntensity * LightingUtils::Lambert(m_pDiffuseMap->SampleRGB(pixelInfo.uv)) * observedArea;
-				break;
-			}
-			case LightingMode::Specular:
+			// Get the lights that affect the tile of this pixel
+			const int lightTileIdx{ renderInfo.GetLightTileIdx(pixelIdx % renderInfo.width, pixelIdx / renderInfo.width) };
+			const uint32_t firstLightIdx{ renderInfo.tileLightOffsets[lightTileIdx] };
+			const uint32_t endLightIdx{ renderInfo.tileLightOffsets[lightTileIdx + 1] };
+
+			for (uint32_t i{ firstLightIdx }; i < endLightIdx; ++i)
 			{
-				// Calculate the phong exponent
-				const float specularExp{ specularShininess * m_pGlossinessMap->SampleRGB(pixelInfo.uv).r };
-
-				// Calculate the phong shader
-				const ColorRGB specular{ m_pSpecularMap->SampleRGB(pixelInfo.uv) * LightingUtils::Phong(specularExp, -lightDirection, pixelInfo.viewDirection, useNormal) };
-				// Phong
-				finalColor += specular;
-				break;
-			}
+				const Light& light{ renderInfo.pLights[renderInfo.tileLightIndices[i]] };
+
+				// Calculate the direction towards the light and how much of the light reaches this pixel
+				Vector3 toLight{};
+				float lightFalloff{ LightingUtils::CalculateLightFalloff(light, pixelInfo.worldPosition, toLight) };
+
+				// The light of the shadow casting light can be blocked
+				if (renderInfo.pShadowMap && static_cast<int>(renderInfo.tileLightIndices[i]) == renderInfo.shadow.lightIdx && lightFalloff > 0.0f)
+				{
+					lightFalloff *= LightingUtils::SampleShadowMap(renderInfo.pShadowMap, renderInfo.shadow.lightViewProjectionMatrix,
+						pixelInfo.worldPosition + pixelInfo.normal * renderInfo.shadow.normalOffset);
+				}
+
+				// Calculate the observed area in this pixel
+				const float observedArea{ Vector3::DotClamped(useNormal, toLight) * lightFalloff };
+
+				// Depending on the lighting mode, different shading should be applied
+				switch (renderInfo.lightingMode)
+				{
+				case LightingMode::Combined:
+				{
+					// Calculate the lambert shader
+					const ColorRGB lambert{ LightingUtils::Lambert(m_pDiffuseMap->SampleRGB(pixelInfo.uv, diffuseMip)) };
+					// Calculate the phong exponent
+					const float specularExp{ specularShininess * m_pGlossinessMap->SampleRGB(pixelInfo.uv, glossinessMip).r };
+					// Calculate the phong shader
+					const ColorRGB specular{ m_pSpecularMap->SampleRGB(pixelInfo.uv, specularMip) * LightingUtils::Phong(specularExp, toLight, pixelInfo.viewDirection, useNormal) };
+
+					// Lambert + Phong + ObservedArea
+					finalColor += light.color * ((light.intensity * lambert) * observedArea + specular * lightFalloff);
+					break;
+				}
+				case LightingMode::ObservedArea:
+				{
+					// Only show the calculated observed area
+					finalColor += ColorRGB{ observedArea, observedArea, observedArea };
+					break;
+				}
+				case LightingMode::Diffuse:
+				{
+					// Calculate the lambert shader and display it on screen together with the observed area
+					finalColor += light.color * (light.intensity * LightingUtils::Lambert(m_pDiffuseMap->SampleRGB(pixelInfo.uv, diffuseMip)) * observedArea);
+					break;
+				}
+				case LightingMode::Specular:
+				{
+					// Calculate the phong exponent
+					const float specularExp{ specularShininess * m_pGlossinessMap->SampleRGB(pixelInfo.uv, glossinessMip).r };
+
+					// Calculate the phong shader
+					const ColorRGB specular{ m_pSpecularMap->SampleRGB(pixelInfo.uv, specularMip) * LightingUtils::Phong(specularExp, toLight, pixelInfo.viewDirection, useNormal) };
+					// Phong
+					finalColor += light.color * specular * lightFalloff;
+					break;
+				}
+				}
 			}
+
+			// The ambient color is added once
+			if (renderInfo.lightingMode == LightingMode::Combined) finalColor += ambientColor;
 		}
 
 		//Update Color in Buffer
-		finalColor.MaxToOne();
-
-		renderInfo.pBackBufferPixels[pixelIdx] = SDL_MapRGB(renderInfo.pBackBuffer->format,
-			static_cast<uint8_t>(finalColor.r * 255),
-			static_cast<uint8_t>(finalColor.g * 255),
-			static_cast<uint8_t>(finalColor.b * 255));
+		ColorUtils::WriteColor(renderInfo, pixelIdx, finalColor, sampleMask);
 	}
 
 	Vector3 Mesh::CalculateNormalFromMap(const Vertex_Out& pixelInfo) const
 	{
+		// A baked object space normal only has to be rotated to world space
+		if (m_pObjectSpaceNormalMap)
+		{
+			const int mip{ m_pObjectSpaceNormalMap->CalculateMip(pixelInfo.uvDdx, pixelInfo.uvDdy) };
+			const ColorRGB objectSpaceNormal{ 2.0f * m_pObjectSpaceNormalMap->SampleRGB(pixelInfo.uv, mip) - ColorRGB{ 1.0f, 1.0f, 1.0f } };
+			return m_WorldMatrix.TransformVector(objectSpaceNormal.r, objectSpaceNormal.g, objectSpaceNormal.b);
+		}
+
 		// Calculate the binormal in this pixel
 		const Vector3 binormal{ Vector3::Cross(pixelInfo.normal, pixelInfo.tangent) };
 
 		// Create a matrix using the tangent, normal and binormal
 		const Matrix tangentSpaceAxis{ pixelInfo.tangent, binormal, pixelInfo.normal, Vector3::Zero };
 
+		// Transform the normal map value using the calculated matrix of this pixel
+		return tangentSpaceAxis.TransformVector(SampleTangentSpaceNormal(pixelInfo.uv, m_pNormalMap->CalculateMip(pixelInfo.uvDdx, pixelInfo.uvDdy)));
+	}
+
+	Vector3 Mesh::SampleTangentSpaceNormal(const Vector2& uv, int mip) const
+	{
 		// Sample a color from the normal map and clamp it between -1 and 1
-		const ColorRGB currentNormalMap{ 2.0f * m_pNormalMap->SampleRGB(pixelInfo.uv) - ColorRGB{ 1.0f, 1.0f, 1.0f } };
+		const ColorRGB currentNormalMap{ 2.0f * m_pNormalMap->SampleRGB(uv, mip) - ColorRGB{ 1.0f, 1.0f, 1.0f } };
 
 		// Make a vector3 of the colorRGB object
-		const Vector3 normalMapSample{ currentNormalMap.r, currentNormalMap.g, currentNormalMap.b };
+		Vector3 normalMapSample{ currentNormalMap.r, currentNormalMap.g, currentNormalMap.b };
 
-		// Transform the normal map value using the calculated matrix of this pixel
-		return tangentSpaceAxis.TransformVector(normalMapSample);
+		// Two channel normal maps only store x and y, so reconstruct z
+		if (m_pNormalMap->IsTwoChannel())
+		{
+			normalMapSample.z = sqrtf(Saturate(1.0f - normalMapSample.x * normalMapSample.x - normalMapSample.y * normalMapSample.y));
+		}
+
+		return normalMapSample;
+	}
+
+	void Mesh::BakeObjectSpaceNormalMap(ID3D11Device* pDevice)
+	{
+		if (!m_pNormalMap || !m_pNormalMap->LoadCPUData()) return;
+
+		// The baked normal map has the same resolution as the tangent space normal map
+		const int width{ m_pNormalMap->GetWidth() };
+		const int height{ m_pNormalMap->GetHeight() };
+		const Vector2 textureSize{ static_cast<float>(width), static_cast<float>(height) };
+
+		std::vector<Vector3> objectSpaceNormals(static_cast<size_t>(width) * height);
+		std::vector<bool> isTexelCovered(objectSpaceNormals.size());
+
+		// Rasterize every triangle in texture space
+		for (size_t i{}; i + 2 < m_Indices.size(); i += 3)
+		{
+			const Vertex& v0{ m_Vertices[m_Indices[i]] };
+			const Vertex& v1{ m_Vertices[m_Indices[i + 1]] };
+			const Vertex& v2{ m_Vertices[m_Indices[i + 2]] };
+
+			// Calculate the positions of the vertices in texel space
+			const Vector2 p0{ v0.uv.x * textureSize.x, v0.uv.y * textureSize.y };
+			const Vector2 p1{ v1.uv.x * textureSize.x, v1.uv.y * textureSize.y };
+			const Vector2 p2{ v2.uv.x * textureSize.x, v2.uv.y * textureSize.y };
+
+			// Skip triangles without an area in texture space
+			const float area{ Vector2::Cross(p1 - p0, p2 - p0) };
+			if (abs(area) < FLT_EPSILON) continue;
+
+			// Calculate the bounding box of the triangle, clamped to the texture
+			const int minX{ std::max(static_cast<int>(std::min({ p0.x, p1.x, p2.x })), 0) };
+			const int minY{ std::max(static_cast<int>(std::min({ p0.y, p1.y, p2.y })), 0) };
+			const int maxX{ std::min(static_cast<int>(std::max({ p0.x, p1.x, p2.x })), width - 1) };
+			const int maxY{ std::min(static_cast<int>(std::max({ p0.y, p1.y, p2.y })), height - 1) };
+
+			for (int y{ minY }; y <= maxY; ++y)
+			{
+				for (int x{ minX }; x <= maxX; ++x)
+				{
+					// The center of the current texel
+					const Vector2 texelCenter{ x + 0.5f, y + 0.5f };
+
+					// Calculate the barycentric weights, dividing by the area makes them positive inside the triangle for both windings
+					const float weightV0{ Vector2::Cross(p2 - p1, texelCenter - p1) / area };
+					const float weightV1{ Vector2::Cross(p0 - p2, texelCenter - p2) / area };
+					const float weightV2{ Vector2::Cross(p1 - p0, texelCenter - p0) / area };
+					if (weightV0 < 0.0f || weightV1 < 0.0f || weightV2 < 0.0f) continue;
+
+					// Interpolate the tangent frame of the mesh at this texel
+					const Vector3 normal{ (v0.normal * weightV0 + v1.normal * weightV1 + v2.normal * weightV2).Normalized() };
+					const Vector3 tangent{ (v0.tangent * weightV0 + v1.tangent * weightV1 + v2.tangent * weightV2).Normalized() };
+					const Vector3 binormal{ Vector3::Cross(normal, tangent) };
+
+					// Transform the tangent space normal to object space
+					const Vector3 tangentSpaceNormal{ SampleTangentSpaceNormal({ texelCenter.x / textureSize.x, texelCenter.y / textureSize.y }, 0) };
+
+					const int texelIdx{ x + y * width };
+					objectSpaceNormals[texelIdx] = (tangent * tangentSpaceNormal.x + binormal * tangentSpaceNormal.y + normal * tangentSpaceNormal.z).Normalized();
+					isTexelCovered[texelIdx] = true;
+				}
+			}
+		}
+
+		// Grow the covered texels a few texels outwards so filtering doesn't pull in empty texels at uv seams
+		constexpr int nrDilationPasses{ 4 };
+		for (int pass{}; pass < nrDilationPasses; ++pass)
+		{
+			const std::vector<bool> wasTexelCovered{ isTexelCovered };
+
+			for (int y{}; y < height; ++y)
+			{
+				for (int x{}; x < width; ++x)
+				{
+					const int texelIdx{ x + y * width };
+					if (wasTexelCovered[texelIdx]) continue;
+
+					// Average the covered neighbours of this texel
+					Vector3 neighbourSum{};
+					if (x > 0 && wasTexelCovered[texelIdx - 1]) neighbourSum += objectSpaceNormals[texelIdx - 1];
+					if (x < width - 1 && wasTexelCovered[texelIdx + 1]) neighbourSum += objectSpaceNormals[texelIdx + 1];
+					if (y > 0 && wasTexelCovered[texelIdx - width]) neighbourSum += objectSpaceNormals[texelIdx - width];
+					if (y < height - 1 && wasTexelCovered[texelIdx + width]) neighbourSum += objectSpaceNormals[texelIdx + width];
+
+					if (neighbourSum.SqrMagnitude() < FLT_EPSILON) continue;
+
+					objectSpaceNormals[texelIdx] = neighbourSum.Normalized();
+					isTexelCovered[texelIdx] = true;
+				}
+			}
+		}
+
+		// Encode the normals from [-1, 1] to RGBA32 texels
+		std::vector<uint32_t> texels(objectSpaceNormals.size());
+		for (size_t i{}; i < texels.size(); ++i)
+		{
+			const Vector3& normal{ objectSpaceNormals[i] };
+
+			const uint32_t r{ static_cast<uint32_t>((normal.x * 0.5f + 0.5f) * 255.0f + 0.5f) };
+			const uint32_t g{ static_cast<uint32_t>((normal.y * 0.5f + 0.5f) * 255.0f + 0.5f) };
+			const uint32_t b{ static_cast<uint32_t>((normal.z * 0.5f + 0.5f) * 255.0f + 0.5f) };
+
+			texels[i] = r | (g << 8) | (b << 16) | (0xFFu << 24);
+		}
+
+		// Use the baked normal map on both rasterizers
+		SetTexture(Texture::CreateFromTexels(pDevice, width, height, texels, Texture::TextureType::ObjectSpaceNormal));
+	}
+
+	bool Mesh::HasUniqueTextureCoordinates() const
+	{
+		// The first index of every triangle with an area in texture space
+		std::vector<size_t> triangles{};
+		triangles.reserve(m_Indices.size() / 3);
+
+		// The bounding box of the texture coordinates of the mesh
+		Vector2 minUV{ FLT_MAX, FLT_MAX };
+		Vector2 maxUV{ -FLT_MAX, -FLT_MAX };
+
+		for (size_t i{}; i + 2 < m_Indices.size(); i += 3)
+		{
+			const Vector2& uv0{ m_Vertices[m_Indices[i]].uv };
+			const Vector2& uv1{ m_Vertices[m_Indices[i + 1]].uv };
+			const Vector2& uv2{ m_Vertices[m_Indices[i + 2]].uv };
+
+			// Triangles without an area don't cover any texels
+			if (abs(Vector2::Cross(uv1 - uv0, uv2 - uv0)) < FLT_EPSILON * FLT_EPSILON) continue;
+
+			triangles.push_back(i);
+			minUV = Vector2::Min(minUV, Vector2::Min(uv0, Vector2::Min(uv1, uv2)));
+			maxUV = Vector2::Max(maxUV, Vector2::Max(uv0, Vector2::Max(uv1, uv2)));
+		}
+
+		if (triangles.size() < 2) return true;
+
+		// Sort the triangles into a grid over the texture coordinates so only triangles in the same cell are compared
+		constexpr int gridSize{ 64 };
+		const Vector2 uvRange{ std::max(maxUV.x - minUV.x, FLT_EPSILON), std::max(maxUV.y - minUV.y, FLT_EPSILON) };
+		const auto toCell = [&](float uv, float minValue, float range)
+			{
+				return std::clamp(static_cast<int>((uv - minValue) / range * gridSize), 0, gridSize - 1);
+			};
+
+		std::vector<std::vector<size_t>> cells(gridSize * gridSize);
+		for (const size_t triangleIdx : triangles)
+		{
+			const Vector2& uv0{ m_Vertices[m_Indices[triangleIdx]].uv };
+			const Vector2& uv1{ m_Vertices[m_Indices[triangleIdx + 1]].uv };
+			const Vector2& uv2{ m_Vertices[m_Indices[triangleIdx + 2]].uv };
+
+			const int minX{ toCell(std::min({ uv0.x, uv1.x, uv2.x }), minUV.x, uvRange.x) };
+			const int minY{ toCell(std::min({ uv0.y, uv1.y, uv2.y }), minUV.y, uvRange.y) };
+			const int maxX{ toCell(std::max({ uv0.x, uv1.x, uv2.x }), minUV.x, uvRange.x) };
+			const int maxY{ toCell(std::max({ uv0.y, uv1.y, uv2.y }), minUV.y, uvRange.y) };
+
+			for (int y{ minY }; y <= maxY; ++y)
+			{
+				for (int x{ minX }; x <= maxX; ++x)
+				{
+					cells[x + y * gridSize].push_back(triangleIdx);
+				}
+			}
+		}
+
+		// Triangles that only touch, or overlap by less than this in texture space, don't share any texels
+		constexpr float maxTouchingOverlap{ 1e-4f };
+
+		// Two triangles are separated when the projections on one of their edge normals don't overlap (separating axis theorem)
+		const auto areSeparated = [&](size_t firstIdx, size_t secondIdx)
+			{
+				const Vector2 corners[2][3]
+				{
+					{ m_Vertices[m_Indices[firstIdx]].uv, m_Vertices[m_Indices[firstIdx + 1]].uv, m_Vertices[m_Indices[firstIdx + 2]].uv },
+					{ m_Vertices[m_Indices[secondIdx]].uv, m_Vertices[m_Indices[secondIdx + 1]].uv, m_Vertices[m_Indices[secondIdx + 2]].uv }
+				};
+
+				for (int triangle{}; triangle < 2; ++triangle)
+				{
+					for (int edge{}; edge < 3; ++edge)
+					{
+						const Vector2 edgeVector{ corners[triangle][(edge + 1) % 3] - corners[triangle][edge] };
+						const Vector2 axis{ Vector2{ edgeVector.y, -edgeVector.x }.Normalized() };
+
+						float minProjections[2]{ FLT_MAX, FLT_MAX };
+						float maxProjections[2]{ -FLT_MAX, -FLT_MAX };
+						for (int projected{}; projected < 2; ++projected)
+						{
+							for (const Vector2& corner : corners[projected])
+							{
+								const float projection{ Vector2::Dot(corner, axis) };
+								minProjections[projected] = std::min(minProjections[projected], projection);
+								maxProjections[projected] = std::max(maxProjections[projected], projection);
+							}
+						}
+
+						const float overlap{ std::min(maxProjections[0], maxProjections[1]) - std::max(minProjections[0], minProjections[1]) };
+						if (overlap < maxTouchingOverlap) return true;
+					}
+				}
+				return false;
+			};
+
+		for (const std::vector<size_t>& cell : cells)
+		{
+			for (size_t first{}; first < cell.size(); ++first)
+			{
+				for (size_t second{ first + 1 }; second < cell.size(); ++second)
+				{
+					// Neighbouring triangles share the texels on their edge, so only triangles that share no uv are checked
+					if (ShareTextureCoordinate(cell[first], cell[second])) continue;
+
+					if (!areSeparated(cell[first], cell[second])) return false;
+				}
+			}
+		}
+		return true;
+	}
+
+	bool Mesh::ShareTextureCoordinate(size_t firstIdx, size_t secondIdx) const
+	{
+		for (size_t i{}; i < 3; ++i)
+		{
+			const Vector2& uv{ m_Vertices[m_Indices[firstIdx + i]].uv };
+
+			for (size_t j{}; j < 3; ++j)
+			{
+				const Vector2& otherUV{ m_Vertices[m_Indices[secondIdx + j]].uv };
+				if (uv.x == otherUV.x && uv.y == otherUV.y) return true;
+			}
+		}
+		return false;
 	}
 
 	void Mesh::SetCullMode(CullMode cullMode)
@@ -787,6 +1853,14 @@ namespace dae
 			break;
 		case dae::Texture::TextureType::Normal:
 			m_pNormalMap = pTexture;
+
+			// A previously baked normal map belongs to the old normal map
+			delete m_pObjectSpaceNormalMap;
+			m_pObjectSpaceNormalMap = nullptr;
+			break;
+		case dae::Texture::TextureType::ObjectSpaceNormal:
+			delete m_pObjectSpaceNormalMap;
+			m_pObjectSpaceNormalMap = pTexture;
 			break;
 		case dae::Texture::TextureType::Specular:
 			m_pSpecularMap = pTexture;
@@ -799,6 +1873,18 @@ namespace dae
 		m_pMaterial->SetTexture(pTexture);
 	}
 
+	void Mesh::GetBoundingSphere(Vector3& center, float& radius) const
+	{
+		// The meshes are only rotated and moved, so the radius doesn't change
+		center = m_WorldMatrix.TransformPoint(m_BoundingCenter);
+		radius = m_BoundingRadius;
+	}
+
+	void Mesh::SetLights(const std::vector<Light>& lights) const
+	{
+		m_pMaterial->SetLights(lights);
+	}
+
 	bool Mesh::IsVisible() const
 	{
 		return m_IsVisible;
@@ -821,6 +1907,11 @@ namespace dae
 		m_pMaterial->SetRasterizerState(pRasterizerState);
 	}
 
+	void Mesh::SetDepthStencilState(ID3D11DepthStencilState* pDepthStencilState) const
+	{
+		m_pMaterial->SetDepthStencilState(pDepthStencilState);
+	}
+
 	void Mesh::SetVisibility(bool isVisible)
 	{
 		m_IsVisible = isVisible;
@@ -5,7 +5,9 @@ namespace dae
 {
 	class Material;
 	class Texture;
+	class TextureRegistry;
 	class Camera;
+	struct ShadingBatch;
 
 	class Mesh final
 	{
@@ -24,36 +26,71 @@ namespace dae
 		const Matrix& GetWorldMatrix() const;
 		void SetCullMode(CullMode cullMode);
 		void SetTexture(Texture* pTexture);
+		void SetLights(const std::vector<Light>& lights) const;
+		// Calculates a sphere in world space that contains the whole mesh
+		void GetBoundingSphere(Vector3& center, float& radius) const;
+		// Converts the tangent space normal map to an object space normal map using the tangent frame of this mesh
+		// The mesh has to be rigid, the baked normals only have to be rotated by the world matrix during rendering
+		// A texel can only hold one object space normal, so only meshes with unique texture coordinates can be baked
+		void BakeObjectSpaceNormalMap(ID3D11Device* pDevice);
+		// Checks that no two triangles, except neighbours, cover the same part of the texture (overlapping or mirrored uvs)
+		bool HasUniqueTextureCoordinates() const;
 
 		// Software Rasterizer
 		void SoftwareRender(Camera* pCamera, const SoftwareRenderInfo& renderInfo);
+		void MakeTexturesResident(TextureRegistry* pTextureRegistry) const;
+		bool IsTransparent() const;
+		// Renders the depth of the mesh seen from the light into the shadow map without interpolating any attributes
+		void RenderShadowMap(const Matrix& lightViewProjectionMatrix, float* pShadowMap) const;
 
 		// DirectX Rasterizer
 		void HardwareRender(ID3D11DeviceContext* pDeviceContext) const;
+		void HardwareRenderShadowMap(ID3D11DeviceContext* pDeviceContext) const;
+		void HardwareRenderReducedResolution(ID3D11DeviceContext* pDeviceContext) const;
+		void SetShadow(const ShadowInfo& shadow, ID3D11ShaderResourceView* pShadowMap) const;
 		void UpdateMatrices(const Matrix& viewProjectionMatrix, const Matrix& inverseViewMatrix) const;
 		void SetSamplerState(ID3D11SamplerState* pSampleState) const;
 		void SetRasterizerState(ID3D11RasterizerState* pRasterizerState) const;
+		void SetDepthStencilState(ID3D11DepthStencilState* pDepthStencilState) const;
 		void SetVisibility(bool isVisible);
 		bool IsVisible() const;
 	private:
 		void ClipTriangle(std::vector<Vertex_Out>& verticesOut, std::vector<Vector2>& verticesRasterSpace, const std::vector<Vector2>& rasterVertices, const SoftwareRenderInfo& renderInfo, size_t i);
 		void RenderTriangle(const std::vector<Vector2>& rasterVertices, const std::vector<Vertex_Out>& verticesOut, size_t curVertexIdx, bool swapVertices, const SoftwareRenderInfo& renderInfo) const;
-		void PixelShading(int pixelIdx, const Vertex_Out& pixelInfo, const SoftwareRenderInfo& renderInfo) const;
+		void InterpolatePixel(const Vertex_Out& v0Out, const Vertex_Out& v1Out, const Vertex_Out& v2Out, const float* pWeights, const SoftwareRenderInfo& renderInfo, Vertex_Out& pixelInfo, bool isHelperPixel) const;
+		void PixelShading(int pixelIdx, uint32_t sampleMask, const Vertex_Out& pixelInfo, const SoftwareRenderInfo& renderInfo) const;
+		void AccumulateTransparency(int pixelIdx, const ColorRGB& color, float viewDepth, const SoftwareRenderInfo& renderInfo) const;
+		void ShadeBatch(ShadingBatch& batch, const SoftwareRenderInfo& renderInfo) const;
+		bool ReuseCachedColor(int px, int py, uint32_t triangleId, uint32_t sampleMask, const Vertex_Out& pixelInfo, const SoftwareRenderInfo& renderInfo) const;
 		Vector3 CalculateNormalFromMap(const Vertex_Out& pixelInfo) const;
+		Vector3 SampleTangentSpaceNormal(const Vector2& uv, int mip) const;
+		// Checks if two triangles, given by their first index, have a vertex at the same uv
+		bool ShareTextureCoordinate(size_t firstIdx, size_t secondIdx) const;
+		void DrawIndexed(ID3D11DeviceContext* pDeviceContext, ID3DX11EffectTechnique* pTechnique) const;
 
 		// Shared
 		Matrix m_WorldMatrix{ Vector3::UnitX, Vector3::UnitY, Vector3::UnitZ, Vector3::Zero };
 		CullMode m_CullMode{};
+		// The bounding sphere in object space
+		Vector3 m_BoundingCenter{};
+		float m_BoundingRadius{};
 
 		// Software Rasterizer
 		std::vector<Vertex> m_Vertices{};
 		std::vector<uint32_t> m_UseIndices{};
+		// The index of the original triangle of every triangle in m_UseIndices
+		std::vector<uint32_t> m_UseTriangleIds{};
 		std::vector<uint32_t> m_Indices{};
 		PrimitiveTopology m_PrimitiveTopology{ PrimitiveTopology::TriangleList };
 		bool m_IsTransparent{};
+		// Identifies the triangles of this mesh in the reprojection cache
+		uint32_t m_Id{};
+		// The world matrix of the last frame that was rendered in software
+		Matrix m_PreviousWorldMatrix{ Vector3::UnitX, Vector3::UnitY, Vector3::UnitZ, Vector3::Zero };
 
 		Texture* m_pDiffuseMap{};
 		Texture* m_pNormalMap{};
+		Texture* m_pObjectSpaceNormalMap{};
 		Texture* m_pGlossinessMap{};
 		Texture* m_pSpecularMap{};
 
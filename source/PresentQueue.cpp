@@ -0,0 +1,234 @@
+#include "pch.h"
+#include "PresentQueue.h"
+#include <ppl.h> // Parallel Stuff
+
+namespace dae
+{
+	PresentQueue::PresentQueue(SDL_Window* pWindow, int queueDepth)
+		: m_pWindow{ pWindow }
+		, m_QueueDepth{ std::clamp(queueDepth, 1, maxQueueDepth) }
+	{
+		SDL_GetWindowSize(pWindow, &m_WindowWidth, &m_WindowHeight);
+
+		m_pFrontBuffer = SDL_GetWindowSurface(pWindow);
+
+		// Use the format of the window if the renderer can write it, then the blit doesn't have to convert the pixels
+		const Uint32 frontBufferFormat{ m_pFrontBuffer->format->format };
+		if (frontBufferFormat == SDL_PIXELFORMAT_RGB888 || frontBufferFormat == SDL_PIXELFORMAT_ARGB8888 ||
+			frontBufferFormat == SDL_PIXELFORMAT_BGR888 || frontBufferFormat == SDL_PIXELFORMAT_ABGR8888)
+		{
+			m_PixelFormat = frontBufferFormat;
+		}
+
+		m_pUpscaleBuffer = SDL_CreateRGBSurfaceWithFormat(0, m_WindowWidth, m_WindowHeight, 32, m_PixelFormat);
+		SDL_SetSurfaceBlendMode(m_pUpscaleBuffer, SDL_BLENDMODE_NONE);
+
+		m_PresentThread = std::thread{ &PresentQueue::PresentLoop, this };
+	}
+
+	PresentQueue::~PresentQueue()
+	{
+		// Show the frames that are still queued and stop the present thread
+		Flush();
+		{
+			std::lock_guard lock{ m_Mutex };
+			m_IsStopping = true;
+		}
+		m_Condition.notify_all();
+		m_PresentThread.join();
+
+		for (SDL_Surface* pBackBuffer : m_pBackBuffers)
+		{
+			SDL_FreeSurface(pBackBuffer);
+		}
+		SDL_FreeSurface(m_pUpscaleBuffer);
+	}
+
+	SDL_Surface* PresentQueue::AcquireBackBuffer(int width, int height)
+	{
+		int backBufferIdx{};
+		{
+			// Wait until the queue has room for another frame, this keeps the render thread at most the queue depth frames ahead of the window
+			// The frames that the present thread finished in the meantime are shown
+			std::unique_lock lock{ m_Mutex };
+			while (true)
+			{
+				if (m_pFinishedFrame) ShowFinishedFrame(lock);
+				else if (static_cast<int>(m_Queue.size()) < m_QueueDepth) break;
+				else m_Condition.wait(lock);
+			}
+
+			// The ring holds one more back buffer than the queue can, so one of them is free
+			while (m_IsBackBufferInUse[backBufferIdx]) ++backBufferIdx;
+			m_IsBackBufferInUse[backBufferIdx] = true;
+		}
+
+		// Recreate the back buffer when the render resolution changed since it was used
+		SDL_Surface*& pBackBuffer{ m_pBackBuffers[backBufferIdx] };
+		if (!pBackBuffer || pBackBuffer->w != width || pBackBuffer->h != height)
+		{
+			SDL_FreeSurface(pBackBuffer);
+			pBackBuffer = SDL_CreateRGBSurfaceWithFormat(0, width, height, 32, m_PixelFormat);
+
+			// The renderer leaves the alpha channel at 0 and surfaces with alpha are blended by default, so copy the frames as they are
+			SDL_SetSurfaceBlendMode(pBackBuffer, SDL_BLENDMODE_NONE);
+		}
+
+		return pBackBuffer;
+	}
+
+	void PresentQueue::Present(SDL_Surface* pBackBuffer)
+	{
+		{
+			std::lock_guard lock{ m_Mutex };
+			m_Queue.push_back(pBackBuffer);
+		}
+		m_Condition.notify_all();
+	}
+
+	void PresentQueue::Flush()
+	{
+		std::unique_lock lock{ m_Mutex };
+		while (!m_Queue.empty())
+		{
+			if (m_pFinishedFrame) ShowFinishedFrame(lock);
+			else m_Condition.wait(lock);
+		}
+	}
+
+	void PresentQueue::SetQueueDepth(int queueDepth)
+	{
+		{
+			std::lock_guard lock{ m_Mutex };
+			m_QueueDepth = std::clamp(queueDepth, 1, maxQueueDepth);
+		}
+		m_Condition.notify_all();
+	}
+
+	int PresentQueue::GetQueueDepth() const
+	{
+		std::lock_guard lock{ m_Mutex };
+		return m_QueueDepth;
+	}
+
+	void PresentQueue::PresentLoop()
+	{
+		while (true)
+		{
+			SDL_Surface* pBackBuffer{};
+			{
+				// Wait for a queued frame, the previous frame has to be shown first since it can use the upscale buffer
+				std::unique_lock lock{ m_Mutex };
+				m_Condition.wait(lock, [&]() { return (m_IsStopping && m_Queue.empty()) || (!m_Queue.empty() && !m_pFinishedFrame); });
+
+				// Only stop when every frame is shown
+				if (m_Queue.empty()) return;
+
+				pBackBuffer = m_Queue.front();
+			}
+
+			// Scale the frame up to the size of the window
+			SDL_Surface* pFinishedFrame{ pBackBuffer };
+			if (pBackBuffer->w != m_WindowWidth || pBackBuffer->h != m_WindowHeight)
+			{
+				UpscaleBackBuffer(pBackBuffer);
+				pFinishedFrame = m_pUpscaleBuffer;
+			}
+
+			// The window can only be updated on the thread that created it, so the render thread shows the frame
+			{
+				std::lock_guard lock{ m_Mutex };
+				m_pFinishedFrame = pFinishedFrame;
+			}
+			m_Condition.notify_all();
+		}
+	}
+
+	void PresentQueue::ShowFinishedFrame(std::unique_lock<std::mutex>& lock)
+	{
+		SDL_Surface* pFinishedFrame{ m_pFinishedFrame };
+		SDL_Surface* pBackBuffer{ m_Queue.front() };
+
+		// The present thread doesn't touch the frame until it is shown, so the copy doesn't need the lock
+		lock.unlock();
+		SDL_BlitSurface(pFinishedFrame, 0, m_pFrontBuffer, 0);
+		SDL_UpdateWindowSurface(m_pWindow);
+		lock.lock();
+
+		// The back buffer can be rendered to again
+		m_pFinishedFrame = nullptr;
+		m_Queue.pop_front();
+
+		const int backBufferIdx{ static_cast<int>(std::find(std::begin(m_pBackBuffers), std::end(m_pBackBuffers), pBackBuffer) - std::begin(m_pBackBuffers)) };
+		m_IsBackBufferInUse[backBufferIdx] = false;
+
+		m_Condition.notify_all();
+	}
+
+	void PresentQueue::UpscaleBackBuffer(const SDL_Surface* pBackBuffer) const
+	{
+		// The weights of the bilinear filter are in the range [0, 256] so two channels can be blended in one multiplication
+		constexpr uint32_t weightRange{ 256 };
+		constexpr uint32_t redBlueMask{ 0xFF00FF };
+		constexpr uint32_t greenMask{ 0x00FF00 };
+
+		// Blends two pixels, the red and blue channel are blended together since they can't overflow into each other
+		const auto lerpPixel{ [](uint32_t pixel0, uint32_t pixel1, uint32_t weight)
+			{
+				const uint32_t redBlue{ ((pixel0 & redBlueMask) * (weightRange - weight) + (pixel1 & redBlueMask) * weight) >> 8 };
+				const uint32_t green{ ((pixel0 & greenMask) * (weightRange - weight) + (pixel1 & greenMask) * weight) >> 8 };
+				return (redBlue & redBlueMask) | (green & greenMask);
+			} };
+
+		// Calculates the two source texels and the weight of the second one for a destination pixel
+		const auto calculateTaps{ [](int dstIdx, int dstSize, int srcSize, int& srcIdx0, int& srcIdx1, uint32_t& weight)
+			{
+				// Map the center of the destination pixel to the source buffer
+				const float srcPos{ std::max((dstIdx + 0.5f) * srcSize / dstSize - 0.5f, 0.0f) };
+				srcIdx0 = std::min(static_cast<int>(srcPos), srcSize - 1);
+				srcIdx1 = std::min(srcIdx0 + 1, srcSize - 1);
+				weight = static_cast<uint32_t>((srcPos - srcIdx0) * weightRange);
+			} };
+
+		const int srcWidth{ pBackBuffer->w };
+		const int srcHeight{ pBackBuffer->h };
+
+		// The horizontal taps are the same for every row
+		std::vector<int> srcX0(m_WindowWidth);
+		std::vector<int> srcX1(m_WindowWidth);
+		std::vector<uint32_t> weightsX(m_WindowWidth);
+		for (int x{}; x < m_WindowWidth; ++x)
+		{
+			calculateTaps(x, m_WindowWidth, srcWidth, srcX0[x], srcX1[x], weightsX[x]);
+		}
+
+		const uint32_t* pSrcPixels{ static_cast<const uint32_t*>(pBackBuffer->pixels) };
+		uint32_t* pDstPixels{ static_cast<uint32_t*>(m_pUpscaleBuffer->pixels) };
+		// The rows of the surfaces can be padded
+		const int srcPitch{ pBackBuffer->pitch / static_cast<int>(sizeof(uint32_t)) };
+		const int dstPitch{ m_pUpscaleBuffer->pitch / static_cast<int>(sizeof(uint32_t)) };
+
+		SDL_LockSurface(m_pUpscaleBuffer);
+
+		concurrency::parallel_for(0, m_WindowHeight, [&](int y)
+			{
+				int srcY0{}, srcY1{};
+				uint32_t weightY{};
+				calculateTaps(y, m_WindowHeight, srcHeight, srcY0, srcY1, weightY);
+
+				const uint32_t* pRow0{ pSrcPixels + srcY0 * srcPitch };
+				const uint32_t* pRow1{ pSrcPixels + srcY1 * srcPitch };
+				uint32_t* pDstRow{ pDstPixels + y * dstPitch };
+
+				for (int x{}; x < m_WindowWidth; ++x)
+				{
+					// Blend horizontally in both source rows and then blend the results vertically
+					const uint32_t top{ lerpPixel(pRow0[srcX0[x]], pRow0[srcX1[x]], weightsX[x]) };
+					const uint32_t bottom{ lerpPixel(pRow1[srcX0[x]], pRow1[srcX1[x]], weightsX[x]) };
+					pDstRow[x] = lerpPixel(top, bottom, weightY);
+				}
+			});
+
+		SDL_UnlockSurface(m_pUpscaleBuffer);
+	}
+}
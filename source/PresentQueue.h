@@ -0,0 +1,71 @@
+#pragma once
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+
+namespace dae
+{
+	// Shows the frames of the software rasterizer in the window, lower resolution frames are scaled up on a separate thread while the next frame is rendered
+	// The frames are rendered in a ring of back buffers, the render thread waits for a free back buffer when the queue is full
+	// A frame is shown at most queue depth frames after it was rendered
+	// SDL only allows updating the window on the thread that created it, so the finished frames are copied to the window by the render thread
+	// (in AcquireBackBuffer and Flush), the present thread never touches the window
+	// The back buffers use the pixel format of the window so showing a frame is a plain copy
+	class PresentQueue final
+	{
+	public:
+		PresentQueue(SDL_Window* pWindow, int queueDepth);
+		~PresentQueue();
+
+		PresentQueue(const PresentQueue&) = delete;
+		PresentQueue(PresentQueue&&) noexcept = delete;
+		PresentQueue& operator=(const PresentQueue&) = delete;
+		PresentQueue& operator=(PresentQueue&&) noexcept = delete;
+
+		// Shows the finished frames and waits until a back buffer is no longer queued, then returns it with the given size
+		// The render thread owns the back buffer until it is presented
+		// The rows of the back buffer are never padded
+		SDL_Surface* AcquireBackBuffer(int width, int height);
+		// Queues the acquired back buffer to be shown, it is scaled up when it is smaller than the window
+		void Present(SDL_Surface* pBackBuffer);
+		// Shows every queued frame, has to be called before something else draws to the window
+		void Flush();
+
+		void SetQueueDepth(int queueDepth);
+		int GetQueueDepth() const;
+
+		// The most frames that can wait to be shown, the ring holds one more back buffer for the frame that is being rendered
+		static constexpr int maxQueueDepth{ 3 };
+
+	private:
+		SDL_Window* m_pWindow{};
+		SDL_Surface* m_pFrontBuffer{};
+		int m_WindowWidth{};
+		int m_WindowHeight{};
+		// The pixel format of the back buffers, the format of the window when the renderer can write it
+		Uint32 m_PixelFormat{ SDL_PIXELFORMAT_RGB888 };
+		// The window sized buffer that a lower resolution frame gets scaled up to
+		SDL_Surface* m_pUpscaleBuffer{};
+		// The frame at the front of the queue once the present thread finished it, either the back buffer or the upscale buffer
+		SDL_Surface* m_pFinishedFrame{};
+
+		// The back buffers and if they are acquired or queued
+		SDL_Surface* m_pBackBuffers[maxQueueDepth + 1]{};
+		bool m_IsBackBufferInUse[maxQueueDepth + 1]{};
+
+		// The back buffers that wait to be shown in order, the front one stays in the queue until it is shown
+		std::deque<SDL_Surface*> m_Queue{};
+		int m_QueueDepth{};
+		bool m_IsStopping{};
+
+		mutable std::mutex m_Mutex{};
+		std::condition_variable m_Condition{};
+		std::thread m_PresentThread{};
+
+		void PresentLoop();
+		// Copies the finished frame to the window and releases its back buffer, only called on the render thread with the lock held
+		void ShowFinishedFrame(std::unique_lock<std::mutex>& lock);
+		void UpscaleBackBuffer(const SDL_Surface* pBackBuffer) const;
+	};
+}
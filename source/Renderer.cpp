@@ -5,6 +5,7 @@
 #include "Camera.h"
 #include "Mesh.h"
 #include "Texture.h"
+#include "TextureRegistry.h"
 #include "MaterialShaded.h"
 #include "MaterialTransparent.h"
 
@@ -24,7 +25,14 @@ namespace dae {
 
 		// Create the software rasterizer
 		m_pSoftwareRender = new SoftwareRenderer{ pWindow };
+
+		// Create the texture registry, the CPU-side copies of the textures are only kept within this budget
+		constexpr size_t textureCPUMemoryBudget{ 32 * 1024 * 1024 };
+		m_pTextureRegistry = new TextureRegistry{ m_pHardwareRender->GetDevice(), textureCPUMemoryBudget };
 		
+		// Create the lights of the scene
+		LoadLights();
+
 		// Load all the textures and meshes
 		LoadMeshes();
 
@@ -37,6 +45,9 @@ namespace dae {
 		std::cout << "\t[F9]  Cycle CullMode (BACK / FRONT / NONE)\n";
 		std::cout << "\t[F10] Toggle Uniform ClearColor (ON / OFF)\n";
 		std::cout << "\t[F11] Toggle Print FPS (ON / OFF)\n";
+		std::cout << "\t[6]   Cycle Transparency Resolution (FULL / HALF / QUARTER)\n";
+		std::cout << "\t[R]   Cycle Depth Projection (STANDARD / REVERSED / REVERSED_INFINITE)\n";
+		std::cout << "\t[M]   Toggle MSAA 4x (ON / OFF)\n";
 		std::cout << "\n";
 		std::cout << "\033[32m"; // TEXT COLOR
 		std::cout << "[Key Bindings - HARDWARE]\n";
@@ -48,6 +59,15 @@ namespace dae {
 		std::cout << "\t[F6]  Toggle NormalMap (ON / OFF)\n";
 		std::cout << "\t[F7]  Toggle DepthBuffer Visualization (ON / OFF)\n";
 		std::cout << "\t[F8]  Toggle BoundingBox Visualization (ON / OFF)\n";
+		std::cout << "\t[1]   Cycle Variable Rate Shading (OFF / CONTENT_ADAPTIVE / FOVEATED)\n";
+		std::cout << "\t[2]   Toggle Dynamic Resolution (ON / OFF)\n";
+		std::cout << "\t[3]   Toggle Reprojection Cache (ON / OFF)\n";
+		std::cout << "\t[4]   Toggle Checkerboard Rendering (ON / OFF)\n";
+		std::cout << "\t[5]   Toggle Order Independent Transparency (ON / OFF)\n";
+		std::cout << "\t[7]   Toggle HDR Color Buffer (ON / OFF)\n";
+		std::cout << "\t[8]   Cycle Present Queue Depth (1 / 2 / 3)\n";
+		std::cout << "\t[9]   Cycle Frame Capture (OFF / PPM / QOI / Y4M)\n";
+		std::cout << "\t[0]   Cycle Depth Format (FLOAT32 / UNORM24 / UNORM16)\n";
 		std::cout << "\n";
 		std::cout << "\033[31m";
 		std::cout << "Extra's: FireFX, clipping and multithreading have been added extra to the software rasterizer\n";
@@ -63,8 +83,9 @@ namespace dae {
 
 		for (Texture* pTexture : m_pTextures)
 		{
-			delete pTexture;
+			m_pTextureRegistry->Release(pTexture);
 		}
+		delete m_pTextureRegistry;
 
 		delete m_pSoftwareRender;
 		delete m_pHardwareRender;
@@ -91,18 +112,29 @@ namespace dae {
 
 	void Renderer::Render() const
 	{
+		m_pTextureRegistry->BeginFrame();
+
+		// Both rasterizers use the same shadow map projection
+		const ShadowInfo shadow{ CalculateShadowInfo() };
+
 		switch (m_RenderMode)
 		{
 		case dae::Renderer::RenderMode::Software:
 		{
+			// The software rasterizer samples the CPU-side copies of the textures, so make sure these are loaded
+			for (Mesh* pMesh : m_pMeshes)
+			{
+				if (pMesh->IsVisible()) pMesh->MakeTexturesResident(m_pTextureRegistry);
+			}
+
 			// Render the scene using the software rasterizer
-			m_pSoftwareRender->Render(m_pMeshes, m_pCamera, m_IsBackgroundUniform);
+			m_pSoftwareRender->Render(m_pMeshes, m_Lights, shadow, m_pCamera, m_IsBackgroundUniform);
 			break;
 		}
 		case dae::Renderer::RenderMode::Hardware:
 		{
 			// Render the scene using the hardware rasterizer
-			m_pHardwareRender->Render(m_pMeshes, m_IsBackgroundUniform);
+			m_pHardwareRender->Render(m_pMeshes, shadow, m_pCamera, m_IsBackgroundUniform);
 			break;
 		}
 		}
@@ -113,6 +145,9 @@ namespace dae {
 		// Go to the next render mode
 		m_RenderMode = static_cast<RenderMode>((static_cast<int>(m_RenderMode) + 1) % (static_cast<int>(RenderMode::Hardware) + 1));
 
+		// The present thread of the software rasterizer shouldn't draw over the frames of the hardware rasterizer
+		if (m_RenderMode != RenderMode::Software) m_pSoftwareRender->FlushPresentQueue();
+
 		std::cout << "\033[33m"; // TEXT COLOR
 		std::cout << "**(SHARED) Rasterizer Mode = ";
 		switch (m_RenderMode)
@@ -180,6 +215,69 @@ namespace dae {
 		m_pSoftwareRender->ToggleNormalMap();
 	}
 
+	void Renderer::ToggleShadingRatePolicy() const
+	{
+		if (m_RenderMode != RenderMode::Software) return;
+
+		m_pSoftwareRender->ToggleShadingRatePolicy();
+	}
+
+	void Renderer::ToggleDynamicResolution() const
+	{
+		if (m_RenderMode != RenderMode::Software) return;
+
+		m_pSoftwareRender->ToggleDynamicResolution();
+	}
+
+	void Renderer::ToggleReprojectionCache() const
+	{
+		if (m_RenderMode != RenderMode::Software) return;
+
+		m_pSoftwareRender->ToggleReprojectionCache();
+	}
+
+	void Renderer::ToggleCheckerboard() const
+	{
+		if (m_RenderMode != RenderMode::Software) return;
+
+		m_pSoftwareRender->ToggleCheckerboard();
+	}
+
+	void Renderer::ToggleOrderIndependentTransparency() const
+	{
+		if (m_RenderMode != RenderMode::Software) return;
+
+		m_pSoftwareRender->ToggleOrderIndependentTransparency();
+	}
+
+	void Renderer::ToggleHdrBuffer() const
+	{
+		if (m_RenderMode != RenderMode::Software) return;
+
+		m_pSoftwareRender->ToggleHdrBuffer();
+	}
+
+	void Renderer::CyclePresentQueueDepth() const
+	{
+		if (m_RenderMode != RenderMode::Software) return;
+
+		m_pSoftwareRender->CyclePresentQueueDepth();
+	}
+
+	void Renderer::CycleFrameCapture() const
+	{
+		if (m_RenderMode != RenderMode::Software) return;
+
+		m_pSoftwareRender->CycleFrameCapture();
+	}
+
+	void Renderer::CycleDepthFormat() const
+	{
+		if (m_RenderMode != RenderMode::Software) return;
+
+		m_pSoftwareRender->CycleDepthFormat();
+	}
+
 	void Renderer::ToggleShowingDepthBuffer() const
 	{
 		if (m_RenderMode != RenderMode::Software) return;
@@ -234,6 +332,154 @@ namespace dae {
 		m_pHardwareRender->SetRasterizerState(m_CullMode, m_pMeshes);
 	}
 
+	void Renderer::CycleDepthProjection() const
+	{
+		// Go to the next depth projection
+		const DepthProjection depthProjection{ static_cast<DepthProjection>((static_cast<int>(m_pCamera->GetDepthProjection()) + 1) % (static_cast<int>(DepthProjection::ReversedInfinite) + 1)) };
+
+		std::cout << "\033[33m"; // TEXT COLOR
+		std::cout << "**(SHARED) Depth Projection = ";
+		switch (depthProjection)
+		{
+		case DepthProjection::Standard:
+			std::cout << "STANDARD\n";
+			break;
+		case DepthProjection::Reversed:
+			std::cout << "REVERSED\n";
+			break;
+		case DepthProjection::ReversedInfinite:
+			std::cout << "REVERSED_INFINITE\n";
+			break;
+		}
+
+		m_pCamera->SetDepthProjection(depthProjection);
+		m_pHardwareRender->SetDepthProjection(depthProjection, m_pMeshes);
+	}
+
+	void Renderer::ToggleTransparencyResolution()
+	{
+		std::cout << "\033[33m"; // TEXT COLOR
+		std::cout << "**(SHARED) Transparency Resolution = ";
+
+		// Go to the next transparency resolution
+		switch (m_TransparencyResolution)
+		{
+		case dae::TransparencyResolution::Full:
+			std::cout << "HALF\n";
+			m_TransparencyResolution = TransparencyResolution::Half;
+			break;
+		case dae::TransparencyResolution::Half:
+			std::cout << "QUARTER\n";
+			m_TransparencyResolution = TransparencyResolution::Quarter;
+			break;
+		case dae::TransparencyResolution::Quarter:
+			std::cout << "FULL\n";
+			m_TransparencyResolution = TransparencyResolution::Full;
+			break;
+		}
+
+		m_pSoftwareRender->SetTransparencyResolution(m_TransparencyResolution);
+		m_pHardwareRender->SetTransparencyResolution(m_TransparencyResolution);
+	}
+
+	void Renderer::ToggleMultisampling()
+	{
+		m_IsMultisamplingEnabled = !m_IsMultisamplingEnabled;
+
+		std::cout << "\033[33m"; // TEXT COLOR
+		std::cout << "**(SHARED) MSAA 4x ";
+		if (m_IsMultisamplingEnabled)
+		{
+			std::cout << "ON\n";
+		}
+		else
+		{
+			std::cout << "OFF\n";
+		}
+
+		m_pSoftwareRender->SetMultisampling(m_IsMultisamplingEnabled);
+		m_pHardwareRender->SetMultisampling(m_IsMultisamplingEnabled);
+	}
+
+	void Renderer::LoadLights()
+	{
+		// The sun
+		Light sun{};
+		sun.type = LightType::Directional;
+		sun.direction = { 0.577f, -0.577f, 0.577f };
+		sun.intensity = 7.0f;
+		m_Lights.push_back(sun);
+
+		// Two colored point lights on opposite corners of the vehicle, they only cover part of the screen so the light culling has work to do
+		Light redLight{};
+		redLight.type = LightType::Point;
+		redLight.position = { -12.0f, 4.0f, 38.0f };
+		redLight.color = { 1.0f, 0.25f, 0.1f };
+		redLight.intensity = 10.0f;
+		redLight.range = 25.0f;
+		m_Lights.push_back(redLight);
+
+		Light blueLight{};
+		blueLight.type = LightType::Point;
+		blueLight.position = { 14.0f, -2.0f, 62.0f };
+		blueLight.color = { 0.1f, 0.3f, 1.0f };
+		blueLight.intensity = 10.0f;
+		blueLight.range = 25.0f;
+		m_Lights.push_back(blueLight);
+
+		// A spot light shining down on the roof of the vehicle
+		Light spotLight{};
+		spotLight.type = LightType::Spot;
+		spotLight.position = { 0.0f, 25.0f, 50.0f };
+		spotLight.direction = { 0.0f, -1.0f, 0.0f };
+		spotLight.color = { 1.0f, 0.9f, 0.7f };
+		spotLight.intensity = 8.0f;
+		spotLight.range = 40.0f;
+		spotLight.innerConeCos = 0.95f;
+		spotLight.outerConeCos = 0.85f;
+		m_Lights.push_back(spotLight);
+	}
+
+	ShadowInfo Renderer::CalculateShadowInfo() const
+	{
+		ShadowInfo shadow{};
+
+		// The first directional light casts the shadows
+		const auto lightIt{ std::find_if(m_Lights.begin(), m_Lights.end(), [](const Light& light) { return light.type == LightType::Directional; }) };
+		if (lightIt == m_Lights.end()) return shadow;
+
+		// Calculate a sphere around all the meshes that cast shadows
+		Vector3 minPosition{ FLT_MAX, FLT_MAX, FLT_MAX };
+		Vector3 maxPosition{ -FLT_MAX, -FLT_MAX, -FLT_MAX };
+		for (const Mesh* pMesh : m_pMeshes)
+		{
+			if (!pMesh->IsVisible() || pMesh->IsTransparent()) continue;
+
+			Vector3 center{};
+			float radius{};
+			pMesh->GetBoundingSphere(center, radius);
+			minPosition = { std::min(minPosition.x, center.x - radius), std::min(minPosition.y, center.y - radius), std::min(minPosition.z, center.z - radius) };
+			maxPosition = { std::max(maxPosition.x, center.x + radius), std::max(maxPosition.y, center.y + radius), std::max(maxPosition.z, center.z + radius) };
+		}
+		if (minPosition.x > maxPosition.x) return shadow;
+
+		const Vector3 sceneCenter{ (minPosition + maxPosition) / 2.0f };
+		const float sceneRadius{ (maxPosition - minPosition).Magnitude() / 2.0f };
+
+		// Look at the scene from the direction of the light with an orthographic projection that fits around the sphere
+		// The sphere doesn't change when the meshes rotate, so the shadow map texels stay in place
+		const Vector3 lightDirection{ lightIt->direction.Normalized() };
+		const Vector3 up{ abs(lightDirection.y) > 0.99f ? Vector3::UnitZ : Vector3::UnitY };
+		const Matrix lightViewMatrix{ Matrix::CreateLookAtLH(sceneCenter - lightDirection * sceneRadius, lightDirection, up) };
+		const Matrix lightProjectionMatrix{ Matrix::CreateOrthographicLH(2.0f * sceneRadius, 2.0f * sceneRadius, 0.0f, 2.0f * sceneRadius) };
+
+		shadow.lightIdx = static_cast<int>(lightIt - m_Lights.begin());
+		shadow.lightViewProjectionMatrix = lightViewMatrix * lightProjectionMatrix;
+		// Move the lookups one and a half texel along the normal
+		shadow.normalOffset = 1.5f * 2.0f * sceneRadius / SHADOW_MAP_SIZE;
+		return shadow;
+	}
+
 	void Renderer::LoadMeshes()
 	{
 		// Retrieve the DirectX device from the hardware renderer
@@ -245,13 +491,13 @@ namespace dae {
 		MaterialShaded* vehicleMaterial{ new MaterialShaded{ pDirectXDevice, L"Resources/Vehicle.fx" } };
 
 		// Load all the textures needed for the vehicle
-		Texture* pVehicleDiffuseTexture{ Texture::LoadFromFile(pDirectXDevice, "Resources/vehicle_diffuse.png", Texture::TextureType::Diffuse) };
+		Texture* pVehicleDiffuseTexture{ m_pTextureRegistry->Acquire("Resources/vehicle_diffuse.png", Texture::TextureType::Diffuse) };
 		m_pTextures.push_back(pVehicleDiffuseTexture);
-		Texture* pNormalTexture{ Texture::LoadFromFile(pDirectXDevice, "Resources/vehicle_normal.png", Texture::TextureType::Normal) };
+		Texture* pNormalTexture{ m_pTextureRegistry->Acquire("Resources/vehicle_normal.png", Texture::TextureType::Normal) };
 		m_pTextures.push_back(pNormalTexture);
-		Texture* pSpecularTexture{ Texture::LoadFromFile(pDirectXDevice, "Resources/vehicle_specular.png", Texture::TextureType::Specular) };
+		Texture* pSpecularTexture{ m_pTextureRegistry->Acquire("Resources/vehicle_specular.png", Texture::TextureType::Specular) };
 		m_pTextures.push_back(pSpecularTexture);
-		Texture* pGlossinessTexture{ Texture::LoadFromFile(pDirectXDevice, "Resources/vehicle_gloss.png", Texture::TextureType::Glossiness) };
+		Texture* pGlossinessTexture{ m_pTextureRegistry->Acquire("Resources/vehicle_gloss.png", Texture::TextureType::Glossiness) };
 		m_pTextures.push_back(pGlossinessTexture);
 
 		// Create the vehicle mesh and add it to the list of meshes
@@ -261,6 +507,15 @@ namespace dae {
 		pVehicle->SetTexture(pNormalTexture);
 		pVehicle->SetTexture(pSpecularTexture);
 		pVehicle->SetTexture(pGlossinessTexture);
+		// The vehicle is rigid, so its normal map can be converted to object space once when every texel belongs to one triangle
+		if (pVehicle->HasUniqueTextureCoordinates())
+		{
+			pVehicle->BakeObjectSpaceNormalMap(pDirectXDevice);
+		}
+		else
+		{
+			std::cout << "Not baking the normal map of the vehicle to object space, the uvs of the mesh overlap\n";
+		}
 		m_pMeshes.push_back(pVehicle);
 
 
@@ -269,7 +524,7 @@ namespace dae {
 		MaterialTransparent* transparentMaterial{ new MaterialTransparent{ pDirectXDevice, L"Resources/Fire.fx" } };
 
 		// Load the texture needed for the fire
-		Texture* pFireDiffuseTexture{ Texture::LoadFromFile(pDirectXDevice, "Resources/fireFX_diffuse.png", Texture::TextureType::Diffuse) };
+		Texture* pFireDiffuseTexture{ m_pTextureRegistry->Acquire("Resources/fireFX_diffuse.png", Texture::TextureType::Diffuse) };
 		m_pTextures.push_back(pFireDiffuseTexture);
 
 		// Create the fire mesh and add it ot the list of meshes
@@ -277,5 +532,11 @@ namespace dae {
 		pFire->SetPosition({ 0.0f, 0.0f, 50.0f });
 		pFire->SetTexture(pFireDiffuseTexture);
 		m_pMeshes.push_back(pFire);
+
+		// Upload the lights to the effects of the meshes
+		for (Mesh* pMesh : m_pMeshes)
+		{
+			pMesh->SetLights(m_Lights);
+		}
 	}
 }
@@ -12,6 +12,7 @@ namespace dae
 	class Camera;
 	class Mesh;
 	class Texture;
+	class TextureRegistry;
 
 	class Renderer final
 	{
@@ -33,10 +34,22 @@ namespace dae
 		void ToggleSamplerState() const;
 		void ToggleShadingMode() const;
 		void ToggleNormalMap() const;
+		void ToggleShadingRatePolicy() const;
+		void ToggleDynamicResolution() const;
+		void ToggleReprojectionCache() const;
+		void ToggleCheckerboard() const;
+		void ToggleOrderIndependentTransparency() const;
+		void ToggleHdrBuffer() const;
+		void CyclePresentQueueDepth() const;
+		void CycleFrameCapture() const;
+		void CycleDepthFormat() const;
 		void ToggleShowingDepthBuffer() const;
 		void ToggleShowingBoundingBoxes() const;
 		void ToggleUniformBackground();
 		void ToggleCullMode();
+		void CycleDepthProjection() const;
+		void ToggleTransparencyResolution();
+		void ToggleMultisampling();
 
 	private:
 		enum class RenderMode
@@ -50,16 +63,22 @@ namespace dae
 
 		Camera* m_pCamera{};
 		std::vector<Mesh*> m_pMeshes{};
+		TextureRegistry* m_pTextureRegistry{};
 		std::vector<Texture*> m_pTextures{};
+		std::vector<Light> m_Lights{};
 
 		RenderMode m_RenderMode{ RenderMode::Hardware };
 		CullMode m_CullMode{ CullMode::Back };
+		TransparencyResolution m_TransparencyResolution{ TransparencyResolution::Full };
 		bool m_IsMeshRotating{ true };
 		bool m_IsBackgroundUniform{};
+		bool m_IsMultisamplingEnabled{};
 
 		HardwareRenderer* m_pHardwareRender{};
 		SoftwareRenderer* m_pSoftwareRender{};
 
+		void LoadLights();
 		void LoadMeshes();
+		ShadowInfo CalculateShadowInfo() const;
 	};
 }
@@ -2,12 +2,28 @@
 // Globals
 //------------------------------------------------
 float gPI = 3.14159265359f;
-float gLightIntensity = 7.0f;
 float gShininess = 25.0f;
+bool gIsNormalMapTwoChannel = false;
+bool gIsNormalMapObjectSpace = false;
 
-float3 gLightDirection = normalize(float3(0.577f, -0.577f, 0.577f));
+// The lights of the scene, uploaded by MaterialShaded::SetLights
+#define MAX_LIGHTS 32
+#define LIGHT_DIRECTIONAL 0
+#define LIGHT_POINT 1
+#define LIGHT_SPOT 2
+int gNrLights = 0;
+float4 gLightPositions[MAX_LIGHTS];		// xyz: position, w: type
+float4 gLightDirections[MAX_LIGHTS];	// xyz: direction, w: range
+float4 gLightColors[MAX_LIGHTS];		// rgb: color, a: intensity
+float4 gLightCones[MAX_LIGHTS];			// x: inner cone cosine, y: outer cone cosine
 float4 gAmbientColor = float4(0.025f, 0.025f, 0.025f, 1.0f);
 
+// The shadow map of the shadow casting light, uploaded by MaterialShaded::SetShadow
+int gShadowLightIdx = -1;
+float gShadowNormalOffset = 0.0f;
+float gShadowDepthBias = 0.001f;
+float4x4 gLightViewProj;
+
 float4x4 gWorldViewProj : WorldViewProjection;
 float4x4 gWorld : World;
 float4x4 gViewInverse : ViewInverse;
@@ -16,6 +32,7 @@ Texture2D gDiffuseMap : DiffuseMap;
 Texture2D gNormalMap : NormalMap;
 Texture2D gSpecularMap : SpecularMap;
 Texture2D gGlossinessMap : GlossinessMap;
+Texture2D gShadowMap;
 
 SamplerState gSamState : SampleState
 {
@@ -24,17 +41,34 @@ SamplerState gSamState : SampleState
 	AddressV = Wrap; // or Mirror, Clamp, Border
 };
 
+// Point sampled comparisons so the filter is the same as LightingUtils::SampleShadowMap, positions outside the shadow map are lit
+SamplerComparisonState gShadowSampler
+{
+	Filter = COMPARISON_MIN_MAG_MIP_POINT;
+	AddressU = Border;
+	AddressV = Border;
+	BorderColor = float4(1.0f, 1.0f, 1.0f, 1.0f);
+	ComparisonFunc = LESS_EQUAL;
+};
+
 RasterizerState gRasterizerState
 {
 	CullMode = back;
 };
 
+// Both sides of the triangles cast shadows
+RasterizerState gShadowRasterizerState
+{
+	CullMode = none;
+};
+
 BlendState gBlendState
 {
 	BlendEnable[0] = false;
 	RenderTargetWriteMask[0] = 0x0F;
 };
 
+// Replaced by the renderer when the camera uses reversed depth
 DepthStencilState gDepthStencilState
 {
 	DepthEnable = true;
@@ -43,6 +77,15 @@ DepthStencilState gDepthStencilState
 	StencilEnable = false;
 };
 
+// The shadow map always uses the standard depth of the light's orthographic projection
+DepthStencilState gShadowDepthStencilState
+{
+	DepthEnable = true;
+	DepthWriteMask = 1;
+	DepthFunc = less;
+	StencilEnable = false;
+};
+
 //------------------------------------------------
 // Input/Output Struct
 //------------------------------------------------
@@ -77,6 +120,12 @@ VS_OUTPUT VS(VS_INPUT input)
 	return output;
 }
 
+// Only the depth is needed for the shadow map
+float4 VS_Shadow(VS_INPUT input) : SV_POSITION
+{
+	return mul(mul(float4(input.Position, 1.0f), gWorld), gLightViewProj);
+}
+
 //------------------------------------------------
 // BRDF Calculation
 //------------------------------------------------
@@ -94,26 +143,91 @@ float CalculatePhong(float exp, float3 l, float3 v, float3 n)
 	return phong;
 }
 
+// Calculates the direction towards the light and returns how much of the light reaches the position
+float CalculateLightFalloff(int lightIdx, float3 position, out float3 toLight)
+{
+	int type = (int)gLightPositions[lightIdx].w;
+	if (type == LIGHT_DIRECTIONAL)
+	{
+		toLight = -gLightDirections[lightIdx].xyz;
+		return 1.0f;
+	}
+
+	toLight = gLightPositions[lightIdx].xyz - position;
+	float distance = length(toLight);
+	toLight /= distance;
+
+	float distanceFalloff = saturate(1.0f - distance / gLightDirections[lightIdx].w);
+	distanceFalloff *= distanceFalloff;
+	if (type == LIGHT_POINT) return distanceFalloff;
+
+	float coneCos = dot(-toLight, gLightDirections[lightIdx].xyz);
+	float coneFalloff = saturate((coneCos - gLightCones[lightIdx].y) / (gLightCones[lightIdx].x - gLightCones[lightIdx].y));
+	return distanceFalloff * coneFalloff;
+}
+
+// Returns how much of the 3x3 texels around the position in the shadow map are lit (percentage closer filtering)
+float CalculateShadow(float3 position)
+{
+	// The light uses an orthographic projection, so no perspective divide is needed
+	float4 lightPosition = mul(float4(position, 1.0f), gLightViewProj);
+	float2 uv = float2(lightPosition.x * 0.5f + 0.5f, 0.5f - lightPosition.y * 0.5f);
+
+	float width, height;
+	gShadowMap.GetDimensions(width, height);
+	float2 texelSize = float2(1.0f / width, 1.0f / height);
+
+	float lit = 0.0f;
+	[unroll] for (int y = -1; y <= 1; ++y)
+	{
+		[unroll] for (int x = -1; x <= 1; ++x)
+		{
+			lit += gShadowMap.SampleCmpLevelZero(gShadowSampler, uv + float2(x, y) * texelSize, lightPosition.z - gShadowDepthBias);
+		}
+	}
+	return lit / 9.0f;
+}
+
 //------------------------------------------------
 // Pixel Shader
 //------------------------------------------------
 float4 PS(VS_OUTPUT input) : SV_TARGET
 {
-	float3 binormal = cross(input.Normal, input.Tangent);
-	float4x4 tangentSpaceAxis = float4x4(float4(input.Tangent, 0.0f), float4(binormal, 0.0f), float4(input.Normal, 0.0), float4(0.0f, 0.0f, 0.0f, 1.0f));
 	float3 currentNormalMap = 2.0f * gNormalMap.Sample(gSamState, input.UV).rgb - float3(1.0f, 1.0f, 1.0f);
-	float3 normal = normalize(mul(float4(currentNormalMap, 0.0f), tangentSpaceAxis).xyz);
+	float3 normal;
+	if (gIsNormalMapObjectSpace)
+	{
+		normal = normalize(mul(currentNormalMap, (float3x3)gWorld));
+	}
+	else
+	{
+		float3 binormal = cross(input.Normal, input.Tangent);
+		float4x4 tangentSpaceAxis = float4x4(float4(input.Tangent, 0.0f), float4(binormal, 0.0f), float4(input.Normal, 0.0), float4(0.0f, 0.0f, 0.0f, 1.0f));
+		if (gIsNormalMapTwoChannel) currentNormalMap.z = sqrt(saturate(1.0f - dot(currentNormalMap.xy, currentNormalMap.xy)));
+		normal = normalize(mul(float4(currentNormalMap, 0.0f), tangentSpaceAxis).xyz);
+	}
 
 	float3 viewDirection = normalize(input.WorldPosition.xyz - gViewInverse[3].xyz);
 
-	float observedArea = saturate(dot(normal, -gLightDirection));
-
 	float4 lambert = CalculateLambert(gDiffuseMap.Sample(gSamState, input.UV));
 
 	float specularExp = gShininess * gGlossinessMap.Sample(gSamState, input.UV).r;
-	float4 specular = gSpecularMap.Sample(gSamState, input.UV) * CalculatePhong(specularExp, gLightDirection, -viewDirection, normal);
+	float4 specularColor = gSpecularMap.Sample(gSamState, input.UV);
 
-	return (gLightIntensity * lambert) * observedArea + specular + gAmbientColor;
+	float4 color = gAmbientColor;
+	for (int i = 0; i < gNrLights; ++i)
+	{
+		float3 toLight;
+		float falloff = CalculateLightFalloff(i, input.WorldPosition.xyz, toLight);
+		if (i == gShadowLightIdx) falloff *= CalculateShadow(input.WorldPosition.xyz + normalize(input.Normal) * gShadowNormalOffset);
+
+		float observedArea = saturate(dot(normal, toLight)) * falloff;
+		float4 specular = specularColor * CalculatePhong(specularExp, -toLight, -viewDirection, normal) * falloff;
+
+		color += float4(gLightColors[i].rgb, 1.0f) * ((gLightColors[i].a * lambert) * observedArea + specular);
+	}
+
+	return color;
 }
 
 //------------------------------------------------
@@ -130,4 +244,17 @@ technique11 DefaultTechnique
 		SetGeometryShader(NULL);
 		SetPixelShader(CompileShader(ps_5_0, PS()));
 	}
+}
+
+technique11 ShadowTechnique
+{
+	pass P0
+	{
+		SetRasterizerState(gShadowRasterizerState);
+		SetDepthStencilState(gShadowDepthStencilState, 0);
+		SetBlendState(gBlendState, float4(0.0f, 0.0f, 0.0f, 0.0f), 0xFFFFFFFF);
+		SetVertexShader(CompileShader(vs_5_0, VS_Shadow()));
+		SetGeometryShader(NULL);
+		SetPixelShader(NULL);
+	}
 }
\ No newline at end of file
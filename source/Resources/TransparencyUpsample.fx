@@ -0,0 +1,237 @@
+//------------------------------------------------
+// Globals
+//------------------------------------------------
+// The depth buffer of the opaque meshes at full resolution, the multisampled one is used when the scene is rendered with multisampling
+Texture2D gDepthMap : DepthMap;
+Texture2DMS<float> gMultisampleDepthMap : MultisampleDepthMap;
+// The transparent meshes at reduced resolution (premultiplied color and the part of the background that is still visible) and their depth buffer
+Texture2D gTransparencyMap : TransparencyMap;
+Texture2D gTransparencyDepthMap : TransparencyDepthMap;
+
+// How much smaller the reduced resolution is in each direction
+int gDownscale = 2;
+// The entries of the projection matrix that convert a depth buffer value to view space depth, depth = x + y / w
+float2 gDepthProjection;
+// Reversed depth puts the near plane at 1 and clears the depth buffer to 0
+bool gIsDepthReversed = false;
+
+// Reduced resolution samples that are this much further or closer (relative to the view depth) get half of their bilinear weight
+static const float gDepthTolerance = 0.02f;
+
+RasterizerState gRasterizerState
+{
+	CullMode = none;
+};
+
+DepthStencilState gWriteDepthState
+{
+	DepthEnable = true;
+	DepthWriteMask = all;
+	DepthFunc = always;
+	StencilEnable = false;
+};
+
+DepthStencilState gNoDepthState
+{
+	DepthEnable = false;
+	DepthWriteMask = zero;
+	StencilEnable = false;
+};
+
+BlendState gNoBlendState
+{
+	BlendEnable[0] = false;
+};
+
+// The transparent color is premultiplied and the alpha holds how much of the background is still visible
+BlendState gCompositeBlendState
+{
+	BlendEnable[0] = true;
+	SrcBlend = one;
+	DestBlend = src_alpha;
+	BlendOp = add;
+	SrcBlendAlpha = zero;
+	DestBlendAlpha = one;
+	BlendOpAlpha = add;
+	RenderTargetWriteMask[0] = 0x0F;
+};
+
+//------------------------------------------------
+// Input/Output Struct
+//------------------------------------------------
+struct VS_OUTPUT
+{
+	float4 Position			: SV_POSITION;
+};
+
+//------------------------------------------------
+// Vertex Shader
+//------------------------------------------------
+// One triangle that covers the whole screen
+VS_OUTPUT VS(uint vertexId : SV_VertexID)
+{
+	VS_OUTPUT output = (VS_OUTPUT)0;
+	const float2 uv = float2((vertexId << 1) & 2, vertexId & 2);
+	output.Position = float4(uv * float2(2.0f, -2.0f) + float2(-1.0f, 1.0f), 0.0f, 1.0f);
+	return output;
+}
+
+//------------------------------------------------
+// Pixel Shaders
+//------------------------------------------------
+float ToViewDepth(float depth)
+{
+	// The background is infinitely far away
+	if (gIsDepthReversed ? depth <= 0.0f : depth >= 1.0f) return 1e30f;
+	return gDepthProjection.y / (depth - gDepthProjection.x);
+}
+
+float FurthestDepth(float depth0, float depth1)
+{
+	return gIsDepthReversed ? min(depth0, depth1) : max(depth0, depth1);
+}
+
+int2 GetDepthMapSize(uniform bool isMultisampled)
+{
+	int2 depthSize;
+	int nrSamples;
+	if (isMultisampled) gMultisampleDepthMap.GetDimensions(depthSize.x, depthSize.y, nrSamples);
+	else gDepthMap.GetDimensions(depthSize.x, depthSize.y);
+	return depthSize;
+}
+
+// The opaque depth of a pixel, with multisampling the furthest of its samples
+float LoadDepth(int2 pixel, uniform bool isMultisampled)
+{
+	if (!isMultisampled) return gDepthMap.Load(int3(pixel, 0)).r;
+
+	int2 depthSize;
+	int nrSamples;
+	gMultisampleDepthMap.GetDimensions(depthSize.x, depthSize.y, nrSamples);
+
+	float furthestDepth = gMultisampleDepthMap.Load(pixel, 0).r;
+	for (int i = 1; i < nrSamples; ++i)
+	{
+		furthestDepth = FurthestDepth(furthestDepth, gMultisampleDepthMap.Load(pixel, i).r);
+	}
+	return furthestDepth;
+}
+
+// Keep the furthest depth of the block, transparent pixels are then only hidden when the whole block is hidden
+float PS_DownsampleDepth(VS_OUTPUT input, uniform bool isMultisampled) : SV_DEPTH
+{
+	const int2 blockStart = int2(input.Position.xy) * gDownscale;
+	const int2 depthSize = GetDepthMapSize(isMultisampled);
+
+	float furthestDepth = gIsDepthReversed ? 1.0f : 0.0f;
+	for (int y = 0; y < gDownscale; ++y)
+	{
+		for (int x = 0; x < gDownscale; ++x)
+		{
+			// Blocks at the edge of the screen repeat the last pixel
+			furthestDepth = FurthestDepth(furthestDepth, LoadDepth(min(blockStart + int2(x, y), depthSize - 1), isMultisampled));
+		}
+	}
+	return furthestDepth;
+}
+
+// Upsample the transparent meshes, samples of the same surface as the pixel get the most weight so the colors don't bleed over depth edges
+float4 PS_Composite(VS_OUTPUT input, uniform bool isMultisampled) : SV_TARGET
+{
+	int2 transparencySize;
+	gTransparencyMap.GetDimensions(transparencySize.x, transparencySize.y);
+
+	const int2 pixel = int2(input.Position.xy);
+	const float viewDepth = ToViewDepth(LoadDepth(pixel, isMultisampled));
+
+	// The four reduced resolution samples around the center of this pixel, the samples are at the centers of the reduced resolution pixels
+	const float2 lowPosition = max((float2(pixel) + 0.5f) / gDownscale - 0.5f, 0.0f);
+	const int2 low0 = int2(lowPosition);
+	const int2 low1 = min(low0 + 1, transparencySize - 1);
+	const float2 fraction = lowPosition - low0;
+
+	const int2 samplePixels[4] = { low0, int2(low1.x, low0.y), int2(low0.x, low1.y), low1 };
+	const float bilinearWeights[4] =
+	{
+		(1.0f - fraction.x) * (1.0f - fraction.y),
+		fraction.x * (1.0f - fraction.y),
+		(1.0f - fraction.x) * fraction.y,
+		fraction.x * fraction.y
+	};
+
+	float weights[4];
+	float weightSum = 0.0f;
+	for (int i = 0; i < 4; ++i)
+	{
+		const float sampleViewDepth = ToViewDepth(gTransparencyDepthMap.Load(int3(samplePixels[i], 0)).r);
+		const float depthDifference = abs(sampleViewDepth - viewDepth) / min(sampleViewDepth, viewDepth);
+		weights[i] = bilinearWeights[i] / (1.0f + depthDifference / gDepthTolerance);
+		weightSum += weights[i];
+	}
+
+	// Fall back to plain bilinear filtering when no sample is on the same surface
+	const bool useBilinear = weightSum <= 1e-6f;
+
+	float4 color = float4(0.0f, 0.0f, 0.0f, 0.0f);
+	for (int j = 0; j < 4; ++j)
+	{
+		const float weight = useBilinear ? bilinearWeights[j] : weights[j] / weightSum;
+		color += gTransparencyMap.Load(int3(samplePixels[j], 0)) * weight;
+	}
+	return color;
+}
+
+//------------------------------------------------
+// Technique
+//------------------------------------------------
+technique11 DownsampleDepthTechnique
+{
+	pass P0
+	{
+		SetRasterizerState(gRasterizerState);
+		SetDepthStencilState(gWriteDepthState, 0);
+		SetBlendState(gNoBlendState, float4(0.0f, 0.0f, 0.0f, 0.0f), 0xFFFFFFFF);
+		SetVertexShader(CompileShader(vs_5_0, VS()));
+		SetGeometryShader(NULL);
+		SetPixelShader(CompileShader(ps_5_0, PS_DownsampleDepth(false)));
+	}
+}
+
+technique11 MultisampleDownsampleDepthTechnique
+{
+	pass P0
+	{
+		SetRasterizerState(gRasterizerState);
+		SetDepthStencilState(gWriteDepthState, 0);
+		SetBlendState(gNoBlendState, float4(0.0f, 0.0f, 0.0f, 0.0f), 0xFFFFFFFF);
+		SetVertexShader(CompileShader(vs_5_0, VS()));
+		SetGeometryShader(NULL);
+		SetPixelShader(CompileShader(ps_5_0, PS_DownsampleDepth(true)));
+	}
+}
+
+technique11 CompositeTechnique
+{
+	pass P0
+	{
+		SetRasterizerState(gRasterizerState);
+		SetDepthStencilState(gNoDepthState, 0);
+		SetBlendState(gCompositeBlendState, float4(0.0f, 0.0f, 0.0f, 0.0f), 0xFFFFFFFF);
+		SetVertexShader(CompileShader(vs_5_0, VS()));
+		SetGeometryShader(NULL);
+		SetPixelShader(CompileShader(ps_5_0, PS_Composite(false)));
+	}
+}
+
+technique11 MultisampleCompositeTechnique
+{
+	pass P0
+	{
+		SetRasterizerState(gRasterizerState);
+		SetDepthStencilState(gNoDepthState, 0);
+		SetBlendState(gCompositeBlendState, float4(0.0f, 0.0f, 0.0f, 0.0f), 0xFFFFFFFF);
+		SetVertexShader(CompileShader(vs_5_0, VS()));
+		SetGeometryShader(NULL);
+		SetPixelShader(CompileShader(ps_5_0, PS_Composite(true)));
+	}
+}
\ No newline at end of file
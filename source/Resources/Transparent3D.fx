@@ -29,6 +29,21 @@ BlendState gBlendState
 	RenderTargetWriteMask[0] = 0x0F;
 };
 
+// Renders into a reduced resolution buffer that starts at (0, 0, 0, 1)
+// The color is premultiplied and the alpha keeps how much of the background is still visible
+BlendState gReducedResolutionBlendState
+{
+	BlendEnable[0] = true;
+	SrcBlend = src_alpha;
+	DestBlend = inv_src_alpha;
+	BlendOp = add;
+	SrcBlendAlpha = zero;
+	DestBlendAlpha = inv_src_alpha;
+	BlendOpAlpha = add;
+	RenderTargetWriteMask[0] = 0x0F;
+};
+
+// Replaced by the renderer when the camera uses reversed depth
 DepthStencilState gDepthStencilState
 {
 	DepthEnable = true;
@@ -87,4 +102,17 @@ technique11 DefaultTechnique
 		SetGeometryShader(NULL);
 		SetPixelShader(CompileShader(ps_5_0, PS()));
 	}
+}
+
+technique11 ReducedResolutionTechnique
+{
+	pass P0
+	{
+		SetRasterizerState(gRasterizerState);
+		SetDepthStencilState(gDepthStencilState, 0);
+		SetBlendState(gReducedResolutionBlendState, float4(0.0f, 0.0f, 0.0f, 0.0f), 0xFFFFFFFF);
+		SetVertexShader(CompileShader(vs_5_0, VS()));
+		SetGeometryShader(NULL);
+		SetPixelShader(CompileShader(ps_5_0, PS()));
+	}
 }
\ No newline at end of file
@@ -2,8 +2,12 @@
 #include "SoftwareRenderer.h"
 #include "Mesh.h"
 #include "Camera.h"
+#include "Utils.h"
+#include "PresentQueue.h"
+#include "FrameCapture.h"
 #include <ppl.h> // Parallel Stuff
 #include <future>
+#include <chrono>
 
 namespace dae
 {
@@ -11,40 +15,140 @@ namespace dae
 		: m_pWindow{ pWindow }
 	{
 		//Initialize
-		SDL_GetWindowSize(pWindow, &m_Info.width, &m_Info.height);
+		SDL_GetWindowSize(pWindow, &m_WindowWidth, &m_WindowHeight);
 
-		//Create Buffers
-		m_Info.pFrontBuffer = SDL_GetWindowSurface(pWindow);
-		m_Info.pBackBuffer = SDL_CreateRGBSurface(0, m_Info.width, m_Info.height, 32, 0, 0, 0, 0);
-		m_Info.pBackBufferPixels = static_cast<uint32_t*>(m_Info.pBackBuffer->pixels);
-		m_Info.pDepthBuffer = new float[static_cast<uint32_t>(m_Info.width * m_Info.height)];
-		ResetDepthBuffer();
+		//Create Buffers, the back buffers are owned by the present queue
+		m_pPresentQueue = new PresentQueue{ pWindow, 2 };
+
+		// Keep up to 8 captured frames in memory while they are written to disk
+		m_pFrameCapture = new FrameCapture{ 8 };
+
+		// Render at the size of the window
+		Resize(m_WindowWidth, m_WindowHeight);
 	}
 
-	void dae::SoftwareRenderer::Render(const std::vector<Mesh*>& pMeshes, Camera* pCamera, bool useUniformBackground) const
+	SoftwareRenderer::~SoftwareRenderer()
 	{
-		// Reset the depth buffer
-		ResetDepthBuffer();
+		// Write and show the last frames before the back buffers are released
+		delete m_pFrameCapture;
+		delete m_pPresentQueue;
+		delete[] m_Info.pDepthBuffer;
+		delete[] m_Info.pTileClearStates;
+		delete[] m_TransparencyInfo.pDepthBuffer;
+	}
+
+	void dae::SoftwareRenderer::Render(const std::vector<Mesh*>& pMeshes, const std::vector<Light>& lights, const ShadowInfo& shadow, Camera* pCamera, bool useUniformBackground)
+	{
+		const auto frameStart{ std::chrono::steady_clock::now() };
+
+		// Render the depth of the scene seen from the shadow casting light
+		RenderShadowMap(pMeshes, shadow);
+
+		// Find the lights that affect each tile of the screen
+		CullLights(lights, pCamera);
 
-		// Paint the canvas black
+		// Choose the shading rate of each tile of the screen
+		UpdateShadingRates();
+
+		// Render in a back buffer that is not waiting to be shown
+		AcquireBackBuffer();
+
+		// The depth test and the depth clear value follow the projection of the camera
+		m_Info.isDepthReversed = pCamera->IsDepthReversed();
+		m_TransparencyInfo.isDepthReversed = m_Info.isDepthReversed;
+
+		// With multisampling the opaque meshes are rendered in the sample buffers
+		m_Info.pSampleDepthBuffer = m_IsMultisamplingEnabled ? m_SampleDepths.data() : nullptr;
+		m_Info.pSampleColorBuffer = m_IsMultisamplingEnabled ? m_SampleColors.data() : nullptr;
+
+		// Paint the canvas black, the depth buffer and the canvas are only reset in the tiles that triangles touch
 		ClearBackground(useUniformBackground);
 
 		//Lock BackBuffer
 		SDL_LockSurface(m_Info.pBackBuffer);
 
-		// For each mesh
+		// Shade the other half of the checkerboard than in the previous frame
+		m_Info.checkerboardParity ^= 1;
+
+		// For each opaque mesh
 		for (Mesh* pMesh : pMeshes)
 		{
 			// If the mesh is visible, render the mesh
-			if (!pMesh->IsVisible()) continue;
+			if (!pMesh->IsVisible() || pMesh->IsTransparent()) continue;
 
 			pMesh->SoftwareRender(pCamera, m_Info);
 		}
 
-		//Update SDL Surface
+		// Clear the tiles that no opaque triangle touched, every pass after this reads the whole depth buffer and canvas
+		ResolveTileClears();
+
+		// Average the samples into the pixels, the transparent meshes and every pass after this only use the pixels
+		if (m_IsMultisamplingEnabled)
+		{
+			ResolveSamples();
+			m_Info.pSampleDepthBuffer = nullptr;
+			m_Info.pSampleColorBuffer = nullptr;
+		}
+
+		// Fill in the checkerboard pixels that couldn't be reprojected
+		if (m_Info.isCheckerboardEnabled && !m_Info.isShowingDepthBuffer && !m_Info.isShowingBoundingBoxes) ResolveCheckerboard();
+
+		// Store the opaque result of this frame, transparent meshes are blended again every frame
+		if (m_Info.pReprojectionCache) UpdateReprojectionCache(pCamera);
+
+		// Transparent meshes can only be rendered at a lower resolution when they are composited from the order independent transparency buffers
+		const bool isTransparencyDownscaled{ m_TransparencyResolution != TransparencyResolution::Full && m_Info.pTransparencyAccumulation &&
+			!m_Info.isShowingDepthBuffer && !m_Info.isShowingBoundingBoxes };
+		const SoftwareRenderInfo& transparencyInfo{ isTransparencyDownscaled ? m_TransparencyInfo : m_Info };
+
+		// The transparent meshes are tested against the depth of the opaque meshes at their own resolution
+		if (isTransparencyDownscaled) DownsampleDepthBuffer();
+
+		// Start with empty transparency buffers, nothing is in front of the opaque meshes yet
+		if (transparencyInfo.pTransparencyAccumulation)
+		{
+			const size_t nrTransparencyPixels{ static_cast<size_t>(transparencyInfo.width) * transparencyInfo.height };
+			std::fill_n(m_TransparencyAccumulation.begin(), nrTransparencyPixels, ColorRGB{ 0.0f, 0.0f, 0.0f, 0.0f });
+			std::fill_n(m_TransparencyRevealage.begin(), nrTransparencyPixels, 1.0f);
+		}
+
+		// For each transparent mesh
+		for (Mesh* pMesh : pMeshes)
+		{
+			// If the mesh is visible, render the mesh
+			if (!pMesh->IsVisible() || !pMesh->IsTransparent()) continue;
+
+			pMesh->SoftwareRender(pCamera, transparencyInfo);
+		}
+
+		// Blend the accumulated transparent colors over the opaque meshes
+		if (m_Info.pTransparencyAccumulation && !m_Info.isShowingDepthBuffer && !m_Info.isShowingBoundingBoxes) CompositeTransparency(isTransparencyDownscaled, pCamera);
+
+		// Tonemap the HDR colors into the back buffer
+		if (m_Info.pHdrBuffer) ResolveHdrBuffer();
+
+		// The content adaptive shading rates of the next frame are based on this frame
+		if (m_ShadingRatePolicy == ShadingRatePolicy::ContentAdaptive) MeasureTileVariances();
+
+		// Copy the frame to be written to disk, the frame is dropped when the capture thread is too far behind
+		if (m_pFrameCapture->GetFormat() != CaptureFormat::Off) m_pFrameCapture->Capture(m_Info.pBackBufferPixels, m_Info.width, m_Info.height, m_Info.pixelSwizzle);
+
+		//Update SDL Surface, the present thread copies the frame to the window while the next frame is rendered
 		SDL_UnlockSurface(m_Info.pBackBuffer);
-		SDL_BlitSurface(m_Info.pBackBuffer, 0, m_Info.pFrontBuffer, 0);
-		SDL_UpdateWindowSurface(m_pWindow);
+		m_pPresentQueue->Present(m_Info.pBackBuffer);
+
+		if (!m_IsDynamicResolutionEnabled) return;
+
+		// Let the controller choose the resolution of the next frame based on the time this frame took
+		const float frameTime{ std::chrono::duration<float>(std::chrono::steady_clock::now() - frameStart).count() };
+		if (m_DynamicResolution.Update(frameTime))
+		{
+			const float scale{ m_DynamicResolution.GetScale() };
+			Resize(static_cast<int>(m_WindowWidth * scale), static_cast<int>(m_WindowHeight * scale));
+
+			std::cout << "\033[35m"; // TEXT COLOR
+			std::cout << "**(SOFTWARE) Render Resolution = " << m_Info.width << "x" << m_Info.height << "\n";
+		}
 	}
 
 	void SoftwareRenderer::ToggleShowingDepthBuffer()
@@ -84,6 +188,9 @@ namespace dae
 		// Shuffle through all the lighting modes
 		m_Info.lightingMode = static_cast<LightingMode>((static_cast<int>(m_Info.lightingMode) + 1) % (static_cast<int>(LightingMode::Specular) + 1));
 
+		// The cached colors were shaded with the previous lighting mode
+		m_ReprojectionCache.isValid = false;
+
 		std::cout << "\033[35m"; // TEXT COLOR
 		std::cout << "**(SOFTWARE) Shading Mode = ";
 		switch (m_Info.lightingMode)
@@ -108,6 +215,9 @@ namespace dae
 		// Toggle the normal map active variable
 		m_Info.isNormalMapActive = !m_Info.isNormalMapActive;
 
+		// The cached colors were shaded with the other normals
+		m_ReprojectionCache.isValid = false;
+
 		std::cout << "\033[35m"; // TEXT COLOR
 		std::cout << "**(SOFTWARE) NormalMap ";
 		if (m_Info.isNormalMapActive)
@@ -120,21 +230,396 @@ namespace dae
 		}
 	}
 
+	void SoftwareRenderer::ToggleShadingRatePolicy()
+	{
+		// Shuffle through all the shading rate policies
+		m_ShadingRatePolicy = static_cast<ShadingRatePolicy>((static_cast<int>(m_ShadingRatePolicy) + 1) % (static_cast<int>(ShadingRatePolicy::Foveated) + 1));
+
+		// The previous frame wasn't measured when the policy wasn't content adaptive
+		std::fill(m_TileVariances.begin(), m_TileVariances.end(), FLT_MAX);
+
+		std::cout << "\033[35m"; // TEXT COLOR
+		std::cout << "**(SOFTWARE) Variable Rate Shading = ";
+		switch (m_ShadingRatePolicy)
+		{
+		case dae::ShadingRatePolicy::Off:
+			std::cout << "OFF\n";
+			break;
+		case dae::ShadingRatePolicy::ContentAdaptive:
+			std::cout << "CONTENT_ADAPTIVE\n";
+			break;
+		case dae::ShadingRatePolicy::Foveated:
+			std::cout << "FOVEATED\n";
+			break;
+		}
+	}
+
+	void SoftwareRenderer::ToggleDynamicResolution()
+	{
+		m_IsDynamicResolutionEnabled = !m_IsDynamicResolutionEnabled;
+
+		// Always start at the full resolution
+		m_DynamicResolution.Reset();
+		Resize(m_WindowWidth, m_WindowHeight);
+
+		std::cout << "\033[35m"; // TEXT COLOR
+		std::cout << "**(SOFTWARE) Dynamic Resolution ";
+		if (m_IsDynamicResolutionEnabled)
+		{
+			std::cout << "ON\n";
+		}
+		else
+		{
+			std::cout << "OFF\n";
+		}
+	}
+
+	void SoftwareRenderer::ToggleReprojectionCache()
+	{
+		m_Info.isReprojectionCacheEnabled = !m_Info.isReprojectionCacheEnabled;
+		UpdateReprojectionBuffers();
+
+		std::cout << "\033[35m"; // TEXT COLOR
+		std::cout << "**(SOFTWARE) Reprojection Cache ";
+		if (m_Info.isReprojectionCacheEnabled)
+		{
+			std::cout << "ON\n";
+		}
+		else
+		{
+			std::cout << "OFF\n";
+		}
+	}
+
+	void SoftwareRenderer::ToggleCheckerboard()
+	{
+		m_Info.isCheckerboardEnabled = !m_Info.isCheckerboardEnabled;
+		UpdateReprojectionBuffers();
+
+		std::cout << "\033[35m"; // TEXT COLOR
+		std::cout << "**(SOFTWARE) Checkerboard Rendering ";
+		if (m_Info.isCheckerboardEnabled)
+		{
+			std::cout << "ON\n";
+		}
+		else
+		{
+			std::cout << "OFF\n";
+		}
+	}
+
+	void SoftwareRenderer::ToggleOrderIndependentTransparency()
+	{
+		m_IsOrderIndependentTransparencyEnabled = !m_IsOrderIndependentTransparencyEnabled;
+		m_Info.pTransparencyAccumulation = m_IsOrderIndependentTransparencyEnabled ? m_TransparencyAccumulation.data() : nullptr;
+		m_Info.pTransparencyRevealage = m_IsOrderIndependentTransparencyEnabled ? m_TransparencyRevealage.data() : nullptr;
+
+		// Reduced transparency resolutions need the order independent transparency buffers
+		if (!m_IsOrderIndependentTransparencyEnabled && m_TransparencyResolution != TransparencyResolution::Full)
+		{
+			std::cout << "\033[35m"; // TEXT COLOR
+			std::cout << "**(SOFTWARE) Transparent meshes are rendered at full resolution without Order Independent Transparency\n";
+		}
+
+		std::cout << "\033[35m"; // TEXT COLOR
+		std::cout << "**(SOFTWARE) Order Independent Transparency ";
+		if (m_IsOrderIndependentTransparencyEnabled)
+		{
+			std::cout << "ON\n";
+		}
+		else
+		{
+			std::cout << "OFF\n";
+		}
+	}
+
+	void SoftwareRenderer::ToggleHdrBuffer()
+	{
+		m_IsHdrEnabled = !m_IsHdrEnabled;
+		m_Info.pHdrBuffer = m_IsHdrEnabled ? m_HdrBuffer.data() : nullptr;
+
+		// The cached colors are stored in the other buffer
+		m_ReprojectionCache.isValid = false;
+
+		std::cout << "\033[35m"; // TEXT COLOR
+		std::cout << "**(SOFTWARE) HDR Color Buffer ";
+		if (m_IsHdrEnabled)
+		{
+			std::cout << "ON\n";
+		}
+		else
+		{
+			std::cout << "OFF\n";
+		}
+	}
+
+	void SoftwareRenderer::CyclePresentQueueDepth()
+	{
+		// Go through queue depths 1 until the maximum
+		m_pPresentQueue->SetQueueDepth(m_pPresentQueue->GetQueueDepth() % PresentQueue::maxQueueDepth + 1);
+
+		std::cout << "\033[35m"; // TEXT COLOR
+		std::cout << "**(SOFTWARE) Present Queue Depth = " << m_pPresentQueue->GetQueueDepth() << "\n";
+	}
+
+	void SoftwareRenderer::CycleFrameCapture()
+	{
+		// Shuffle through all the capture formats, the frames of the previous format are written first
+		m_pFrameCapture->SetFormat(static_cast<CaptureFormat>((static_cast<int>(m_pFrameCapture->GetFormat()) + 1) % (static_cast<int>(CaptureFormat::Y4M) + 1)));
+
+		std::cout << "\033[35m"; // TEXT COLOR
+		std::cout << "**(SOFTWARE) Frame Capture = ";
+		switch (m_pFrameCapture->GetFormat())
+		{
+		case dae::CaptureFormat::Off:
+			std::cout << "OFF\n";
+			break;
+		case dae::CaptureFormat::PPM:
+			std::cout << "PPM\n";
+			break;
+		case dae::CaptureFormat::QOI:
+			std::cout << "QOI\n";
+			break;
+		case dae::CaptureFormat::Y4M:
+			std::cout << "Y4M\n";
+			break;
+		}
+	}
+
+	void SoftwareRenderer::CycleDepthFormat()
+	{
+		// Shuffle through all the depth formats, the depth buffer is cleared every frame so its content doesn't have to be converted
+		m_Info.depthFormat = static_cast<DepthFormat>((static_cast<int>(m_Info.depthFormat) + 1) % (static_cast<int>(DepthFormat::Unorm16) + 1));
+		m_TransparencyInfo.depthFormat = m_Info.depthFormat;
+
+		std::cout << "\033[35m"; // TEXT COLOR
+		std::cout << "**(SOFTWARE) Depth Format = ";
+		switch (m_Info.depthFormat)
+		{
+		case dae::DepthFormat::Float32:
+			std::cout << "FLOAT32\n";
+			break;
+		case dae::DepthFormat::Unorm24:
+			std::cout << "UNORM24\n";
+			break;
+		case dae::DepthFormat::Unorm16:
+			std::cout << "UNORM16\n";
+			break;
+		}
+	}
+
+	void SoftwareRenderer::FlushPresentQueue() const
+	{
+		m_pPresentQueue->Flush();
+	}
+
 	void SoftwareRenderer::SetCullMode(CullMode cullMode)
 	{
 		m_CullMode = cullMode;
 	}
 
-	bool dae::SoftwareRenderer::SaveBufferToImage() const
+	void SoftwareRenderer::SetTransparencyResolution(TransparencyResolution transparencyResolution)
+	{
+		m_TransparencyResolution = transparencyResolution;
+		ResizeTransparencyBuffers();
+	}
+
+	void SoftwareRenderer::SetMultisampling(bool isEnabled)
+	{
+		m_IsMultisamplingEnabled = isEnabled;
+		UpdateSampleBuffers();
+	}
+
+	void SoftwareRenderer::Resize(int width, int height)
+	{
+		// Nothing to do if the size doesn't change
+		if (m_Info.pDepthBuffer && width == m_Info.width && height == m_Info.height) return;
+
+		m_Info.width = width;
+		m_Info.height = height;
+
+		// Recreate the buffers at the new size, the back buffers are resized when they are acquired
+		delete[] m_Info.pDepthBuffer;
+		m_Info.pDepthBuffer = new uint32_t[static_cast<uint32_t>(m_Info.width * m_Info.height)];
+		ResetDepthBuffer();
+
+		// Divide the screen in tiles for the light culling
+		m_Info.nrLightTilesX = (m_Info.width + LIGHT_TILE_SIZE - 1) / LIGHT_TILE_SIZE;
+		m_Info.nrLightTilesY = (m_Info.height + LIGHT_TILE_SIZE - 1) / LIGHT_TILE_SIZE;
+		m_Info.tileShadingRates.assign(static_cast<size_t>(m_Info.nrLightTilesX) * m_Info.nrLightTilesY, ShadingRate::Rate1x1);
+		m_Info.tileLightOffsets.assign(m_Info.tileShadingRates.size() + 1, 0);
+		delete[] m_Info.pTileClearStates;
+		m_Info.pTileClearStates = new std::atomic<TileClearState>[m_Info.tileShadingRates.size()]{};
+
+		// The tiles don't match the previous frame anymore
+		m_TileVariances.assign(m_Info.tileShadingRates.size(), FLT_MAX);
+
+		// The pixels don't match the previous frame anymore
+		const size_t nrPixels{ static_cast<size_t>(m_Info.width) * m_Info.height };
+		m_TriangleIds.assign(nrPixels, 0);
+		m_ReuseAges.assign(nrPixels, 0);
+		UpdateReprojectionBuffers();
+
+		m_HdrBuffer.resize(nrPixels);
+		m_Info.pHdrBuffer = m_IsHdrEnabled ? m_HdrBuffer.data() : nullptr;
+
+		UpdateSampleBuffers();
+
+		m_TransparencyAccumulation.resize(nrPixels);
+		m_TransparencyRevealage.resize(nrPixels);
+		m_Info.pTransparencyAccumulation = m_IsOrderIndependentTransparencyEnabled ? m_TransparencyAccumulation.data() : nullptr;
+		m_Info.pTransparencyRevealage = m_IsOrderIndependentTransparencyEnabled ? m_TransparencyRevealage.data() : nullptr;
+		ResizeTransparencyBuffers();
+	}
+
+	void SoftwareRenderer::ResizeTransparencyBuffers()
+	{
+		// Round up so the reduced resolution covers every pixel
+		const int downscale{ static_cast<int>(m_TransparencyResolution) };
+		m_TransparencyInfo.width = (m_Info.width + downscale - 1) / downscale;
+		m_TransparencyInfo.height = (m_Info.height + downscale - 1) / downscale;
+
+		delete[] m_TransparencyInfo.pDepthBuffer;
+		m_TransparencyInfo.pDepthBuffer = new uint32_t[static_cast<uint32_t>(m_TransparencyInfo.width * m_TransparencyInfo.height)];
+		m_TransparencyInfo.depthFormat = m_Info.depthFormat;
+
+		// The reduced resolution fits in the first part of the full resolution buffers
+		m_TransparencyInfo.pTransparencyAccumulation = m_TransparencyAccumulation.data();
+		m_TransparencyInfo.pTransparencyRevealage = m_TransparencyRevealage.data();
+	}
+
+	void SoftwareRenderer::DownsampleDepthBuffer() const
+	{
+		const int downscale{ static_cast<int>(m_TransparencyResolution) };
+
+		concurrency::parallel_for(0, m_TransparencyInfo.height, [&](int py)
+			{
+				for (int px{}; px < m_TransparencyInfo.width; ++px)
+				{
+					// Keep the furthest depth of the block, transparent pixels are then only hidden when the whole block is hidden
+					// The edges where the opaque depth changes are fixed by the depth aware upsampling
+					// The depth formats keep their order as integers, so the furthest depth is the largest integer, or the smallest with reversed depth
+					uint32_t furthestDepthCode{ m_Info.isDepthReversed ? UINT32_MAX : 0 };
+					const int endY{ std::min((py + 1) * downscale, m_Info.height) };
+					const int endX{ std::min((px + 1) * downscale, m_Info.width) };
+					for (int fullY{ py * downscale }; fullY < endY; ++fullY)
+					{
+						for (int fullX{ px * downscale }; fullX < endX; ++fullX)
+						{
+							const uint32_t depthCode{ m_Info.GetDepthCode(fullX + fullY * m_Info.width) };
+							furthestDepthCode = m_Info.isDepthReversed ? std::min(furthestDepthCode, depthCode) : std::max(furthestDepthCode, depthCode);
+						}
+					}
+
+					m_TransparencyInfo.SetDepthCode(px + py * m_TransparencyInfo.width, furthestDepthCode);
+				}
+			});
+	}
+
+	void SoftwareRenderer::AcquireBackBuffer()
+	{
+		m_Info.pBackBuffer = m_pPresentQueue->AcquireBackBuffer(m_Info.width, m_Info.height);
+		m_Info.pBackBufferPixels = static_cast<uint32_t*>(m_Info.pBackBuffer->pixels);
+
+		// Pick the channel order of the packed pixels once per frame instead of asking SDL for every pixel
+		const Uint32 pixelFormat{ m_Info.pBackBuffer->format->format };
+		m_Info.pixelSwizzle = pixelFormat == SDL_PIXELFORMAT_BGR888 || pixelFormat == SDL_PIXELFORMAT_ABGR8888 ? PixelSwizzle::XBGR : PixelSwizzle::XRGB;
+	}
+
+	void SoftwareRenderer::ClearBackground(bool useUniformBackground)
+	{
+		// The background that the tiles are filled with
+		const float colorValue{ useUniformBackground ? 0.1f : 0.39f };
+		m_Info.clearColor = ColorRGB{ colorValue, colorValue, colorValue };
+		m_Info.clearPixel = ColorUtils::PackColor(m_Info.clearColor, m_Info.pixelSwizzle);
+
+		// Only forget that the tiles are cleared, the pixels are reset when the first triangle touches their tile
+		const int nrTiles{ m_Info.nrLightTilesX * m_Info.nrLightTilesY };
+		for (int tileIdx{}; tileIdx < nrTiles; ++tileIdx)
+		{
+			m_Info.pTileClearStates[tileIdx].store(TileClearState::Uncleared, std::memory_order_relaxed);
+		}
+	}
+
+	void SoftwareRenderer::ResolveTileClears() const
+	{
+		concurrency::parallel_for(0, m_Info.nrLightTilesY, [&](int tileY)
+			{
+				for (int tileX{}; tileX < m_Info.nrLightTilesX; ++tileX)
+				{
+					m_Info.ClearTile(tileX, tileY);
+				}
+			});
+	}
+
+	void SoftwareRenderer::UpdateSampleBuffers()
+	{
+		// The samples are cleared per tile every frame, so their content doesn't have to be kept
+		const size_t nrSamples{ m_IsMultisamplingEnabled ? static_cast<size_t>(m_Info.width) * m_Info.height * MSAA_SAMPLE_COUNT : 0 };
+		m_SampleDepths.resize(nrSamples);
+		m_SampleColors.resize(nrSamples);
+		m_SampleDepths.shrink_to_fit();
+		m_SampleColors.shrink_to_fit();
+	}
+
+	void SoftwareRenderer::ResolveSamples() const
 	{
-		return SDL_SaveBMP(m_Info.pBackBuffer, "Rasterizer_ColorBuffer.bmp");
+		constexpr float sampleWeight{ 1.0f / MSAA_SAMPLE_COUNT };
+
+		concurrency::parallel_for(0, m_Info.height, [&](int py)
+			{
+				for (int px{}; px < m_Info.width; ++px)
+				{
+					const int pixelIdx{ px + py * m_Info.width };
+					const ColorRGB* pSampleColors{ m_Info.pSampleColorBuffer + pixelIdx * MSAA_SAMPLE_COUNT };
+					const uint32_t* pSampleDepthCodes{ m_Info.pSampleDepthBuffer + pixelIdx * MSAA_SAMPLE_COUNT };
+
+					// The samples of a pixel inside a triangle are the same, only the pixels on the edges get a blend of the triangles that cover them
+					ColorRGB color{ pSampleColors[0] };
+					uint32_t furthestDepthCode{ pSampleDepthCodes[0] };
+					for (int sampleIdx{ 1 }; sampleIdx < MSAA_SAMPLE_COUNT; ++sampleIdx)
+					{
+						color += pSampleColors[sampleIdx];
+
+						// Keep the furthest depth like the reduced resolution depth, transparent pixels are then only hidden when the whole pixel is hidden
+						const uint32_t depthCode{ pSampleDepthCodes[sampleIdx] };
+						furthestDepthCode = m_Info.isDepthReversed ? std::min(furthestDepthCode, depthCode) : std::max(furthestDepthCode, depthCode);
+					}
+					color *= sampleWeight;
+
+					// The samples are already scaled to [0, 1] without the HDR buffer
+					if (m_Info.pHdrBuffer) m_Info.pHdrBuffer[pixelIdx] = color;
+					else m_Info.pBackBufferPixels[pixelIdx] = ColorUtils::PackColor(color, m_Info.pixelSwizzle);
+					m_Info.SetDepthCode(pixelIdx, furthestDepthCode);
+				}
+			});
 	}
 
-	void SoftwareRenderer::ClearBackground(bool useUniformBackground) const
+	void SoftwareRenderer::ResolveHdrBuffer() const
 	{
-		// Fill the background
-		const Uint8 colorValue{ static_cast<Uint8>((useUniformBackground ? 0.1f : 0.39f) * 255) };
-		SDL_FillRect(m_Info.pBackBuffer, nullptr, SDL_MapRGB(m_Info.pBackBuffer->format, colorValue, colorValue, colorValue));
+		constexpr int nrLanes{ 4 };
+
+		concurrency::parallel_for(0, m_Info.height, [&](int py)
+			{
+				const ColorRGB* pHdrRow{ m_Info.pHdrBuffer + py * m_Info.width };
+				uint32_t* pPixelRow{ m_Info.pBackBufferPixels + py * m_Info.width };
+
+				// Tonemap 4 pixels at once
+				int px{};
+				for (; px + nrLanes <= m_Info.width; px += nrLanes)
+				{
+					if (m_Info.pixelSwizzle == PixelSwizzle::XRGB) ColorUtils::TonemapColors<PixelSwizzle::XRGB>(pHdrRow + px, pPixelRow + px);
+					else ColorUtils::TonemapColors<PixelSwizzle::XBGR>(pHdrRow + px, pPixelRow + px);
+				}
+
+				// The pixels at the end of the row that don't fill 4 lanes
+				for (; px < m_Info.width; ++px)
+				{
+					ColorRGB color{ pHdrRow[px] };
+					color.MaxToOne();
+					pPixelRow[px] = ColorUtils::PackColor(color, m_Info.pixelSwizzle);
+				}
+			});
 	}
 
 	void SoftwareRenderer::ResetDepthBuffer() const
@@ -142,7 +627,437 @@ namespace dae
 		// The nr of pixels in the buffer
 		const int nrPixels{ m_Info.width * m_Info.height };
 
-		// Set everything in the depth buffer to the value FLT_MAX
-		std::fill_n(m_Info.pDepthBuffer, nrPixels, FLT_MAX);
+		// Set everything in the depth buffer to the far plane
+		m_Info.ClearDepth(0, nrPixels);
+	}
+
+	void SoftwareRenderer::RenderShadowMap(const std::vector<Mesh*>& pMeshes, const ShadowInfo& shadow)
+	{
+		m_Info.shadow = shadow;
+
+		// No light casts shadows
+		if (shadow.lightIdx < 0)
+		{
+			m_Info.pShadowMap = nullptr;
+			return;
+		}
+
+		// Everything that isn't covered by a mesh is at the far plane
+		m_ShadowMap.resize(static_cast<size_t>(SHADOW_MAP_SIZE) * SHADOW_MAP_SIZE);
+		std::fill(m_ShadowMap.begin(), m_ShadowMap.end(), 1.0f);
+
+		for (Mesh* pMesh : pMeshes)
+		{
+			pMesh->RenderShadowMap(shadow.lightViewProjectionMatrix, m_ShadowMap.data());
+		}
+
+		m_Info.pShadowMap = m_ShadowMap.data();
+	}
+
+	void SoftwareRenderer::CullLights(const std::vector<Light>& lights, const Camera* pCamera)
+	{
+		const int nrTiles{ m_Info.nrLightTilesX * m_Info.nrLightTilesY };
+
+		// The tiles of every light that is on the screen
+		m_LightTileRanges.clear();
+
+		const Matrix& viewMatrix{ pCamera->GetViewMatrix() };
+		const Matrix& projectionMatrix{ pCamera->GetProjectionMatrix() };
+		const float nearPlane{ pCamera->GetNearPlane() };
+
+		for (uint32_t lightIdx{}; lightIdx < lights.size(); ++lightIdx)
+		{
+			const Light& light{ lights[lightIdx] };
+
+			// The tiles that are touched by this light, directional lights touch every tile
+			int minTileX{ 0 };
+			int minTileY{ 0 };
+			int maxTileX{ m_Info.nrLightTilesX - 1 };
+			int maxTileY{ m_Info.nrLightTilesY - 1 };
+
+			if (light.type != LightType::Directional)
+			{
+				// Transform the sphere of influence of the light to view space
+				const Vector3 viewCenter{ viewMatrix.TransformPoint(light.position) };
+
+				// Skip lights that are completely behind the camera
+				if (viewCenter.z + light.range < nearPlane) continue;
+
+				// Lights that intersect the near plane can touch any tile, else use the screen bounds of the box around the sphere
+				if (viewCenter.z - light.range > nearPlane)
+				{
+					float minX{ FLT_MAX };
+					float minY{ FLT_MAX };
+					float maxX{ -FLT_MAX };
+					float maxY{ -FLT_MAX };
+
+					// Project all the corners of the box around the sphere to the screen
+					for (int cornerIdx{}; cornerIdx < 8; ++cornerIdx)
+					{
+						const float x{ viewCenter.x + ((cornerIdx & 1) ? light.range : -light.range) };
+						const float y{ viewCenter.y + ((cornerIdx & 2) ? light.range : -light.range) };
+						const float z{ viewCenter.z + ((cornerIdx & 4) ? light.range : -light.range) };
+
+						// Calculate the position of the corner in raster space
+						const float screenX{ (x * projectionMatrix[0][0] / z + 1.0f) / 2.0f * m_Info.width };
+						const float screenY{ (1.0f - y * projectionMatrix[1][1] / z) / 2.0f * m_Info.height };
+
+						minX = std::min(minX, screenX);
+						minY = std::min(minY, screenY);
+						maxX = std::max(maxX, screenX);
+						maxY = std::max(maxY, screenY);
+					}
+
+					// Skip lights that are outside the screen
+					if (maxX < 0.0f || maxY < 0.0f || minX >= m_Info.width || minY >= m_Info.height) continue;
+
+					minTileX = std::clamp(static_cast<int>(minX) / LIGHT_TILE_SIZE, 0, m_Info.nrLightTilesX - 1);
+					minTileY = std::clamp(static_cast<int>(minY) / LIGHT_TILE_SIZE, 0, m_Info.nrLightTilesY - 1);
+					maxTileX = std::clamp(static_cast<int>(maxX) / LIGHT_TILE_SIZE, 0, m_Info.nrLightTilesX - 1);
+					maxTileY = std::clamp(static_cast<int>(maxY) / LIGHT_TILE_SIZE, 0, m_Info.nrLightTilesY - 1);
+				}
+			}
+
+			m_LightTileRanges.push_back(LightTileRange{ lightIdx, minTileX, minTileY, maxTileX, maxTileY });
+		}
+
+		// Count the lights of every tile
+		std::fill(m_Info.tileLightOffsets.begin(), m_Info.tileLightOffsets.end(), 0);
+		for (const LightTileRange& range : m_LightTileRanges)
+		{
+			for (int tileY{ range.minTileY }; tileY <= range.maxTileY; ++tileY)
+			{
+				for (int tileX{ range.minTileX }; tileX <= range.maxTileX; ++tileX)
+				{
+					++m_Info.tileLightOffsets[tileX + tileY * m_Info.nrLightTilesX];
+				}
+			}
+		}
+
+		// Sum the counts, the offset of every tile is now the end of its light indices and the last offset is the total
+		for (int tileIdx{ 1 }; tileIdx <= nrTiles; ++tileIdx)
+		{
+			m_Info.tileLightOffsets[tileIdx] += m_Info.tileLightOffsets[tileIdx - 1];
+		}
+		m_Info.tileLightIndices.resize(m_Info.tileLightOffsets[nrTiles]);
+
+		// Fill the light indices from the back, the lights of a tile stay in order and the offsets move back to the start of every tile
+		for (auto rangeIt{ m_LightTileRanges.rbegin() }; rangeIt != m_LightTileRanges.rend(); ++rangeIt)
+		{
+			for (int tileY{ rangeIt->minTileY }; tileY <= rangeIt->maxTileY; ++tileY)
+			{
+				for (int tileX{ rangeIt->minTileX }; tileX <= rangeIt->maxTileX; ++tileX)
+				{
+					m_Info.tileLightIndices[--m_Info.tileLightOffsets[tileX + tileY * m_Info.nrLightTilesX]] = rangeIt->lightIdx;
+				}
+			}
+		}
+
+		m_Info.pLights = lights.data();
+	}
+
+	void SoftwareRenderer::UpdateShadingRates()
+	{
+		switch (m_ShadingRatePolicy)
+		{
+		case ShadingRatePolicy::Off:
+		{
+			std::fill(m_Info.tileShadingRates.begin(), m_Info.tileShadingRates.end(), ShadingRate::Rate1x1);
+			break;
+		}
+		case ShadingRatePolicy::ContentAdaptive:
+		{
+			// The luminance variances below which a tile is shaded at a lower rate
+			constexpr float maxVariance4x4{ 0.0005f };
+			constexpr float maxVariance2x2{ 0.003f };
+
+			for (int tileY{}; tileY < m_Info.nrLightTilesY; ++tileY)
+			{
+				for (int tileX{}; tileX < m_Info.nrLightTilesX; ++tileX)
+				{
+					// Objects move between tiles, so use the highest variance of the tile and its neighbours
+					float variance{};
+					for (int neighbourY{ std::max(tileY - 1, 0) }; neighbourY <= std::min(tileY + 1, m_Info.nrLightTilesY - 1); ++neighbourY)
+					{
+						for (int neighbourX{ std::max(tileX - 1, 0) }; neighbourX <= std::min(tileX + 1, m_Info.nrLightTilesX - 1); ++neighbourX)
+						{
+							variance = std::max(variance, m_TileVariances[neighbourX + neighbourY * m_Info.nrLightTilesX]);
+						}
+					}
+
+					ShadingRate& shadingRate{ m_Info.tileShadingRates[tileX + tileY * m_Info.nrLightTilesX] };
+					if (variance < maxVariance4x4) shadingRate = ShadingRate::Rate4x4;
+					else if (variance < maxVariance2x2) shadingRate = ShadingRate::Rate2x2;
+					else shadingRate = ShadingRate::Rate1x1;
+				}
+			}
+			break;
+		}
+		case ShadingRatePolicy::Foveated:
+		{
+			// The distances from the center (relative to half the screen diagonal) where the shading rate drops
+			constexpr float maxDistance1x1{ 0.35f };
+			constexpr float maxDistance2x2{ 0.7f };
+
+			const Vector2 screenCenter{ m_Info.width / 2.0f, m_Info.height / 2.0f };
+			const float halfDiagonal{ screenCenter.Magnitude() };
+
+			for (int tileY{}; tileY < m_Info.nrLightTilesY; ++tileY)
+			{
+				for (int tileX{}; tileX < m_Info.nrLightTilesX; ++tileX)
+				{
+					// Calculate the distance between the center of the tile and the center of the screen
+					const Vector2 tileCenter{ (tileX + 0.5f) * LIGHT_TILE_SIZE, (tileY + 0.5f) * LIGHT_TILE_SIZE };
+					const float distance{ (tileCenter - screenCenter).Magnitude() / halfDiagonal };
+
+					ShadingRate& shadingRate{ m_Info.tileShadingRates[tileX + tileY * m_Info.nrLightTilesX] };
+					if (distance < maxDistance1x1) shadingRate = ShadingRate::Rate1x1;
+					else if (distance < maxDistance2x2) shadingRate = ShadingRate::Rate2x2;
+					else shadingRate = ShadingRate::Rate4x4;
+				}
+			}
+			break;
+		}
+		}
+	}
+
+	void SoftwareRenderer::MeasureTileVariances()
+	{
+		// Every tile only writes its own variance, so the rows of tiles can be measured in parallel
+		concurrency::parallel_for(0, m_Info.nrLightTilesY, [&](int tileY)
+			{
+				for (int tileX{}; tileX < m_Info.nrLightTilesX; ++tileX)
+				{
+					float luminanceSum{};
+					float squaredLuminanceSum{};
+					int nrPixels{};
+
+					// Sum the luminance of all the pixels in the tile
+					for (int py{ tileY * LIGHT_TILE_SIZE }; py < std::min((tileY + 1) * LIGHT_TILE_SIZE, m_Info.height); ++py)
+					{
+						for (int px{ tileX * LIGHT_TILE_SIZE }; px < std::min((tileX + 1) * LIGHT_TILE_SIZE, m_Info.width); ++px)
+						{
+							const ColorRGB color{ ColorUtils::UnpackColor(m_Info.pBackBufferPixels[px + py * m_Info.width], m_Info.pixelSwizzle) };
+
+							const float luminance{ 0.2126f * color.r + 0.7152f * color.g + 0.0722f * color.b };
+							luminanceSum += luminance;
+							squaredLuminanceSum += luminance * luminance;
+							++nrPixels;
+						}
+					}
+
+					// Variance = E[x^2] - E[x]^2
+					const float mean{ luminanceSum / nrPixels };
+					m_TileVariances[tileX + tileY * m_Info.nrLightTilesX] = squaredLuminanceSum / nrPixels - mean * mean;
+				}
+			});
+	}
+
+	void SoftwareRenderer::UpdateReprojectionBuffers()
+	{
+		// The meshes only use the cache and fill the buffers when the reprojection cache or checkerboard rendering is enabled
+		const bool isCacheNeeded{ m_Info.isReprojectionCacheEnabled || m_Info.isCheckerboardEnabled };
+
+		m_ReprojectionCache.isValid = false;
+		m_Info.pReprojectionCache = isCacheNeeded ? &m_ReprojectionCache : nullptr;
+		m_Info.pTriangleIdBuffer = isCacheNeeded ? m_TriangleIds.data() : nullptr;
+		m_Info.pReuseAgeBuffer = isCacheNeeded ? m_ReuseAges.data() : nullptr;
+	}
+
+	void SoftwareRenderer::UpdateReprojectionCache(const Camera* pCamera)
+	{
+		// The back buffer doesn't hold shaded colors when a debug visualization is active
+		if (m_Info.isShowingDepthBuffer || m_Info.isShowingBoundingBoxes)
+		{
+			m_ReprojectionCache.isValid = false;
+			return;
+		}
+
+		const size_t nrPixels{ static_cast<size_t>(m_Info.width) * m_Info.height };
+
+		// Copy the colors of this frame, the transparent meshes are still blended into the back buffer and the HDR buffer after this
+		if (m_Info.pHdrBuffer) m_ReprojectionCache.hdrColors.assign(m_Info.pHdrBuffer, m_Info.pHdrBuffer + nrPixels);
+		else m_ReprojectionCache.colors.assign(m_Info.pBackBufferPixels, m_Info.pBackBufferPixels + nrPixels);
+
+		// Swap the triangle ids and reuse ages with the buffers of the previous frame instead of copying them
+		// The old values don't have to be cleared, every tile clears its triangle ids and every opaque pixel writes its reuse age
+		m_ReprojectionCache.triangleIds.resize(nrPixels);
+		m_ReprojectionCache.reuseAges.resize(nrPixels);
+		m_ReprojectionCache.triangleIds.swap(m_TriangleIds);
+		m_ReprojectionCache.reuseAges.swap(m_ReuseAges);
+		m_Info.pTriangleIdBuffer = m_TriangleIds.data();
+		m_Info.pReuseAgeBuffer = m_ReuseAges.data();
+
+		// Convert the depth buffer to view space depth so it can be compared with the w of the reprojected positions
+		// depth = A + B / w, so w = B / (depth - A)
+		const Matrix& projectionMatrix{ pCamera->GetProjectionMatrix() };
+		const float depthScale{ projectionMatrix[2][2] };
+		const float depthOffset{ projectionMatrix[3][2] };
+		m_ReprojectionCache.depths.resize(nrPixels);
+		concurrency::parallel_for(0, m_Info.height, [&](int py)
+			{
+				for (int pixelIdx{ py * m_Info.width }; pixelIdx < (py + 1) * m_Info.width; ++pixelIdx)
+				{
+					m_ReprojectionCache.depths[pixelIdx] = depthOffset / (m_Info.GetDepth(pixelIdx) - depthScale);
+				}
+			});
+
+		m_ReprojectionCache.viewProjectionMatrix = pCamera->GetViewMatrix() * projectionMatrix;
+		m_ReprojectionCache.isValid = true;
+	}
+
+	void SoftwareRenderer::ResolveCheckerboard() const
+	{
+		constexpr uint32_t channelMask{ 0xFF };
+
+		concurrency::parallel_for(0, m_Info.height, [&](int py)
+			{
+				for (int px{}; px < m_Info.width; ++px)
+				{
+					const int pixelIdx{ px + py * m_Info.width };
+
+					// Only the covered pixels that couldn't be reprojected have to be filled in
+					if (m_TriangleIds[pixelIdx] == 0 || m_ReuseAges[pixelIdx] != ReprojectionCache::unresolvedAge) continue;
+
+					// The neighbours of a skipped pixel are on the other color of the checkerboard, so most of them are shaded this frame
+					const int neighbourIndices[4]
+					{
+						px > 0 ? pixelIdx - 1 : -1,
+						px < m_Info.width - 1 ? pixelIdx + 1 : -1,
+						py > 0 ? pixelIdx - m_Info.width : -1,
+						py < m_Info.height - 1 ? pixelIdx + m_Info.width : -1
+					};
+
+					uint32_t sums[3]{};
+					ColorRGB hdrSum{ 0.0f, 0.0f, 0.0f, 0.0f };
+					int nrSamples{};
+
+					// Average the neighbours on the same triangle, or all resolved neighbours at the edges of a triangle
+					for (int pass{}; pass < 2 && nrSamples == 0; ++pass)
+					{
+						for (int neighbourIdx : neighbourIndices)
+						{
+							if (neighbourIdx < 0 || (m_ReuseAges[neighbourIdx] == ReprojectionCache::unresolvedAge && m_TriangleIds[neighbourIdx] != 0)) continue;
+							if (pass == 0 && m_TriangleIds[neighbourIdx] != m_TriangleIds[pixelIdx]) continue;
+
+							if (m_Info.pHdrBuffer)
+							{
+								hdrSum += m_Info.pHdrBuffer[neighbourIdx];
+								++nrSamples;
+								continue;
+							}
+
+							const uint32_t neighbourColor{ m_Info.pBackBufferPixels[neighbourIdx] };
+							sums[0] += neighbourColor & channelMask;
+							sums[1] += (neighbourColor >> 8) & channelMask;
+							sums[2] += (neighbourColor >> 16) & channelMask;
+							++nrSamples;
+						}
+					}
+
+					if (nrSamples == 0) continue;
+
+					// The pixel keeps its unresolved age, so the filled in color is not reprojected in the next frame
+					if (m_Info.pHdrBuffer) m_Info.pHdrBuffer[pixelIdx] = hdrSum / static_cast<float>(nrSamples);
+					else m_Info.pBackBufferPixels[pixelIdx] = (sums[0] / nrSamples) | ((sums[1] / nrSamples) << 8) | ((sums[2] / nrSamples) << 16);
+				}
+			});
+	}
+
+	void SoftwareRenderer::CompositeTransparency(bool isUpsampling, const Camera* pCamera) const
+	{
+		// Reduced resolution samples that are this much further or closer (relative to the view depth) get half of their bilinear weight
+		constexpr float depthTolerance{ 0.02f };
+
+		// Convert a depth buffer value to view space depth, depth = A + B / w, so w = B / (depth - A)
+		const Matrix& projectionMatrix{ pCamera->GetProjectionMatrix() };
+		const float depthScale{ projectionMatrix[2][2] };
+		const float depthOffset{ projectionMatrix[3][2] };
+		const auto toViewDepth{ [&](float depth)
+			{
+				// The background is infinitely far away
+				const bool isBackground{ m_Info.isDepthReversed ? depth <= 0.0f : depth >= 1.0f };
+				return isBackground ? FLT_MAX : depthOffset / (depth - depthScale);
+			} };
+
+		const int downscale{ static_cast<int>(m_TransparencyResolution) };
+		const int lowWidth{ m_TransparencyInfo.width };
+		const int lowHeight{ m_TransparencyInfo.height };
+
+		concurrency::parallel_for(0, m_Info.height, [&](int py)
+			{
+				for (int px{}; px < m_Info.width; ++px)
+				{
+					const int pixelIdx{ px + py * m_Info.width };
+
+					ColorRGB accumulation{ 0.0f, 0.0f, 0.0f, 0.0f };
+					float revealage{};
+
+					if (!isUpsampling)
+					{
+						accumulation = m_TransparencyAccumulation[pixelIdx];
+						revealage = m_TransparencyRevealage[pixelIdx];
+					}
+					else
+					{
+						// The four reduced resolution samples around the center of this pixel, the samples are at the centers of the reduced resolution pixels
+						const float lowX{ std::max((px + 0.5f) / downscale - 0.5f, 0.0f) };
+						const float lowY{ std::max((py + 0.5f) / downscale - 0.5f, 0.0f) };
+						const int lowX0{ static_cast<int>(lowX) };
+						const int lowY0{ static_cast<int>(lowY) };
+						const int lowX1{ std::min(lowX0 + 1, lowWidth - 1) };
+						const int lowY1{ std::min(lowY0 + 1, lowHeight - 1) };
+						const float fractionX{ lowX - lowX0 };
+						const float fractionY{ lowY - lowY0 };
+
+						const int sampleIndices[4]{ lowX0 + lowY0 * lowWidth, lowX1 + lowY0 * lowWidth, lowX0 + lowY1 * lowWidth, lowX1 + lowY1 * lowWidth };
+						const float bilinearWeights[4]{ (1.0f - fractionX) * (1.0f - fractionY), fractionX * (1.0f - fractionY), (1.0f - fractionX) * fractionY, fractionX * fractionY };
+
+						// Pixels without transparent surfaces around them keep the opaque color
+						if (m_TransparencyRevealage[sampleIndices[0]] >= 1.0f && m_TransparencyRevealage[sampleIndices[1]] >= 1.0f &&
+							m_TransparencyRevealage[sampleIndices[2]] >= 1.0f && m_TransparencyRevealage[sampleIndices[3]] >= 1.0f) continue;
+
+						// Samples of the same surface as this pixel get the most weight, so the transparent colors don't bleed over depth edges
+						const float viewDepth{ toViewDepth(m_Info.GetDepth(pixelIdx)) };
+						float weights[4]{};
+						float weightSum{};
+						for (int sampleIdx{}; sampleIdx < 4; ++sampleIdx)
+						{
+							const float sampleViewDepth{ toViewDepth(m_TransparencyInfo.GetDepth(sampleIndices[sampleIdx])) };
+							const float depthDifference{ abs(sampleViewDepth - viewDepth) / std::min(sampleViewDepth, viewDepth) };
+							weights[sampleIdx] = bilinearWeights[sampleIdx] / (1.0f + depthDifference / depthTolerance);
+							weightSum += weights[sampleIdx];
+						}
+
+						// Fall back to plain bilinear filtering when no sample is on the same surface
+						const float* pWeights{ weightSum > FLT_EPSILON ? weights : bilinearWeights };
+						if (weightSum <= FLT_EPSILON) weightSum = 1.0f;
+
+						for (int sampleIdx{}; sampleIdx < 4; ++sampleIdx)
+						{
+							const float weight{ pWeights[sampleIdx] / weightSum };
+							const ColorRGB& sampleAccumulation{ m_TransparencyAccumulation[sampleIndices[sampleIdx]] };
+							accumulation.r += sampleAccumulation.r * weight;
+							accumulation.g += sampleAccumulation.g * weight;
+							accumulation.b += sampleAccumulation.b * weight;
+							accumulation.a += sampleAccumulation.a * weight;
+							revealage += m_TransparencyRevealage[sampleIndices[sampleIdx]] * weight;
+						}
+					}
+
+					// Pixels without transparent surfaces keep the opaque color
+					if (revealage >= 1.0f) continue;
+
+					// The weighted average of all the transparent colors covers the part of the background that is not revealed
+					const float totalWeight{ std::max(accumulation.a, 1e-5f) };
+					const ColorRGB averageColor{ accumulation.r / totalWeight, accumulation.g / totalWeight, accumulation.b / totalWeight };
+
+					// Get the background color
+					const ColorRGB backgroundColor{ ColorUtils::ReadColor(m_Info, pixelIdx) };
+
+					// Blend the transparent color over the background
+					ColorUtils::WriteColor(m_Info, pixelIdx, averageColor * (1.0f - revealage) + backgroundColor * revealage);
+				}
+			});
 	}
 }
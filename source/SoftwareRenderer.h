@@ -2,41 +2,125 @@
 
 #include <vector>
 #include "DataTypes.h"
+#include "DynamicResolution.h"
 
 namespace dae
 {
 	class Mesh;
 	class Camera;
 	class Texture;
+	class PresentQueue;
+	class FrameCapture;
 
 	class SoftwareRenderer
 	{
 	public:
 		SoftwareRenderer(SDL_Window* pWindow);
-		~SoftwareRenderer() = default;
+		~SoftwareRenderer();
 
 		SoftwareRenderer(const SoftwareRenderer&) = delete;
 		SoftwareRenderer(SoftwareRenderer&&) noexcept = delete;
 		SoftwareRenderer& operator=(const SoftwareRenderer&) = delete;
 		SoftwareRenderer& operator=(SoftwareRenderer&&) noexcept = delete;
 
-		void Render(const std::vector<Mesh*>& pMeshes, Camera* pCamera, bool useUniformBackground) const;
+		void Render(const std::vector<Mesh*>& pMeshes, const std::vector<Light>& lights, const ShadowInfo& shadow, Camera* pCamera, bool useUniformBackground);
 		void ToggleShowingDepthBuffer();
 		void ToggleShowingBoundingBoxes();
 		void ToggleLightingMode();
 		void ToggleNormalMap();
+		void ToggleShadingRatePolicy();
+		void ToggleDynamicResolution();
+		void ToggleReprojectionCache();
+		void ToggleCheckerboard();
+		void ToggleOrderIndependentTransparency();
+		void ToggleHdrBuffer();
+		void CyclePresentQueueDepth();
+		void CycleFrameCapture();
+		void CycleDepthFormat();
+		// Waits until the window shows every rendered frame
+		void FlushPresentQueue() const;
 		void SetCullMode(CullMode cullMode);
-
-		bool SaveBufferToImage() const;
+		void SetTransparencyResolution(TransparencyResolution transparencyResolution);
+		void SetMultisampling(bool isEnabled);
 
 	private:
 		SDL_Window* m_pWindow{};
 
 		SoftwareRenderInfo m_Info{};
 
+		// The size of the window, the render info contains the size that is rendered at
+		int m_WindowWidth{};
+		int m_WindowHeight{};
+		// Shows the finished frames in the window on its own thread and owns the back buffers
+		PresentQueue* m_pPresentQueue{};
+		// Writes the finished frames to disk on its own thread
+		FrameCapture* m_pFrameCapture{};
+
+		bool m_IsDynamicResolutionEnabled{};
+		// Aim for 60 frames per second with a render resolution between half and full size
+		DynamicResolution m_DynamicResolution{ 1.0f / 60.0f, 0.5f, 1.0f };
+
+		ReprojectionCache m_ReprojectionCache{};
+		// The triangle ids and reuse ages of the frame that is being rendered
+		std::vector<uint32_t> m_TriangleIds{};
+		std::vector<uint8_t> m_ReuseAges{};
+
+		// The depth of the scene seen from the shadow casting light
+		std::vector<float> m_ShadowMap{};
+
+		// The range of light tiles that a light touches
+		struct LightTileRange
+		{
+			uint32_t lightIdx{};
+			int minTileX{};
+			int minTileY{};
+			int maxTileX{};
+			int maxTileY{};
+		};
+		// The lights on the screen this frame, kept between frames so culling the lights doesn't allocate
+		std::vector<LightTileRange> m_LightTileRanges{};
+
+		// Blend the transparent meshes with weighted blended order independent transparency instead of in triangle order
+		bool m_IsOrderIndependentTransparencyEnabled{ true };
+		std::vector<ColorRGB> m_TransparencyAccumulation{};
+		std::vector<float> m_TransparencyRevealage{};
+		// Reduced transparency resolutions render into the first part of the transparency buffers and are upsampled while compositing
+		// The render info of that pass has its own size and a depth buffer that holds the downsampled depth of the opaque meshes
+		TransparencyResolution m_TransparencyResolution{ TransparencyResolution::Full };
+		SoftwareRenderInfo m_TransparencyInfo{};
+
+		// Shade and blend into linear float colors that are tonemapped into the back buffer at the end of the frame
+		bool m_IsHdrEnabled{};
+		std::vector<ColorRGB> m_HdrBuffer{};
+
+		// Render the opaque meshes with MSAA_SAMPLE_COUNT depths and colors per pixel, the buffers are only allocated while multisampling is enabled
+		bool m_IsMultisamplingEnabled{};
+		std::vector<uint32_t> m_SampleDepths{};
+		std::vector<ColorRGB> m_SampleColors{};
+
 		CullMode m_CullMode{ CullMode::Back };
 
-		void ClearBackground(bool useUniformBackground) const;
+		ShadingRatePolicy m_ShadingRatePolicy{ ShadingRatePolicy::Off };
+		// The luminance variance of every tile in the previous frame
+		std::vector<float> m_TileVariances{};
+
+		void Resize(int width, int height);
+		void AcquireBackBuffer();
+		void ClearBackground(bool useUniformBackground);
+		void ResolveTileClears() const;
+		void UpdateSampleBuffers();
+		void ResolveSamples() const;
 		void ResetDepthBuffer() const;
+		void RenderShadowMap(const std::vector<Mesh*>& pMeshes, const ShadowInfo& shadow);
+		void CullLights(const std::vector<Light>& lights, const Camera* pCamera);
+		void UpdateShadingRates();
+		void MeasureTileVariances();
+		void UpdateReprojectionBuffers();
+		void UpdateReprojectionCache(const Camera* pCamera);
+		void ResolveCheckerboard() const;
+		void ResizeTransparencyBuffers();
+		void DownsampleDepthBuffer() const;
+		void CompositeTransparency(bool isUpsampling, const Camera* pCamera) const;
+		void ResolveHdrBuffer() const;
 	};
 }
@@ -0,0 +1,188 @@
+#include "pch.h"
+#include "Tests.h"
+#include "LightingKernels.h"
+#include "Utils.h"
+#include <random>
+
+namespace dae
+{
+	namespace Tests
+	{
+		int TestFastPow()
+		{
+			// FastPow calculates 4 lanes at once
+			constexpr int fastPowWidth{ 4 };
+
+			// Use a fixed seed so a mismatch can be reproduced
+			std::mt19937 generator{ 1337 };
+			std::uniform_real_distribution<float> unitDistribution{ 0.0f, 1.0f };
+
+			// FastPow should stay within its documented relative error for every base in [0, 1] and the exponents used by Phong
+			// Results below this are too small to show up in an 8 bit color, so only their absolute error is checked
+			constexpr float maxPowRelativeError{ 2e-4f };
+			constexpr float minRelativeResult{ 1e-6f };
+			constexpr float maxSpecularShininess{ 25.0f };
+			constexpr int nrPowSamples{ 4096 };
+
+			int nrFailures{};
+			for (int sampleIdx{}; sampleIdx < nrPowSamples; sampleIdx += fastPowWidth)
+			{
+				float bases[fastPowWidth]{};
+				float exponents[fastPowWidth]{};
+				for (int lane{}; lane < fastPowWidth; ++lane)
+				{
+					// Sweep the bases evenly, including 0 and 1
+					bases[lane] = static_cast<float>(sampleIdx + lane) / (nrPowSamples - 1);
+					exponents[lane] = unitDistribution(generator) * maxSpecularShininess;
+				}
+
+				float results[fastPowWidth]{};
+				LightingKernels::FastPow(bases, exponents, results);
+
+				for (int lane{}; lane < fastPowWidth; ++lane)
+				{
+					const float expected{ powf(bases[lane], exponents[lane]) };
+					const float error{ std::abs(results[lane] - expected) };
+					const bool isMatch{ expected < minRelativeResult ? error <= minRelativeResult : error <= expected * maxPowRelativeError };
+
+					if (!isMatch)
+					{
+						std::cout << "FastPow(" << bases[lane] << ", " << exponents[lane] << ") is " << results[lane] << " instead of " << expected << "\n";
+						++nrFailures;
+					}
+				}
+			}
+			return nrFailures;
+		}
+
+		int TestShade()
+		{
+			// Use a fixed seed so a mismatch can be reproduced
+			std::mt19937 generator{ 1337 };
+			std::uniform_real_distribution<float> unitDistribution{ 0.0f, 1.0f };
+			std::uniform_real_distribution<float> signedDistribution{ -1.0f, 1.0f };
+
+			// The shininess of the vehicle material
+			constexpr float specularShininess{ 25.0f };
+
+			// Shade should match the scalar lighting of Mesh::PixelShading, within a fraction of an 8 bit color step
+			constexpr float maxColorError{ 0.25f / 255.0f };
+			constexpr int nrShadeBatches{ 64 };
+
+			// One light of every type
+			std::vector<Light> lights(3);
+			lights[0].type = LightType::Directional;
+			lights[0].direction = Vector3{ 0.577f, -0.577f, 0.577f }.Normalized();
+			lights[0].intensity = 7.0f;
+			lights[1].type = LightType::Point;
+			lights[1].position = Vector3{ 1.0f, 2.0f, -1.0f };
+			lights[1].color = ColorRGB{ 1.0f, 0.5f, 0.25f };
+			lights[1].intensity = 3.0f;
+			lights[1].range = 5.0f;
+			lights[2].type = LightType::Spot;
+			lights[2].position = Vector3{ -1.0f, 2.0f, 0.0f };
+			lights[2].direction = Vector3{ 0.2f, -1.0f, 0.1f }.Normalized();
+			lights[2].color = ColorRGB{ 0.25f, 0.5f, 1.0f };
+			lights[2].intensity = 5.0f;
+			lights[2].range = 8.0f;
+			const uint32_t lightIndices[]{ 0, 1, 2 };
+
+			LightingParameters lighting{};
+			lighting.pLights = lights.data();
+			lighting.pLightIndices = lightIndices;
+			lighting.nrLights = static_cast<int>(lights.size());
+			lighting.specularShininess = specularShininess;
+			lighting.ambientColor = ColorRGB{ 0.025f, 0.025f, 0.025f };
+
+			int nrFailures{};
+			for (const LightingMode lightingMode : { LightingMode::Combined, LightingMode::ObservedArea, LightingMode::Diffuse, LightingMode::Specular })
+			{
+				for (int batchIdx{}; batchIdx < nrShadeBatches; ++batchIdx)
+				{
+					ShadingBatch batch{};
+					ColorBatch diffuse{};
+					ColorBatch specular{};
+					ColorBatch glossiness{};
+					for (int lane{}; lane < SHADING_BATCH_WIDTH; ++lane)
+					{
+						const Vector3 normal{ Vector3{ signedDistribution(generator), signedDistribution(generator), signedDistribution(generator) }.Normalized() };
+						const Vector3 viewDirection{ Vector3{ signedDistribution(generator), signedDistribution(generator), signedDistribution(generator) }.Normalized() };
+
+						batch.normalX[lane] = normal.x;
+						batch.normalY[lane] = normal.y;
+						batch.normalZ[lane] = normal.z;
+						batch.viewDirectionX[lane] = viewDirection.x;
+						batch.viewDirectionY[lane] = viewDirection.y;
+						batch.viewDirectionZ[lane] = viewDirection.z;
+						batch.worldPositionX[lane] = signedDistribution(generator) * 2.0f;
+						batch.worldPositionY[lane] = signedDistribution(generator) * 2.0f;
+						batch.worldPositionZ[lane] = signedDistribution(generator) * 2.0f;
+
+						diffuse.r[lane] = unitDistribution(generator);
+						diffuse.g[lane] = unitDistribution(generator);
+						diffuse.b[lane] = unitDistribution(generator);
+						specular.r[lane] = specular.g[lane] = specular.b[lane] = unitDistribution(generator);
+						glossiness.r[lane] = glossiness.g[lane] = glossiness.b[lane] = unitDistribution(generator);
+					}
+
+					ColorBatch colors{};
+					LightingKernels::Shade(batch, diffuse, specular, glossiness, lightingMode, lighting, colors);
+
+					for (int lane{}; lane < SHADING_BATCH_WIDTH; ++lane)
+					{
+						const Vector3 normal{ batch.normalX[lane], batch.normalY[lane], batch.normalZ[lane] };
+						const Vector3 viewDirection{ batch.viewDirectionX[lane], batch.viewDirectionY[lane], batch.viewDirectionZ[lane] };
+						const Vector3 position{ batch.worldPositionX[lane], batch.worldPositionY[lane], batch.worldPositionZ[lane] };
+						const ColorRGB diffuseColor{ diffuse.r[lane], diffuse.g[lane], diffuse.b[lane] };
+						const ColorRGB specularColor{ specular.r[lane], specular.g[lane], specular.b[lane] };
+						const float specularExp{ lighting.specularShininess * glossiness.r[lane] };
+
+						// The scalar lighting of Mesh::PixelShading
+						ColorRGB expected{ 0.0f, 0.0f, 0.0f };
+						for (const Light& light : lights)
+						{
+							Vector3 toLight{};
+							const float lightFalloff{ LightingUtils::CalculateLightFalloff(light, position, toLight) };
+							const float observedArea{ Vector3::DotClamped(normal, toLight) * lightFalloff };
+
+							switch (lightingMode)
+							{
+							case LightingMode::Combined:
+								expected += light.color * ((light.intensity * LightingUtils::Lambert(diffuseColor)) * observedArea
+									+ specularColor * LightingUtils::Phong(specularExp, toLight, viewDirection, normal) * lightFalloff);
+								break;
+							case LightingMode::ObservedArea:
+								expected += ColorRGB{ observedArea, observedArea, observedArea };
+								break;
+							case LightingMode::Diffuse:
+								expected += light.color * (light.intensity * LightingUtils::Lambert(diffuseColor) * observedArea);
+								break;
+							case LightingMode::Specular:
+								expected += light.color * specularColor * LightingUtils::Phong(specularExp, toLight, viewDirection, normal) * lightFalloff;
+								break;
+							}
+						}
+						if (lightingMode == LightingMode::Combined) expected += lighting.ambientColor;
+						expected.MaxToOne();
+
+						const bool isMatch
+						{
+							std::abs(colors.r[lane] - expected.r) <= maxColorError &&
+							std::abs(colors.g[lane] - expected.g) <= maxColorError &&
+							std::abs(colors.b[lane] - expected.b) <= maxColorError
+						};
+
+						if (!isMatch)
+						{
+							std::cout << "Shade doesn't match the scalar lighting in lighting mode " << static_cast<int>(lightingMode) << ": ("
+								<< colors.r[lane] << ", " << colors.g[lane] << ", " << colors.b[lane] << ") instead of ("
+								<< expected.r << ", " << expected.g << ", " << expected.b << ")\n";
+							++nrFailures;
+						}
+					}
+				}
+			}
+			return nrFailures;
+		}
+	}
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+namespace dae
+{
+	// The tests of the test target, every test prints the checks that fail and returns the amount of failed checks
+	namespace Tests
+	{
+		// Compares Texture::SampleRGBBatch lane by lane with Texture::SampleRGB
+		int TestSampleRGBBatch(ID3D11Device* pDevice);
+		// Compares LightingKernels::FastPow with powf
+		int TestFastPow();
+		// Compares LightingKernels::Shade with the scalar lighting of LightingUtils for every lighting mode
+		int TestShade();
+	}
+}
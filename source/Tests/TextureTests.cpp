@@ -0,0 +1,117 @@
+#include "pch.h"
+#include "Tests.h"
+#include "Texture.h"
+#include <random>
+
+namespace dae
+{
+	namespace Tests
+	{
+		// Compares the batch with the scalar samples of the texture for random uvs, lane masks and mip levels
+		static int CompareSampleRGBBatch(const Texture* pTexture, const std::string& name)
+		{
+			// The amount of random batches that are compared
+			constexpr int nrBatches{ 64 };
+			// SampleRGB divides by 255 while the batch multiplies by 1/255
+			constexpr float maxDifference{ 1e-6f };
+
+			// Use a fixed seed so a mismatch can be reproduced
+			std::mt19937 generator{ 1337 };
+			// Include uvs outside of [0, 1] to test the clamping
+			std::uniform_real_distribution<float> uvDistribution{ -0.25f, 1.25f };
+			std::uniform_int_distribution<uint32_t> maskDistribution{ 0, (1u << TEXTURE_BATCH_WIDTH) - 1 };
+			std::uniform_int_distribution<int> mipDistribution{ 0, pTexture->GetNrCPUMips() - 1 };
+
+			int nrFailures{};
+			for (int batchIdx{}; batchIdx < nrBatches; ++batchIdx)
+			{
+				alignas(16) float u[TEXTURE_BATCH_WIDTH]{};
+				alignas(16) float v[TEXTURE_BATCH_WIDTH]{};
+				int mips[TEXTURE_BATCH_WIDTH]{};
+				for (int lane{}; lane < TEXTURE_BATCH_WIDTH; ++lane)
+				{
+					u[lane] = uvDistribution(generator);
+					v[lane] = uvDistribution(generator);
+					mips[lane] = mipDistribution(generator);
+				}
+
+				// The first batch tests the edges of the uv range, where the texel coordinate has to be clamped to the last texel
+				if (batchIdx == 0)
+				{
+					u[0] = 0.0f; v[0] = 0.0f;
+					u[1] = 1.0f; v[1] = 1.0f;
+					u[2] = 0.0f; v[2] = 1.0f;
+					u[3] = 1.0f; v[3] = 0.0f;
+				}
+
+				const uint32_t activeMask{ batchIdx == 0 ? (1u << TEXTURE_BATCH_WIDTH) - 1 : maskDistribution(generator) };
+
+				// Half of the batches sample the first level without giving mip levels
+				const bool isMipGiven{ batchIdx % 2 == 1 };
+
+				ColorBatch colors{};
+				pTexture->SampleRGBBatch(u, v, activeMask, colors, isMipGiven ? mips : nullptr);
+
+				for (int lane{}; lane < TEXTURE_BATCH_WIDTH; ++lane)
+				{
+					// Inactive lanes are black, active lanes have to match the scalar sample
+					const bool isActive{ (activeMask & (1u << lane)) != 0 };
+					const int mip{ isMipGiven ? mips[lane] : 0 };
+					const ColorRGB expected{ isActive ? pTexture->SampleRGB(Vector2{ u[lane], v[lane] }, mip) : ColorRGB{ 0.0f, 0.0f, 0.0f, 0.0f } };
+
+					const bool isMatch
+					{
+						std::abs(colors.r[lane] - expected.r) <= maxDifference &&
+						std::abs(colors.g[lane] - expected.g) <= maxDifference &&
+						std::abs(colors.b[lane] - expected.b) <= maxDifference &&
+						std::abs(colors.a[lane] - expected.a) <= maxDifference
+					};
+
+					if (!isMatch)
+					{
+						std::cout << "SampleRGBBatch doesn't match SampleRGB for " << name << " at uv (" << u[lane] << ", " << v[lane] << ") and mip " << mip << "\n";
+						++nrFailures;
+					}
+				}
+			}
+			return nrFailures;
+		}
+
+		int TestSampleRGBBatch(ID3D11Device* pDevice)
+		{
+			int nrFailures{};
+
+			// Textures with a texture cache, these have CPU-side mip levels, the fire texture also has alpha
+			for (const std::string& path : { "Resources/vehicle_diffuse.png", "Resources/fireFX_diffuse.png" })
+			{
+				Texture* pTexture{ Texture::LoadFromFile(pDevice, path, Texture::TextureType::Diffuse) };
+				if (!pTexture->HasCPUData())
+				{
+					std::cout << "Failed to load " << path << " for the SampleRGBBatch test\n";
+					++nrFailures;
+				}
+				else
+				{
+					nrFailures += CompareSampleRGBBatch(pTexture, path);
+				}
+				delete pTexture;
+			}
+
+			// A texture without a file only has the first level on the CPU, use a size that isn't a power of two
+			constexpr int width{ 37 };
+			constexpr int height{ 19 };
+			std::vector<uint32_t> texels(width * height);
+			std::mt19937 generator{ 1337 };
+			for (uint32_t& texel : texels)
+			{
+				texel = generator();
+			}
+
+			Texture* pTexture{ Texture::CreateFromTexels(pDevice, width, height, texels, Texture::TextureType::Diffuse) };
+			nrFailures += CompareSampleRGBBatch(pTexture, "the texel texture");
+			delete pTexture;
+
+			return nrFailures;
+		}
+	}
+}
@@ -0,0 +1,41 @@
+#include "pch.h"
+
+#undef main
+#include "Tests.h"
+
+using namespace dae;
+
+// Runs every test, the exit code is the amount of failed checks so a failing run can be detected by scripts
+// The tests load the textures from the Resources folder, so the working directory should be the source folder
+int main(int argc, char* args[])
+{
+	//Unreferenced parameters
+	(void)argc;
+	(void)args;
+
+	// The textures need a device for their hardware resources, WARP works without a graphics card
+	ID3D11Device* pDevice{};
+	const HRESULT result{ D3D11CreateDevice(nullptr, D3D_DRIVER_TYPE_WARP, nullptr, 0, nullptr, 0, D3D11_SDK_VERSION, &pDevice, nullptr, nullptr) };
+	if (FAILED(result))
+	{
+		std::cout << "Failed to create a device for the tests\n";
+		return 1;
+	}
+
+	int nrFailures{};
+	nrFailures += Tests::TestSampleRGBBatch(pDevice);
+	nrFailures += Tests::TestFastPow();
+	nrFailures += Tests::TestShade();
+
+	pDevice->Release();
+
+	if (nrFailures == 0)
+	{
+		std::cout << "All tests passed\n";
+	}
+	else
+	{
+		std::cout << nrFailures << " checks failed\n";
+	}
+	return nrFailures;
+}
@@ -1,22 +1,107 @@
 #include "pch.h"
 #include "Texture.h"
 #include "Vector2.h"
+#include "TextureCache.h"
+#include "DDSImage.h"
+#include "AlphaCoverage.h"
 #include <SDL_image.h>
 #include <algorithm>
+#include <immintrin.h>
 
 namespace dae
 {
-	Texture::Texture(ID3D11Device* pDevice, SDL_Surface* pSurface, TextureType type)
-		: m_pSurface{ pSurface }
-		, m_pSurfacePixels{ static_cast<uint32_t*>(pSurface->pixels) }
+	Texture::Texture(ID3D11Device* pDevice, const std::string& path, TextureType type)
+		: m_Path{ path }
 		, m_Type{ type }
 	{
+		// Load the texels on the CPU, these are needed to create the hardware texture
+		if (!LoadCPUData())
+		{
+			std::cout << "Failed to load texture from " << path << "\n";
+			return;
+		}
+
+		// Create the texture resource
+		if (m_pDDSImage)
+		{
+			// Upload the compressed blocks as they are
+			const std::vector<D3D11_SUBRESOURCE_DATA> initData{ m_pDDSImage->GetInitData() };
+			CreateResource(pDevice, m_pDDSImage->GetFormat(), initData);
+		}
+		else if (m_pCache)
+		{
+			// Create intialize data for every mip level, pointing directly to the mapped texels
+			std::vector<D3D11_SUBRESOURCE_DATA> initData(m_pCache->GetNrMips());
+			for (int mip{}; mip < m_pCache->GetNrMips(); ++mip)
+			{
+				const UINT mipPitch{ static_cast<UINT>(m_pCache->GetMipWidth(mip) * sizeof(uint32_t)) };
+
+				initData[mip].pSysMem = m_pCache->GetMipTexels(mip);
+				initData[mip].SysMemPitch = mipPitch;
+				initData[mip].SysMemSlicePitch = mipPitch * m_pCache->GetMipHeight(mip);
+			}
+
+			CreateResource(pDevice, DXGI_FORMAT_R8G8B8A8_UNORM, initData);
+		}
+		else
+		{
+			// Create intialize data for subresource
+			std::vector<D3D11_SUBRESOURCE_DATA> initData(1);
+			initData[0].pSysMem = m_pSurface->pixels;
+			initData[0].SysMemPitch = static_cast<UINT>(m_pSurface->pitch);
+			initData[0].SysMemSlicePitch = static_cast<UINT>(m_pSurface->h * m_pSurface->pitch);
+
+			CreateResource(pDevice, DXGI_FORMAT_R8G8B8A8_UNORM, initData);
+		}
+	}
+
+	Texture::Texture(ID3D11Device* pDevice, int width, int height, const std::vector<uint32_t>& texels, TextureType type)
+		: m_Width{ width }
+		, m_Height{ height }
+		, m_Type{ type }
+	{
+		// Copy the texels into a surface for the software rasterizer
+		m_pSurface = SDL_CreateRGBSurfaceWithFormat(0, width, height, 32, SDL_PIXELFORMAT_RGBA32);
+		if (!m_pSurface)
+		{
+			std::cout << "Failed to create a " << width << "x" << height << " texture\n";
+			return;
+		}
+
+		for (int y{}; y < height; ++y)
+		{
+			memcpy(static_cast<uint8_t*>(m_pSurface->pixels) + y * m_pSurface->pitch, texels.data() + y * width, width * sizeof(uint32_t));
+		}
+
+		m_pSurfacePixels = static_cast<uint32_t*>(m_pSurface->pixels);
+		m_pTexelFormat = m_pSurface->format;
+
+		// The hardware rasterizer samples with mip filtering, so create the full mip chain for the texture resource
+		const std::vector<std::vector<uint32_t>> mips{ TextureCache::CreateMipChain(texels, width, height) };
+
+		// Create intialize data for every mip level
+		std::vector<D3D11_SUBRESOURCE_DATA> initData(mips.size());
+		for (size_t mip{}; mip < mips.size(); ++mip)
+		{
+			const UINT mipPitch{ static_cast<UINT>(std::max(width >> mip, 1) * sizeof(uint32_t)) };
+
+			initData[mip].pSysMem = mips[mip].data();
+			initData[mip].SysMemPitch = mipPitch;
+			initData[mip].SysMemSlicePitch = mipPitch * std::max(height >> mip, 1);
+		}
+
+		CreateResource(pDevice, DXGI_FORMAT_R8G8B8A8_UNORM, initData);
+	}
+
+	void Texture::CreateResource(ID3D11Device* pDevice, DXGI_FORMAT format, const std::vector<D3D11_SUBRESOURCE_DATA>& initData)
+	{
+		const UINT nrMips{ static_cast<UINT>(initData.size()) };
+
 		// Create the texture description
-		constexpr DXGI_FORMAT format{ DXGI_FORMAT_R8G8B8A8_UNORM };
 		D3D11_TEXTURE2D_DESC desc{};
-		desc.Width = pSurface->w;
-		desc.Height = pSurface->h;
-		desc.MipLevels = 1;
+		desc.Width = m_Width;
+		desc.Height = m_Height;
+		desc.MipLevels = nrMips;
 		desc.ArraySize = 1;
 		desc.Format = format;
 		desc.SampleDesc.Count = 1;
@@ -26,21 +111,21 @@ namespace dae
 		desc.CPUAccessFlags = 0;
 		desc.MiscFlags = 0;
 
-		// Create intialize data for subresource
-		D3D11_SUBRESOURCE_DATA initData{};
-		initData.pSysMem = pSurface->pixels;
-		initData.SysMemPitch = static_cast<UINT>(pSurface->pitch);
-		initData.SysMemSlicePitch = static_cast<UINT>(pSurface->h * pSurface->pitch);
-
 		// Create the texture resource
-		HRESULT hr = pDevice->CreateTexture2D(&desc, &initData, &m_pResource);
+		HRESULT hr = pDevice->CreateTexture2D(&desc, initData.data(), &m_pResource);
 		if (FAILED(hr)) return;
 
+		// The texture takes up as much video memory as the data it was created with
+		for (const D3D11_SUBRESOURCE_DATA& mipData : initData)
+		{
+			m_GPUMemorySize += mipData.SysMemSlicePitch;
+		}
+
 		// Create the shader resource view description
 		D3D11_SHADER_RESOURCE_VIEW_DESC SRVDesc{};
 		SRVDesc.Format = format;
 		SRVDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
-		SRVDesc.Texture2D.MipLevels = 1;
+		SRVDesc.Texture2D.MipLevels = nrMips;
 
 		// Create the shader resource view
 		hr = pDevice->CreateShaderResourceView(m_pResource, &SRVDesc, &m_pSRV);
@@ -49,7 +134,8 @@ namespace dae
 
 	Texture::~Texture()
 	{
-		if (m_pSurface) SDL_FreeSurface(m_pSurface);
+		ReleaseCPUData();
+		delete m_pAlphaCoverage;
 
 		if (m_pResource) m_pResource->Release();
 		if (m_pSRV) m_pSRV->Release();
@@ -57,12 +143,168 @@ namespace dae
 
 	Texture* Texture::LoadFromFile(ID3D11Device* pDevice, const std::string& path, TextureType type)
 	{
-		//Load SDL_Surface using IMG_LOAD
-		//Create & Return a new Texture Object (using SDL_Surface)
-		return new Texture{ pDevice, IMG_Load(path.c_str()), type };
+		return new Texture{ pDevice, path, type };
+	}
+
+	Texture* Texture::CreateFromTexels(ID3D11Device* pDevice, int width, int height, const std::vector<uint32_t>& texels, TextureType type)
+	{
+		return new Texture{ pDevice, width, height, texels, type };
 	}
 
-	ColorRGB Texture::SampleRGB(const Vector2& uv) const
+	bool Texture::LoadCPUData()
+	{
+		if (HasCPUData()) return true;
+
+		// Textures that were not loaded from a file can't be reloaded
+		if (m_Path.empty()) return false;
+
+		// Use a block-compressed DDS file with the same name when one exists
+		const size_t extensionStart{ m_Path.find_last_of('.') };
+		m_pDDSImage = DDSImage::LoadFromFile(m_Path.substr(0, extensionStart) + ".dds");
+		if (m_pDDSImage)
+		{
+			// The decoded texels of DDS images are always RGBA32
+			m_pTexelFormat = SDL_AllocFormat(SDL_PIXELFORMAT_RGBA32);
+			m_Width = m_pDDSImage->GetWidth();
+			m_Height = m_pDDSImage->GetHeight();
+			BuildAlphaCoverage();
+			return true;
+		}
+
+		// Use the pre-decoded texels of the texture cache when possible
+		m_pCache = TextureCache::Open(m_Path);
+		if (m_pCache)
+		{
+			// Wrap the mapped texels of the first mip level in a surface for the software rasterizer (no copy is made)
+			m_pSurface = SDL_CreateRGBSurfaceWithFormatFrom(const_cast<uint32_t*>(m_pCache->GetMipTexels(0)),
+				m_pCache->GetWidth(), m_pCache->GetHeight(), 32, m_pCache->GetWidth() * static_cast<int>(sizeof(uint32_t)), SDL_PIXELFORMAT_RGBA32);
+		}
+		else
+		{
+			//Load SDL_Surface using IMG_LOAD
+			m_pSurface = IMG_Load(m_Path.c_str());
+		}
+
+		if (!m_pSurface)
+		{
+			ReleaseCPUData();
+			return false;
+		}
+
+		m_pSurfacePixels = static_cast<uint32_t*>(m_pSurface->pixels);
+		m_pTexelFormat = m_pSurface->format;
+		m_Width = m_pSurface->w;
+		m_Height = m_pSurface->h;
+		BuildAlphaCoverage();
+		return true;
+	}
+
+	void Texture::BuildAlphaCoverage()
+	{
+		// Only the alpha of diffuse textures is used, and the hierarchy is only built the first time the texels are loaded
+		if (m_Type != TextureType::Diffuse || m_pAlphaCoverage) return;
+
+		std::vector<uint8_t> alphas(static_cast<size_t>(m_Width) * m_Height);
+		for (int y{}; y < m_Height; ++y)
+		{
+			for (int x{}; x < m_Width; ++x)
+			{
+				Uint8 r{}, g{}, b{};
+				SDL_GetRGBA(GetTexel(x, y), m_pTexelFormat, &r, &g, &b, &alphas[x + static_cast<size_t>(y) * m_Width]);
+			}
+		}
+
+		m_pAlphaCoverage = AlphaCoverage::Create(m_Width, m_Height, alphas);
+	}
+
+	void Texture::ReleaseCPUData()
+	{
+		if (m_pDDSImage && m_pTexelFormat) SDL_FreeFormat(m_pTexelFormat);
+		if (m_pSurface) SDL_FreeSurface(m_pSurface);
+		delete m_pCache;
+		delete m_pDDSImage;
+
+		m_pSurface = nullptr;
+		m_pSurfacePixels = nullptr;
+		m_pTexelFormat = nullptr;
+		m_pCache = nullptr;
+		m_pDDSImage = nullptr;
+	}
+
+	bool Texture::HasCPUData() const
+	{
+		return m_pSurface || m_pDDSImage;
+	}
+
+	size_t Texture::GetCPUMemorySize() const
+	{
+		if (m_pDDSImage) return m_pDDSImage->GetSize();
+		if (m_pCache) return m_pCache->GetSize();
+		if (m_pSurface) return static_cast<size_t>(m_pSurface->h) * m_pSurface->pitch;
+		return 0;
+	}
+
+	size_t Texture::GetGPUMemorySize() const
+	{
+		return m_GPUMemorySize;
+	}
+
+	bool Texture::IsTwoChannel() const
+	{
+		return m_pDDSImage && m_pDDSImage->IsTwoChannel();
+	}
+
+	int Texture::GetNrCPUMips() const
+	{
+		// Only the texture cache stores the mip levels of the texels, DDS images only decode their first level
+		return m_pCache ? m_pCache->GetNrMips() : 1;
+	}
+
+	uint32_t Texture::GetTexel(int x, int y, int mip) const
+	{
+		if (mip > 0) return m_pCache->GetMipTexels(mip)[x + y * m_pCache->GetMipWidth(mip)];
+
+		if (m_pDDSImage) return m_pDDSImage->GetTexel(x, y);
+
+		return m_pSurfacePixels[x + y * m_Width];
+	}
+
+	const std::string& Texture::GetPath() const
+	{
+		return m_Path;
+	}
+
+	int Texture::GetWidth() const
+	{
+		return m_Width;
+	}
+
+	int Texture::GetHeight() const
+	{
+		return m_Height;
+	}
+
+	int Texture::CalculateMip(const Vector2& uvDdx, const Vector2& uvDdy) const
+	{
+		const int nrMips{ GetNrCPUMips() };
+		if (nrMips == 1) return 0;
+
+		// The squared length in texels of the largest step to a neighbouring pixel
+		const float ddxX{ uvDdx.x * m_Width };
+		const float ddxY{ uvDdx.y * m_Height };
+		const float ddyX{ uvDdy.x * m_Width };
+		const float ddyY{ uvDdy.y * m_Height };
+		const float sqrFootprint{ std::max(ddxX * ddxX + ddxY * ddxY, ddyX * ddyX + ddyY * ddyY) };
+
+		// Magnified textures use the first level
+		if (sqrFootprint <= 1.0f) return 0;
+
+		// The level of detail is log2 of the footprint, log2 of the squared footprint is halved instead of taking the square root
+		const float levelOfDetail{ 0.5f * log2f(sqrFootprint) };
+		return std::min(static_cast<int>(levelOfDetail + 0.5f), nrMips - 1);
+	}
+
+	ColorRGB Texture::SampleRGB(const Vector2& uv, int mip) const
 	{
 		// The rgb values in [0, 255] range
 		Uint8 r{};
@@ -70,15 +312,19 @@ namespace dae
 		Uint8 b{};
 		Uint8 a{};
 
+		// The size of the sampled mip level
+		const int mipWidth{ std::max(m_Width >> mip, 1) };
+		const int mipHeight{ std::max(m_Height >> mip, 1) };
+
 		// Calculate the UV coordinates using clamp adressing mode
-		const int x{ static_cast<int>(std::clamp(uv.x, 0.0f, 1.0f) * m_pSurface->w) };
-		const int y{ static_cast<int>(std::clamp(uv.y, 0.0f, 1.0f) * m_pSurface->h) };
+		const int x{ std::min(static_cast<int>(std::clamp(uv.x, 0.0f, 1.0f) * mipWidth), mipWidth - 1) };
+		const int y{ std::min(static_cast<int>(std::clamp(uv.y, 0.0f, 1.0f) * mipHeight), mipHeight - 1) };
 
-		// Calculate the current pixelIdx on the texture
-		const Uint32 pixelIdx{ m_pSurfacePixels[x + y * m_pSurface->w] };
+		// Get the current pixel on the texture
+		const Uint32 pixel{ GetTexel(x, y, mip) };
 
 		// Get the r g b values from the current pixel on the texture
-		SDL_GetRGBA(pixelIdx, m_pSurface->format, &r, &g, &b, &a);
+		SDL_GetRGBA(pixel, m_pTexelFormat, &r, &g, &b, &a);
 
 		// The max value of a color attribute
 		constexpr float maxColorValue{ 255.0f };
@@ -87,6 +333,116 @@ namespace dae
 		return ColorRGB{ r / maxColorValue, g / maxColorValue, b / maxColorValue, a / maxColorValue };
 	}
 
+	void Texture::SampleRGBBatch(const float* pU, const float* pV, uint32_t activeMask, ColorBatch& colors, const int* pMips) const
+	{
+		// The SSE registers hold 4 lanes, so the batch is sampled in groups of 4
+		constexpr int laneWidth{ 4 };
+
+		const SDL_PixelFormat* pFormat{ m_pTexelFormat };
+
+		// The masks and shifts to unpack a texel to its channels (same result as SDL_GetRGBA for 32 bit formats)
+		const __m128i rMask{ _mm_set1_epi32(static_cast<int>(pFormat->Rmask)) };
+		const __m128i gMask{ _mm_set1_epi32(static_cast<int>(pFormat->Gmask)) };
+		const __m128i bMask{ _mm_set1_epi32(static_cast<int>(pFormat->Bmask)) };
+		const __m128i aMask{ _mm_set1_epi32(static_cast<int>(pFormat->Amask)) };
+		const __m128i rShift{ _mm_cvtsi32_si128(pFormat->Rshift) };
+		const __m128i gShift{ _mm_cvtsi32_si128(pFormat->Gshift) };
+		const __m128i bShift{ _mm_cvtsi32_si128(pFormat->Bshift) };
+		const __m128i aShift{ _mm_cvtsi32_si128(pFormat->Ashift) };
+
+		// Surfaces without an alpha channel are fully opaque
+		const bool hasAlpha{ pFormat->Amask != 0 };
+
+		const __m128 zero{ _mm_setzero_ps() };
+		const __m128 one{ _mm_set1_ps(1.0f) };
+		const __m128 toUnitRange{ _mm_set1_ps(1.0f / 255.0f) };
+
+		for (int laneStart{}; laneStart < TEXTURE_BATCH_WIDTH; laneStart += laneWidth)
+		{
+			const uint32_t laneMask{ (activeMask >> laneStart) & 0xF };
+
+			// If no lane in this group is active, output black
+			if (laneMask == 0)
+			{
+				_mm_store_ps(colors.r + laneStart, zero);
+				_mm_store_ps(colors.g + laneStart, zero);
+				_mm_store_ps(colors.b + laneStart, zero);
+				_mm_store_ps(colors.a + laneStart, zero);
+				continue;
+			}
+
+			// The size of the mip level that every lane samples
+			alignas(16) int mipWidths[laneWidth]{ m_Width, m_Width, m_Width, m_Width };
+			alignas(16) int mipHeights[laneWidth]{ m_Height, m_Height, m_Height, m_Height };
+			if (pMips)
+			{
+				for (int lane{}; lane < laneWidth; ++lane)
+				{
+					mipWidths[lane] = std::max(m_Width >> pMips[laneStart + lane], 1);
+					mipHeights[lane] = std::max(m_Height >> pMips[laneStart + lane], 1);
+				}
+			}
+			const __m128i pitch{ _mm_load_si128(reinterpret_cast<const __m128i*>(mipWidths)) };
+			const __m128i rowCount{ _mm_load_si128(reinterpret_cast<const __m128i*>(mipHeights)) };
+			const __m128 width{ _mm_cvtepi32_ps(pitch) };
+			const __m128 height{ _mm_cvtepi32_ps(rowCount) };
+			const __m128i maxX{ _mm_sub_epi32(pitch, _mm_set1_epi32(1)) };
+			const __m128i maxY{ _mm_sub_epi32(rowCount, _mm_set1_epi32(1)) };
+
+			// Calculate the UV coordinates using clamp adressing mode
+			const __m128 u{ _mm_min_ps(_mm_max_ps(_mm_loadu_ps(pU + laneStart), zero), one) };
+			const __m128 v{ _mm_min_ps(_mm_max_ps(_mm_loadu_ps(pV + laneStart), zero), one) };
+
+			// Calculate the texel coordinates, the upper bound of the uv range maps on the last texel
+			__m128i x{ _mm_cvttps_epi32(_mm_mul_ps(u, width)) };
+			__m128i y{ _mm_cvttps_epi32(_mm_mul_ps(v, height)) };
+			x = _mm_add_epi32(x, _mm_and_si128(_mm_cmpgt_epi32(x, maxX), _mm_sub_epi32(maxX, x)));
+			y = _mm_add_epi32(y, _mm_and_si128(_mm_cmpgt_epi32(y, maxY), _mm_sub_epi32(maxY, y)));
+
+			// Calculate the texel indices (x + y * width), SSE2 has no 32 bit low multiply so multiply the even and odd lanes separately
+			const __m128i evenRows{ _mm_mul_epu32(y, pitch) };
+			const __m128i oddRows{ _mm_mul_epu32(_mm_srli_si128(y, 4), _mm_srli_si128(pitch, 4)) };
+			const __m128i rows{ _mm_unpacklo_epi32(_mm_shuffle_epi32(evenRows, _MM_SHUFFLE(0, 0, 2, 0)), _mm_shuffle_epi32(oddRows, _MM_SHUFFLE(0, 0, 2, 0))) };
+
+			alignas(16) int texelIndices[laneWidth];
+			_mm_store_si128(reinterpret_cast<__m128i*>(texelIndices), _mm_add_epi32(x, rows));
+
+			// Fetch the texels of all the active lanes
+			alignas(16) uint32_t texels[laneWidth]{};
+			for (int lane{}; lane < laneWidth; ++lane)
+			{
+				if (!(laneMask & (1u << lane))) continue;
+
+				// Lower mip levels are only stored in the texture cache, compressed textures are fetched through their tile cache
+				const int mip{ pMips ? pMips[laneStart + lane] : 0 };
+				if (mip > 0) texels[lane] = m_pCache->GetMipTexels(mip)[texelIndices[lane]];
+				else texels[lane] = m_pDDSImage ? m_pDDSImage->GetTexel(texelIndices[lane] % m_Width, texelIndices[lane] / m_Width) : m_pSurfacePixels[texelIndices[lane]];
+			}
+			const __m128i texel{ _mm_load_si128(reinterpret_cast<const __m128i*>(texels)) };
+
+			// Mask out the inactive lanes
+			const __m128 activeLanes{ _mm_castsi128_ps(_mm_cmpeq_epi32(
+				_mm_and_si128(_mm_set1_epi32(static_cast<int>(laneMask)), _mm_setr_epi32(1, 2, 4, 8)),
+				_mm_setr_epi32(1, 2, 4, 8))) };
+
+			// Unpack the channels and convert them to the [0, 1] range
+			const __m128 r{ _mm_mul_ps(_mm_cvtepi32_ps(_mm_srl_epi32(_mm_and_si128(texel, rMask), rShift)), toUnitRange) };
+			const __m128 g{ _mm_mul_ps(_mm_cvtepi32_ps(_mm_srl_epi32(_mm_and_si128(texel, gMask), gShift)), toUnitRange) };
+			const __m128 b{ _mm_mul_ps(_mm_cvtepi32_ps(_mm_srl_epi32(_mm_and_si128(texel, bMask), bShift)), toUnitRange) };
+			const __m128 a{ hasAlpha ? _mm_mul_ps(_mm_cvtepi32_ps(_mm_srl_epi32(_mm_and_si128(texel, aMask), aShift)), toUnitRange) : one };
+
+			_mm_store_ps(colors.r + laneStart, _mm_and_ps(r, activeLanes));
+			_mm_store_ps(colors.g + laneStart, _mm_and_ps(g, activeLanes));
+			_mm_store_ps(colors.b + laneStart, _mm_and_ps(b, activeLanes));
+			_mm_store_ps(colors.a + laneStart, _mm_and_ps(a, activeLanes));
+		}
+	}
+
+	const AlphaCoverage* Texture::GetAlphaCoverage() const
+	{
+		return m_pAlphaCoverage;
+	}
+
 	ID3D11Texture2D* Texture::GetResource() const
 	{
 		return m_pResource;
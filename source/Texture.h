@@ -1,10 +1,27 @@
 #pragma once
 #include <SDL_surface.h>
 #include <string>
+#include <vector>
 #include "ColorRGB.h"
 
 namespace dae
 {
+	class TextureCache;
+	class DDSImage;
+	class AlphaCoverage;
+
+	// The amount of lanes that are sampled in one batched sample call
+	constexpr int TEXTURE_BATCH_WIDTH{ 8 };
+
+	// The colors of a batch of samples stored per channel (SoA)
+	struct ColorBatch
+	{
+		alignas(16) float r[TEXTURE_BATCH_WIDTH]{};
+		alignas(16) float g[TEXTURE_BATCH_WIDTH]{};
+		alignas(16) float b[TEXTURE_BATCH_WIDTH]{};
+		alignas(16) float a[TEXTURE_BATCH_WIDTH]{};
+	};
+
 	class Texture final
 	{
 	public:
@@ -12,6 +29,8 @@ namespace dae
 		{
 			Diffuse,
 			Normal,
+			// A normal map in object space, baked from a tangent space normal map
+			ObjectSpaceNormal,
 			Specular,
 			Glossiness
 		};
@@ -25,25 +44,65 @@ namespace dae
 		
 		// Shared
 		static Texture* LoadFromFile(ID3D11Device* pDevice, const std::string& path, TextureType type);
+		// Creates a texture from RGBA32 texels (R8G8B8A8 in byte order), this texture has no file so its CPU-side texels are never released
+		static Texture* CreateFromTexels(ID3D11Device* pDevice, int width, int height, const std::vector<uint32_t>& texels, TextureType type);
+
+		const std::string& GetPath() const;
+		int GetWidth() const;
+		int GetHeight() const;
 
 		// Software Rasterizer
-		ColorRGB SampleRGB(const Vector2& uv) const;
+		// The CPU-side texels can be released when only the hardware rasterizer needs the texture
+		bool LoadCPUData();
+		void ReleaseCPUData();
+		bool HasCPUData() const;
+		size_t GetCPUMemorySize() const;
+		// Selects the mip level that is sampled for the change in uv to the next pixel on the row and column (like the HLSL samplers)
+		// The mip with the closest texel size is selected, textures without CPU-side mip levels always use the first level
+		int CalculateMip(const Vector2& uvDdx, const Vector2& uvDdy) const;
+		// The amount of mip levels that can be sampled on the CPU, only textures with a texture cache have more than one
+		int GetNrCPUMips() const;
+		ColorRGB SampleRGB(const Vector2& uv, int mip = 0) const;
+		// Samples TEXTURE_BATCH_WIDTH uv lanes at once, lanes that are not in the active mask are set to 0
+		// The mip level of every lane can be given, otherwise the first level is sampled
+		void SampleRGBBatch(const float* pU, const float* pV, uint32_t activeMask, ColorBatch& colors, const int* pMips = nullptr) const;
+		// The alpha hierarchy of the texels, only built for diffuse textures, nullptr otherwise
+		const AlphaCoverage* GetAlphaCoverage() const;
 
 		// Hardware Rasterizer
 		ID3D11Texture2D* GetResource() const;
 		ID3D11ShaderResourceView* GetSRV() const;
 		TextureType GetType() const;
+		size_t GetGPUMemorySize() const;
+		// Two channel textures (BC5) only store red and green, the blue channel of normal maps has to be reconstructed
+		bool IsTwoChannel() const;
 	private:
-		Texture(ID3D11Device* pDevice, SDL_Surface* pSurface, TextureType type);
+		Texture(ID3D11Device* pDevice, const std::string& path, TextureType type);
+		Texture(ID3D11Device* pDevice, int width, int height, const std::vector<uint32_t>& texels, TextureType type);
+
+		void CreateResource(ID3D11Device* pDevice, DXGI_FORMAT format, const std::vector<D3D11_SUBRESOURCE_DATA>& initData);
+		uint32_t GetTexel(int x, int y, int mip = 0) const;
+		void BuildAlphaCoverage();
 		
+		// Shared
+		std::string m_Path{};
+		int m_Width{};
+		int m_Height{};
+
 		// Software Rasterizer
 		SDL_Surface* m_pSurface{ nullptr };
 		uint32_t* m_pSurfacePixels{ nullptr };
+		SDL_PixelFormat* m_pTexelFormat{ nullptr };
+		TextureCache* m_pCache{ nullptr };
+		DDSImage* m_pDDSImage{ nullptr };
+		// Kept when the CPU-side texels are released, it's small and the texels don't change
+		AlphaCoverage* m_pAlphaCoverage{ nullptr };
 
 		// Hardware Rasterizer
 		TextureType m_Type{};
 		ID3D11Texture2D* m_pResource{};
 		ID3D11ShaderResourceView* m_pSRV{};
+		size_t m_GPUMemorySize{};
 	};
 }
 
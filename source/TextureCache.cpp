@@ -0,0 +1,330 @@
+#include "pch.h"
+#include "TextureCache.h"
+#include <SDL_image.h>
+#include <Windows.h>
+#include <fstream>
+
+namespace dae
+{
+	TextureCache::~TextureCache()
+	{
+		Unmap();
+	}
+
+	TextureCache* TextureCache::Open(const std::string& sourcePath)
+	{
+		// The size and write time of the source image, used to check if the cache is still up to date without reading the image
+		SourceStamp stamp{};
+		if (!GetSourceStamp(sourcePath, stamp))
+		{
+			std::cout << "Failed to read texture from " << sourcePath << "\n";
+			return nullptr;
+		}
+
+		const std::string cachePath{ sourcePath + ".texcache" };
+
+		TextureCache* pCache{ new TextureCache{} };
+
+		// Try opening the existing cache, it's up to date when the source image wasn't touched since the cache was built
+		if (pCache->Map(cachePath) && pCache->IsStampMatch(stamp)) return pCache;
+
+		// The source image was touched, only the hash of its contents can tell if the cache is out of date
+		uint64_t sourceHash{};
+		if (!HashFile(sourcePath, sourceHash))
+		{
+			std::cout << "Failed to read texture from " << sourcePath << "\n";
+			delete pCache;
+			return nullptr;
+		}
+
+		// The contents didn't change, so keep the cache and store the new stamp so the next open doesn't hash again
+		if (pCache->m_pHeader && pCache->m_pHeader->sourceHash == sourceHash)
+		{
+			pCache->Unmap();
+			UpdateStamp(cachePath, stamp);
+			if (pCache->Map(cachePath)) return pCache;
+		}
+		pCache->Unmap();
+
+		// The cache is missing or out of date, so build a new one and open that instead
+		if (Build(sourcePath, cachePath, stamp, sourceHash) && pCache->Map(cachePath)) return pCache;
+
+		std::cout << "Failed to create texture cache for " << sourcePath << "\n";
+		delete pCache;
+		return nullptr;
+	}
+
+	int TextureCache::GetWidth() const
+	{
+		return static_cast<int>(m_pHeader->width);
+	}
+
+	int TextureCache::GetHeight() const
+	{
+		return static_cast<int>(m_pHeader->height);
+	}
+
+	int TextureCache::GetNrMips() const
+	{
+		return static_cast<int>(m_pHeader->nrMips);
+	}
+
+	int TextureCache::GetMipWidth(int mip) const
+	{
+		return std::max(GetWidth() >> mip, 1);
+	}
+
+	int TextureCache::GetMipHeight(int mip) const
+	{
+		return std::max(GetHeight() >> mip, 1);
+	}
+
+	const uint32_t* TextureCache::GetMipTexels(int mip) const
+	{
+		return reinterpret_cast<const uint32_t*>(m_pData + m_pHeader->mipOffsets[mip]);
+	}
+
+	size_t TextureCache::GetSize() const
+	{
+		return m_Size;
+	}
+
+	bool TextureCache::Map(const std::string& cachePath)
+	{
+		// Open the cache file
+		const HANDLE fileHandle{ CreateFileA(cachePath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr) };
+		if (fileHandle == INVALID_HANDLE_VALUE) return false;
+		m_FileHandle = fileHandle;
+
+		// The file should at least be able to hold the header
+		LARGE_INTEGER fileSize{};
+		if (!GetFileSizeEx(fileHandle, &fileSize) || fileSize.QuadPart < static_cast<LONGLONG>(sizeof(Header)))
+		{
+			Unmap();
+			return false;
+		}
+		m_Size = static_cast<size_t>(fileSize.QuadPart);
+
+		// Map the complete file into memory
+		m_MappingHandle = CreateFileMappingA(fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (!m_MappingHandle)
+		{
+			Unmap();
+			return false;
+		}
+
+		m_pData = static_cast<const uint8_t*>(MapViewOfFile(m_MappingHandle, FILE_MAP_READ, 0, 0, 0));
+		if (!m_pData)
+		{
+			Unmap();
+			return false;
+		}
+		m_pHeader = reinterpret_cast<const Header*>(m_pData);
+
+		// Check if the cache was written by this version of the cache format
+		bool isValid
+		{
+			m_pHeader->magic == m_Magic &&
+			m_pHeader->version == m_Version &&
+			m_pHeader->width > 0 && m_pHeader->height > 0 &&
+			m_pHeader->nrMips > 0 && m_pHeader->nrMips <= m_MaxMips
+		};
+
+		// Check if every mip level fits inside the file
+		for (int mip{}; isValid && mip < GetNrMips(); ++mip)
+		{
+			const uint64_t mipSize{ static_cast<uint64_t>(GetMipWidth(mip)) * GetMipHeight(mip) * sizeof(uint32_t) };
+			isValid = m_pHeader->mipOffsets[mip] + mipSize <= m_Size;
+		}
+
+		if (!isValid)
+		{
+			Unmap();
+			return false;
+		}
+
+		return true;
+	}
+
+	bool TextureCache::IsStampMatch(const SourceStamp& stamp) const
+	{
+		return m_pHeader->sourceSize == stamp.size && m_pHeader->sourceWriteTime == stamp.writeTime;
+	}
+
+	void TextureCache::Unmap()
+	{
+		if (m_pData) UnmapViewOfFile(m_pData);
+		if (m_MappingHandle) CloseHandle(m_MappingHandle);
+		if (m_FileHandle) CloseHandle(m_FileHandle);
+
+		m_pData = nullptr;
+		m_pHeader = nullptr;
+		m_MappingHandle = nullptr;
+		m_FileHandle = nullptr;
+		m_Size = 0;
+	}
+
+	bool TextureCache::Build(const std::string& sourcePath, const std::string& cachePath, const SourceStamp& stamp, uint64_t sourceHash)
+	{
+		// Decode the source image
+		SDL_Surface* pSourceSurface{ IMG_Load(sourcePath.c_str()) };
+		if (!pSourceSurface) return false;
+
+		// Convert the image to the texel layout of the cache
+		SDL_Surface* pSurface{ SDL_ConvertSurfaceFormat(pSourceSurface, SDL_PIXELFORMAT_RGBA32, 0) };
+		SDL_FreeSurface(pSourceSurface);
+		if (!pSurface) return false;
+
+		Header header{};
+		header.magic = m_Magic;
+		header.version = m_Version;
+		header.sourceHash = sourceHash;
+		header.sourceSize = stamp.size;
+		header.sourceWriteTime = stamp.writeTime;
+		header.width = static_cast<uint32_t>(pSurface->w);
+		header.height = static_cast<uint32_t>(pSurface->h);
+
+		// Copy the first mip level without the row padding of the surface
+		std::vector<uint32_t> firstMip(static_cast<size_t>(pSurface->w) * pSurface->h);
+		for (int y{}; y < pSurface->h; ++y)
+		{
+			const uint8_t* pRow{ static_cast<const uint8_t*>(pSurface->pixels) + static_cast<size_t>(y) * pSurface->pitch };
+			memcpy(firstMip.data() + static_cast<size_t>(y) * pSurface->w, pRow, pSurface->w * sizeof(uint32_t));
+		}
+
+		// Create every next mip level from the first one
+		const std::vector<std::vector<uint32_t>> mips{ CreateMipChain(firstMip, pSurface->w, pSurface->h) };
+		SDL_FreeSurface(pSurface);
+
+		// Store where every mip level starts in the file
+		header.nrMips = static_cast<uint32_t>(mips.size());
+		uint64_t offset{ sizeof(Header) };
+		for (size_t mip{}; mip < mips.size(); ++mip)
+		{
+			header.mipOffsets[mip] = offset;
+			offset += mips[mip].size() * sizeof(uint32_t);
+		}
+
+		// Write the header and all the mip levels to the cache file
+		std::ofstream file{ cachePath, std::ios::binary | std::ios::trunc };
+		if (!file) return false;
+
+		file.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+		for (const std::vector<uint32_t>& mip : mips)
+		{
+			file.write(reinterpret_cast<const char*>(mip.data()), static_cast<std::streamsize>(mip.size() * sizeof(uint32_t)));
+		}
+
+		return file.good();
+	}
+
+	std::vector<std::vector<uint32_t>> TextureCache::CreateMipChain(const std::vector<uint32_t>& texels, int width, int height)
+	{
+		std::vector<std::vector<uint32_t>> mips{ texels };
+
+		// Create every next mip level by averaging 2x2 texels of the previous level
+		int mipWidth{ width };
+		int mipHeight{ height };
+		while ((mipWidth > 1 || mipHeight > 1) && mips.size() < m_MaxMips)
+		{
+			const int nextWidth{ std::max(mipWidth / 2, 1) };
+			const int nextHeight{ std::max(mipHeight / 2, 1) };
+
+			const std::vector<uint32_t>& previousMip{ mips.back() };
+			std::vector<uint32_t> nextMip(static_cast<size_t>(nextWidth) * nextHeight);
+
+			for (int y{}; y < nextHeight; ++y)
+			{
+				const int y0{ std::min(y * 2, mipHeight - 1) };
+				const int y1{ std::min(y * 2 + 1, mipHeight - 1) };
+
+				for (int x{}; x < nextWidth; ++x)
+				{
+					const int x0{ std::min(x * 2, mipWidth - 1) };
+					const int x1{ std::min(x * 2 + 1, mipWidth - 1) };
+
+					const uint32_t texels[4]
+					{
+						previousMip[x0 + y0 * mipWidth],
+						previousMip[x1 + y0 * mipWidth],
+						previousMip[x0 + y1 * mipWidth],
+						previousMip[x1 + y1 * mipWidth]
+					};
+
+					// Average every channel separately (with rounding)
+					uint32_t averagedTexel{};
+					for (int channelShift{}; channelShift < 32; channelShift += 8)
+					{
+						uint32_t channelSum{ 2 };
+						for (const uint32_t texel : texels)
+						{
+							channelSum += (texel >> channelShift) & 0xFF;
+						}
+						averagedTexel |= (channelSum / 4) << channelShift;
+					}
+
+					nextMip[x + y * nextWidth] = averagedTexel;
+				}
+			}
+
+			mips.push_back(std::move(nextMip));
+			mipWidth = nextWidth;
+			mipHeight = nextHeight;
+		}
+
+		return mips;
+	}
+
+	bool TextureCache::UpdateStamp(const std::string& cachePath, const SourceStamp& stamp)
+	{
+		std::fstream file{ cachePath, std::ios::binary | std::ios::in | std::ios::out };
+		if (!file) return false;
+
+		// Read the header, overwrite the stamp and write it back in place
+		Header header{};
+		if (!file.read(reinterpret_cast<char*>(&header), sizeof(Header))) return false;
+
+		header.sourceSize = stamp.size;
+		header.sourceWriteTime = stamp.writeTime;
+
+		file.seekp(0);
+		file.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+		return file.good();
+	}
+
+	bool TextureCache::GetSourceStamp(const std::string& path, SourceStamp& stamp)
+	{
+		// Only the file system metadata is read, not the image itself
+		WIN32_FILE_ATTRIBUTE_DATA attributes{};
+		if (!GetFileAttributesExA(path.c_str(), GetFileExInfoStandard, &attributes)) return false;
+
+		stamp.size = (static_cast<uint64_t>(attributes.nFileSizeHigh) << 32) | attributes.nFileSizeLow;
+		stamp.writeTime = (static_cast<uint64_t>(attributes.ftLastWriteTime.dwHighDateTime) << 32) | attributes.ftLastWriteTime.dwLowDateTime;
+		return true;
+	}
+
+	bool TextureCache::HashFile(const std::string& path, uint64_t& hash)
+	{
+		std::ifstream file{ path, std::ios::binary };
+		if (!file) return false;
+
+		// FNV-1a hash over the complete file
+		constexpr uint64_t fnvOffsetBasis{ 0xCBF29CE484222325 };
+		constexpr uint64_t fnvPrime{ 0x100000001B3 };
+
+		hash = fnvOffsetBasis;
+
+		char buffer[4096];
+		while (file.read(buffer, sizeof(buffer)) || file.gcount() > 0)
+		{
+			const std::streamsize nrBytesRead{ file.gcount() };
+			for (std::streamsize i{}; i < nrBytesRead; ++i)
+			{
+				hash ^= static_cast<uint8_t>(buffer[i]);
+				hash *= fnvPrime;
+			}
+		}
+
+		return true;
+	}
+}
@@ -0,0 +1,81 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <cstdint>
+
+namespace dae
+{
+	// A pre-decoded copy of a source image with its full mip chain, stored next to the source image
+	// The file is memory-mapped when opened, so the texels can be used without decoding or copying
+	class TextureCache final
+	{
+	public:
+		~TextureCache();
+
+		TextureCache(const TextureCache& other) = delete;
+		TextureCache& operator=(const TextureCache& other) = delete;
+		TextureCache(TextureCache&& other) = delete;
+		TextureCache& operator=(TextureCache&& other) = delete;
+
+		// Opens the cache of a source image, the cache is (re)built when it is missing or out of date
+		// Returns nullptr if no valid cache could be opened
+		static TextureCache* Open(const std::string& sourcePath);
+
+		int GetWidth() const;
+		int GetHeight() const;
+		int GetNrMips() const;
+		int GetMipWidth(int mip) const;
+		int GetMipHeight(int mip) const;
+		// The texels of a mip level, stored as RGBA32 (R8G8B8A8 in byte order)
+		const uint32_t* GetMipTexels(int mip) const;
+		// The size of the complete mapped file in bytes
+		size_t GetSize() const;
+
+		// Creates the mip chain of RGBA32 texels, every next level averages 2x2 texels of the previous level
+		// The first level is a copy of the texels
+		static std::vector<std::vector<uint32_t>> CreateMipChain(const std::vector<uint32_t>& texels, int width, int height);
+
+	private:
+		static constexpr uint32_t m_Magic{ 0x31435854 }; // "TXC1"
+		static constexpr uint32_t m_Version{ 2 };
+		static constexpr int m_MaxMips{ 16 };
+
+		struct Header
+		{
+			uint32_t magic;
+			uint32_t version;
+			uint64_t sourceHash;
+			uint64_t sourceSize;
+			uint64_t sourceWriteTime;
+			uint32_t width;
+			uint32_t height;
+			uint32_t nrMips;
+			uint32_t flags; // Reserved for texel layouts other then linear rows
+			uint64_t mipOffsets[m_MaxMips];
+		};
+
+		// The size and last write time of the source image, the full file is only hashed when one of these changed
+		struct SourceStamp
+		{
+			uint64_t size;
+			uint64_t writeTime;
+		};
+
+		TextureCache() = default;
+
+		void* m_FileHandle{};
+		void* m_MappingHandle{};
+		const uint8_t* m_pData{};
+		size_t m_Size{};
+		const Header* m_pHeader{};
+
+		bool Map(const std::string& cachePath);
+		void Unmap();
+		bool IsStampMatch(const SourceStamp& stamp) const;
+
+		static bool Build(const std::string& sourcePath, const std::string& cachePath, const SourceStamp& stamp, uint64_t sourceHash);
+		static bool UpdateStamp(const std::string& cachePath, const SourceStamp& stamp);
+		static bool GetSourceStamp(const std::string& path, SourceStamp& stamp);
+		static bool HashFile(const std::string& path, uint64_t& hash);
+	};
+}
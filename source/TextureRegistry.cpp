@@ -0,0 +1,152 @@
+#include "pch.h"
+#include "TextureRegistry.h"
+
+namespace dae
+{
+	TextureRegistry::TextureRegistry(ID3D11Device* pDevice, size_t cpuMemoryBudget)
+		: m_pDevice{ pDevice }
+		, m_CPUMemoryBudget{ cpuMemoryBudget }
+	{
+	}
+
+	TextureRegistry::~TextureRegistry()
+	{
+		for (const auto& [key, entry] : m_Entries)
+		{
+			delete entry.pTexture;
+		}
+	}
+
+	Texture* TextureRegistry::Acquire(const std::string& path, Texture::TextureType type)
+	{
+		// If this texture has already been loaded, share the existing texture
+		const auto it{ m_Entries.find({ path, type }) };
+		if (it != m_Entries.end())
+		{
+			++it->second.refCount;
+			return it->second.pTexture;
+		}
+
+		// Load the texture and start tracking it
+		Entry entry{};
+		entry.pTexture = Texture::LoadFromFile(m_pDevice, path, type);
+		entry.refCount = 1;
+		entry.lastUsedFrame = m_CurrentFrame;
+		m_Entries.emplace(Key{ path, type }, entry);
+		m_Keys.emplace(entry.pTexture, Key{ path, type });
+
+		// Loading a texture brings its CPU-side copy along, so check if we are still within budget
+		EnforceBudget();
+
+		return entry.pTexture;
+	}
+
+	void TextureRegistry::Release(Texture* pTexture)
+	{
+		const auto keyIt{ m_Keys.find(pTexture) };
+		if (keyIt == m_Keys.end()) return;
+
+		const auto it{ m_Entries.find(keyIt->second) };
+
+		// Delete the texture when nothing uses it anymore
+		if (--it->second.refCount <= 0)
+		{
+			delete it->second.pTexture;
+			m_Entries.erase(it);
+			m_Keys.erase(keyIt);
+		}
+	}
+
+	void TextureRegistry::BeginFrame()
+	{
+		++m_CurrentFrame;
+
+		// Copies that weren't used by the previous frame can be released, the ones it used are likely needed again this frame
+		EnforceBudget();
+	}
+
+	void TextureRegistry::MakeResident(Texture* pTexture)
+	{
+		if (!pTexture) return;
+
+		Entry* pEntry{ FindEntry(pTexture) };
+		if (!pEntry) return;
+
+		// Mark the texture as used in this frame
+		pEntry->lastUsedFrame = m_CurrentFrame;
+
+		if (pTexture->HasCPUData()) return;
+
+		// Reload the CPU-side copy and make room for it if needed
+		if (!pTexture->LoadCPUData())
+		{
+			std::cout << "Failed to reload texture from " << pTexture->GetPath() << "\n";
+			return;
+		}
+		EnforceBudget();
+	}
+
+	void TextureRegistry::SetCPUMemoryBudget(size_t cpuMemoryBudget)
+	{
+		m_CPUMemoryBudget = cpuMemoryBudget;
+		EnforceBudget();
+	}
+
+	size_t TextureRegistry::GetCPUMemoryUsage() const
+	{
+		size_t usage{};
+		for (const auto& [key, entry] : m_Entries)
+		{
+			usage += entry.pTexture->GetCPUMemorySize();
+		}
+		return usage;
+	}
+
+	size_t TextureRegistry::GetGPUMemoryUsage() const
+	{
+		size_t usage{};
+		for (const auto& [key, entry] : m_Entries)
+		{
+			usage += entry.pTexture->GetGPUMemorySize();
+		}
+		return usage;
+	}
+
+	TextureRegistry::Entry* TextureRegistry::FindEntry(const Texture* pTexture)
+	{
+		const auto keyIt{ m_Keys.find(pTexture) };
+		if (keyIt == m_Keys.end()) return nullptr;
+
+		return &m_Entries.at(keyIt->second);
+	}
+
+	void TextureRegistry::EnforceBudget()
+	{
+		size_t usage{ GetCPUMemoryUsage() };
+		if (usage <= m_CPUMemoryBudget) return;
+
+		// Release more than strictly needed, so the next load doesn't immediately exceed the budget again
+		const size_t targetUsage{ static_cast<size_t>(m_CPUMemoryBudget * m_LowWaterMark) };
+
+		while (usage > targetUsage)
+		{
+			// Find the least recently used CPU-side copy that isn't used in the current or the previous frame
+			Entry* pLeastRecentlyUsed{};
+			for (auto& [key, entry] : m_Entries)
+			{
+				if (!entry.pTexture->HasCPUData() || entry.lastUsedFrame + 1 >= m_CurrentFrame) continue;
+
+				if (!pLeastRecentlyUsed || entry.lastUsedFrame < pLeastRecentlyUsed->lastUsedFrame)
+				{
+					pLeastRecentlyUsed = &entry;
+				}
+			}
+
+			// Everything that is left is part of the working set of the last two frames
+			if (!pLeastRecentlyUsed) return;
+
+			usage -= pLeastRecentlyUsed->pTexture->GetCPUMemorySize();
+			pLeastRecentlyUsed->pTexture->ReleaseCPUData();
+		}
+	}
+}
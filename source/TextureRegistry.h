@@ -0,0 +1,62 @@
+#pragma once
+#include <map>
+#include <unordered_map>
+#include <string>
+#include "Texture.h"
+
+namespace dae
+{
+	// Shares textures between meshes, every texture is loaded once per path and type
+	// The CPU-side copies of the textures are kept within a memory budget, the least recently used copies are released first
+	// Copies used in the current or previous frame are never released, so a working set that is larger than the budget doesn't reload every frame
+	class TextureRegistry final
+	{
+	public:
+		TextureRegistry(ID3D11Device* pDevice, size_t cpuMemoryBudget);
+		~TextureRegistry();
+
+		TextureRegistry(const TextureRegistry&) = delete;
+		TextureRegistry(TextureRegistry&&) noexcept = delete;
+		TextureRegistry& operator=(const TextureRegistry&) = delete;
+		TextureRegistry& operator=(TextureRegistry&&) noexcept = delete;
+
+		// Returns the texture of this path and type, loading it if it isn't loaded yet
+		// Every acquired texture should be released again
+		Texture* Acquire(const std::string& path, Texture::TextureType type);
+		void Release(Texture* pTexture);
+
+		// Starts a new frame, textures made resident during a frame are never released during that frame or the next one
+		void BeginFrame();
+		// Makes sure the CPU-side copy of the texture is loaded so it can be sampled by the software rasterizer
+		void MakeResident(Texture* pTexture);
+
+		void SetCPUMemoryBudget(size_t cpuMemoryBudget);
+		size_t GetCPUMemoryUsage() const;
+		size_t GetGPUMemoryUsage() const;
+
+	private:
+		struct Entry
+		{
+			Texture* pTexture{};
+			int refCount{};
+			uint64_t lastUsedFrame{};
+		};
+
+		using Key = std::pair<std::string, Texture::TextureType>;
+
+		// When the budget is exceeded, copies are released until the usage drops to this fraction of the budget
+		static constexpr float m_LowWaterMark{ 0.875f };
+
+		ID3D11Device* m_pDevice{};
+
+		std::map<Key, Entry> m_Entries{};
+		// The key of every loaded texture, so a texture can be found without searching every entry
+		std::unordered_map<const Texture*, Key> m_Keys{};
+
+		size_t m_CPUMemoryBudget{};
+		uint64_t m_CurrentFrame{};
+
+		Entry* FindEntry(const Texture* pTexture);
+		void EnforceBudget();
+	};
+}
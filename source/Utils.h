@@ -4,6 +4,7 @@
 #include <vector>
 #include "DataTypes.h"
 #include "Camera.h"
+#include <immintrin.h>
 
 namespace dae
 {
@@ -179,11 +180,62 @@ namespace dae
 
 			return ColorRGB{ phong, phong, phong };
 		}
+
+		// Calculates the direction towards the light and returns how much of the light reaches the position (distance and cone falloff)
+		inline float CalculateLightFalloff(const Light& light, const Vector3& position, Vector3& toLight)
+		{
+			if (light.type == LightType::Directional)
+			{
+				toLight = -light.direction;
+				return 1.0f;
+			}
+
+			// Calculate the direction and distance towards the light
+			toLight = light.position - position;
+			const float distance{ toLight.Normalize() };
+
+			// Fade the light out towards its range
+			const float distanceFalloff{ Square(Saturate(1.0f - distance / light.range)) };
+			if (light.type == LightType::Point) return distanceFalloff;
+
+			// Fade the spot light out between the inner and outer cone
+			const float coneCos{ Vector3::Dot(-toLight, light.direction) };
+			const float coneFalloff{ Saturate((coneCos - light.outerConeCos) / (light.innerConeCos - light.outerConeCos)) };
+			return distanceFalloff * coneFalloff;
+		}
+
+		// Returns how much of the 3x3 texels around the position in the shadow map are lit (percentage closer filtering)
+		// Positions outside the shadow map are lit, this matches CalculateShadow in PosTex3D.fx
+		inline float SampleShadowMap(const float* pShadowMap, const Matrix& lightViewProjectionMatrix, const Vector3& position)
+		{
+			constexpr float depthBias{ 0.001f };
+			constexpr int filterRadius{ 1 };
+			constexpr float nrTaps{ (2 * filterRadius + 1) * (2 * filterRadius + 1) };
+
+			// The light uses an orthographic projection, so no perspective divide is needed
+			const Vector3 lightPosition{ lightViewProjectionMatrix.TransformPoint(position) };
+			const int centerX{ static_cast<int>(std::floor((lightPosition.x + 1.0f) / 2.0f * SHADOW_MAP_SIZE)) };
+			const int centerY{ static_cast<int>(std::floor((1.0f - lightPosition.y) / 2.0f * SHADOW_MAP_SIZE)) };
+			const float compareDepth{ lightPosition.z - depthBias };
+
+			int nrLitTaps{};
+			for (int y{ centerY - filterRadius }; y <= centerY + filterRadius; ++y)
+			{
+				for (int x{ centerX - filterRadius }; x <= centerX + filterRadius; ++x)
+				{
+					if (x < 0 || y < 0 || x >= SHADOW_MAP_SIZE || y >= SHADOW_MAP_SIZE || compareDepth <= pShadowMap[x + y * SHADOW_MAP_SIZE]) ++nrLitTaps;
+				}
+			}
+
+			return nrLitTaps / nrTaps;
+		}
 	}
 
 	namespace GeometryUtils
 	{
-		inline void VertexTransformationFunction(const Matrix& worldMatrix, const std::vector<Vertex>& vertices, std::vector<Vertex_Out>& verticesOut, Camera* pCamera)
+		// When a previous world view projection matrix is given, the clip space position of the vertex in the previous frame is calculated too
+		inline void VertexTransformationFunction(const Matrix& worldMatrix, const std::vector<Vertex>& vertices, std::vector<Vertex_Out>& verticesOut, Camera* pCamera,
+			const Matrix* pPreviousWorldViewProjectionMatrix = nullptr)
 		{
 			// Calculate the transformation matrix for this mesh
 			const Matrix worldViewProjectionMatrix{ worldMatrix * pCamera->GetViewMatrix() * pCamera->GetProjectionMatrix() };
@@ -199,9 +251,11 @@ namespace dae
 
 				// Tranform the vertex using the inversed view matrix
 				vOut.position = worldViewProjectionMatrix.TransformPoint({ v.position, 1.0f });
+				if (pPreviousWorldViewProjectionMatrix) vOut.previousPosition = pPreviousWorldViewProjectionMatrix->TransformPoint({ v.position, 1.0f });
 
-				// Calculate the view direction
-				vOut.viewDirection = worldMatrix.TransformPoint(v.position) - pCamera->GetPosition();
+				// Calculate the world position and the view direction
+				vOut.worldPosition = worldMatrix.TransformPoint(v.position);
+				vOut.viewDirection = vOut.worldPosition - pCamera->GetPosition();
 				vOut.viewDirection.Normalize();
 
 				// Divide all properties of the position by the original z (stored in position.w)
@@ -316,4 +370,129 @@ namespace dae
 			};
 		}
 	}
+
+	// Converts colors to and from the packed 32 bit pixels of the back buffer without going through SDL
+	namespace ColorUtils
+	{
+		// Converts a color in [0, 1] to a packed pixel, channels outside [0, 1] saturate to 0 or 255
+		template<PixelSwizzle swizzle>
+		inline uint32_t PackColor(const ColorRGB& color)
+		{
+			// The lowest lane ends up in the lowest byte
+			const __m128 channels{ swizzle == PixelSwizzle::XRGB ? _mm_set_ps(0.0f, color.r, color.g, color.b) : _mm_set_ps(0.0f, color.b, color.g, color.r) };
+
+			// Truncate like a static_cast, the packs saturate to [0, 255]
+			const __m128i integers{ _mm_cvttps_epi32(_mm_mul_ps(channels, _mm_set1_ps(255.0f))) };
+			const __m128i shorts{ _mm_packs_epi32(integers, integers) };
+			return static_cast<uint32_t>(_mm_cvtsi128_si32(_mm_packus_epi16(shorts, shorts)));
+		}
+
+		inline uint32_t PackColor(const ColorRGB& color, PixelSwizzle swizzle)
+		{
+			return swizzle == PixelSwizzle::XRGB ? PackColor<PixelSwizzle::XRGB>(color) : PackColor<PixelSwizzle::XBGR>(color);
+		}
+
+		// Converts 4 colors stored per channel in [0, 1] to 4 packed pixels
+		template<PixelSwizzle swizzle>
+		inline __m128i PackChannels(__m128 r, __m128 g, __m128 b)
+		{
+			const __m128 scale{ _mm_set1_ps(255.0f) };
+			const __m128i zero{ _mm_setzero_si128() };
+
+			// The channel in the lowest byte, the middle byte and the highest used byte of every pixel
+			const __m128i low{ _mm_cvttps_epi32(_mm_mul_ps(swizzle == PixelSwizzle::XRGB ? b : r, scale)) };
+			const __m128i middle{ _mm_cvttps_epi32(_mm_mul_ps(g, scale)) };
+			const __m128i high{ _mm_cvttps_epi32(_mm_mul_ps(swizzle == PixelSwizzle::XRGB ? r : b, scale)) };
+
+			// Saturate to bytes: l0 l1 l2 l3 m0 m1 m2 m3 h0 h1 h2 h3 0 0 0 0
+			const __m128i bytes{ _mm_packus_epi16(_mm_packs_epi32(low, middle), _mm_packs_epi32(high, zero)) };
+
+			// Interleave the channels per pixel: l0 m0 h0 0 l1 m1 h1 0 ...
+			const __m128i lowMiddle{ _mm_unpacklo_epi8(bytes, _mm_srli_si128(bytes, 4)) };
+			const __m128i highZero{ _mm_unpacklo_epi8(_mm_srli_si128(bytes, 8), zero) };
+			return _mm_unpacklo_epi16(lowMiddle, highZero);
+		}
+
+		// Converts 4 colors stored per channel to packed pixels
+		template<PixelSwizzle swizzle>
+		inline void PackColors(const float* pR, const float* pG, const float* pB, uint32_t* pPixels)
+		{
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(pPixels), PackChannels<swizzle>(_mm_loadu_ps(pR), _mm_loadu_ps(pG), _mm_loadu_ps(pB)));
+		}
+
+		inline void PackColors(const float* pR, const float* pG, const float* pB, PixelSwizzle swizzle, uint32_t* pPixels)
+		{
+			if (swizzle == PixelSwizzle::XRGB) PackColors<PixelSwizzle::XRGB>(pR, pG, pB, pPixels);
+			else PackColors<PixelSwizzle::XBGR>(pR, pG, pB, pPixels);
+		}
+
+		// Converts a packed pixel to a color in [0, 1]
+		inline ColorRGB UnpackColor(uint32_t pixel, PixelSwizzle swizzle)
+		{
+			constexpr float maxColorValue{ 255.0f };
+			const float high{ ((pixel >> 16) & 0xFF) / maxColorValue };
+			const float middle{ ((pixel >> 8) & 0xFF) / maxColorValue };
+			const float low{ (pixel & 0xFF) / maxColorValue };
+
+			return swizzle == PixelSwizzle::XRGB ? ColorRGB{ high, middle, low } : ColorRGB{ low, middle, high };
+		}
+
+		// Tonemaps 4 HDR colors and converts them to packed pixels
+		// Colors with a channel above 1 are scaled down the same way as ColorRGB::MaxToOne, so the hue stays the same
+		template<PixelSwizzle swizzle>
+		inline void TonemapColors(const ColorRGB* pColors, uint32_t* pPixels)
+		{
+			// Every color is stored as r, g, b, a so transposing gives the channels of the 4 colors
+			__m128 r{ _mm_loadu_ps(&pColors[0].r) };
+			__m128 g{ _mm_loadu_ps(&pColors[1].r) };
+			__m128 b{ _mm_loadu_ps(&pColors[2].r) };
+			__m128 a{ _mm_loadu_ps(&pColors[3].r) };
+			_MM_TRANSPOSE4_PS(r, g, b, a);
+
+			const __m128 one{ _mm_set1_ps(1.0f) };
+			const __m128 scale{ _mm_div_ps(one, _mm_max_ps(_mm_max_ps(r, g), _mm_max_ps(b, one))) };
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(pPixels), PackChannels<swizzle>(_mm_mul_ps(r, scale), _mm_mul_ps(g, scale), _mm_mul_ps(b, scale)));
+		}
+
+		// Writes a shaded color to the HDR buffer when it is enabled, otherwise it is scaled back to [0, 1] and packed in the back buffer
+		// With multisampling the color goes to the samples in the sample mask instead, so the samples are scaled the same way as the pixels
+		inline void WriteColor(const SoftwareRenderInfo& renderInfo, int pixelIdx, ColorRGB color, uint32_t sampleMask = ALL_SAMPLES_MASK)
+		{
+			if (!renderInfo.pHdrBuffer) color.MaxToOne();
+
+			if (renderInfo.pSampleColorBuffer)
+			{
+				ColorRGB* pSampleColors{ renderInfo.pSampleColorBuffer + pixelIdx * MSAA_SAMPLE_COUNT };
+				for (int sampleIdx{}; sampleIdx < MSAA_SAMPLE_COUNT; ++sampleIdx)
+				{
+					if (sampleMask & (1u << sampleIdx)) pSampleColors[sampleIdx] = color;
+				}
+				return;
+			}
+
+			if (renderInfo.pHdrBuffer)
+			{
+				renderInfo.pHdrBuffer[pixelIdx] = color;
+				return;
+			}
+
+			renderInfo.pBackBufferPixels[pixelIdx] = PackColor(color, renderInfo.pixelSwizzle);
+		}
+
+		// Reads the color of a pixel from the HDR buffer when it is enabled, otherwise from the back buffer
+		inline ColorRGB ReadColor(const SoftwareRenderInfo& renderInfo, int pixelIdx)
+		{
+			if (renderInfo.pHdrBuffer) return renderInfo.pHdrBuffer[pixelIdx];
+
+			return UnpackColor(renderInfo.pBackBufferPixels[pixelIdx], renderInfo.pixelSwizzle);
+		}
+
+		// Copies a shaded color to another pixel, with multisampling the source is a sample (pixel * MSAA_SAMPLE_COUNT + sample) and the color goes to the samples in the sample mask
+		inline void CopyColor(const SoftwareRenderInfo& renderInfo, int dstPixelIdx, int srcIdx, uint32_t dstSampleMask)
+		{
+			if (renderInfo.pSampleColorBuffer) WriteColor(renderInfo, dstPixelIdx, renderInfo.pSampleColorBuffer[srcIdx], dstSampleMask);
+			else if (renderInfo.pHdrBuffer) renderInfo.pHdrBuffer[dstPixelIdx] = renderInfo.pHdrBuffer[srcIdx];
+			else renderInfo.pBackBufferPixels[dstPixelIdx] = renderInfo.pBackBufferPixels[srcIdx];
+		}
+	}
 }
\ No newline at end of file
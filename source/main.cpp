@@ -81,6 +81,18 @@ int main(int argc, char* args[])
 				else if (e.key.keysym.scancode == SDL_SCANCODE_F8) pRenderer->ToggleShowingBoundingBoxes();
 				else if (e.key.keysym.scancode == SDL_SCANCODE_F9) pRenderer->ToggleCullMode();
 				else if (e.key.keysym.scancode == SDL_SCANCODE_F10) pRenderer->ToggleUniformBackground();
+				else if (e.key.keysym.scancode == SDL_SCANCODE_1) pRenderer->ToggleShadingRatePolicy();
+				else if (e.key.keysym.scancode == SDL_SCANCODE_2) pRenderer->ToggleDynamicResolution();
+				else if (e.key.keysym.scancode == SDL_SCANCODE_3) pRenderer->ToggleReprojectionCache();
+				else if (e.key.keysym.scancode == SDL_SCANCODE_4) pRenderer->ToggleCheckerboard();
+				else if (e.key.keysym.scancode == SDL_SCANCODE_5) pRenderer->ToggleOrderIndependentTransparency();
+				else if (e.key.keysym.scancode == SDL_SCANCODE_6) pRenderer->ToggleTransparencyResolution();
+				else if (e.key.keysym.scancode == SDL_SCANCODE_7) pRenderer->ToggleHdrBuffer();
+				else if (e.key.keysym.scancode == SDL_SCANCODE_8) pRenderer->CyclePresentQueueDepth();
+				else if (e.key.keysym.scancode == SDL_SCANCODE_9) pRenderer->CycleFrameCapture();
+				else if (e.key.keysym.scancode == SDL_SCANCODE_0) pRenderer->CycleDepthFormat();
+				else if (e.key.keysym.scancode == SDL_SCANCODE_R) pRenderer->CycleDepthProjection();
+				else if (e.key.keysym.scancode == SDL_SCANCODE_M) pRenderer->ToggleMultisampling();
 				else if (e.key.keysym.scancode == SDL_SCANCODE_F11)
 				{
 					isShowingFPS = !isShowingFPS;